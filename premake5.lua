@@ -81,6 +81,21 @@ workspace "CompGFX"
         }
         includedirs { "include/", "include/imgui" }
         links { "CompGFX.lib" }
+
+    -- Offline shader compiler, egx-shaderc <shader directory> <output pack>
+    -- Builds that only load packs can define EGX_NO_SHADERC for CompGFX and drop the shaderc library
+    project "egx-shaderc"
+        dependson { "CompGFX" }
+        kind "ConsoleApp"
+        language "C++"
+        location "src/egx-shaderc"
+        files {
+            "src/egx-shaderc/**.h",
+            "src/egx-shaderc/**.hpp",
+            "src/egx-shaderc/**.cpp"
+        }
+        includedirs { "include/" }
+        links { "CompGFX.lib" }
         
 newaction {
     trigger = "clean",
@@ -1,9 +1,14 @@
 #pragma once
 #include "egx.hpp"
+#include "QueueSubmitter.hpp"
 
 namespace egx {
 
 
+	/// <summary>
+	/// One binary semaphore per frame and name, looked up by string on every call.
+	/// Render loops should prefer FrameScheduler (timeline semaphores) when it is available.
+	/// </summary>
 	class IFramedSemaphore {
 	public:
 		IFramedSemaphore() = default;
@@ -25,6 +30,10 @@ namespace egx {
 		std::shared_ptr<DataWrapper> _data;
 	};
 
+	/// <summary>
+	/// One fence per frame and name, looked up by string on every call.
+	/// Render loops should prefer FrameScheduler::BeginFrame() when it is available.
+	/// </summary>
 	class IFramedFence {
 	public:
 		IFramedFence() = default;
@@ -98,7 +107,9 @@ namespace egx {
 		void RunNowAsync() {
 			m_Executed = true;
 			m_Cmd.end();
-			m_Ctx->Queue.submit(vk::SubmitInfo({}, {}, m_Cmd), m_Fence);
+			// Pending uploads must execute before anything recorded here
+			m_Ctx->FlushUploads();
+			m_Ctx->Submitter->Enqueue(QueueType::Graphics, { m_Cmd }, {}, {}, m_Fence);
 		}
 
 		vk::CommandBuffer Get() { return m_Cmd; }
@@ -123,7 +134,7 @@ namespace egx {
 
 	private:
 		void _wait() {
-			auto waitResult = m_Ctx->Device.waitForFences(m_Fence, true, std::numeric_limits<uint64_t>::max());
+			auto waitResult = m_Ctx->Submitter->WaitForFences({ m_Fence });
 			if (waitResult != vk::Result::eSuccess) {
 				throw std::runtime_error(cpp::Format("Wait Failed on Fence, Result={}", vk::to_string(waitResult)));
 			}
@@ -0,0 +1,92 @@
+#include "DeletionQueue.hpp"
+#include "QueueSubmitter.hpp"
+
+using namespace egx;
+using namespace std;
+
+egx::DeletionQueue::DeletionQueue(DeviceContext* pCtx) : m_Ctx(pCtx)
+{
+	m_Slots.resize(pCtx->FramesInFlight);
+	for (auto& slot : m_Slots)
+	{
+		for (auto& fence : slot.Fences)
+			fence = pCtx->Device.createFence({});
+	}
+}
+
+egx::DeletionQueue::~DeletionQueue()
+{
+	Flush();
+	for (auto& slot : m_Slots)
+	{
+		for (auto fence : slot.Fences)
+			m_Ctx->Device.destroyFence(fence);
+	}
+}
+
+void egx::DeletionQueue::Push(function<void()> destroy)
+{
+	scoped_lock lock(m_Lock);
+	m_Slots[m_Ctx->CurrentFrame].Deletions.push_back(std::move(destroy));
+}
+
+void egx::DeletionQueue::EndFrame()
+{
+	scoped_lock lock(m_Lock);
+	Slot& slot = m_Slots[m_Ctx->CurrentFrame];
+	if (slot.Submitted)
+		return;
+	// Every queue gets its own fence, the compute batch is submitted after the graphics batch even when both share a queue
+	for (uint32_t i = 0; i < uint32_t(QueueType::Count); i++)
+		m_Ctx->Submitter->Enqueue(QueueType(i), {}, {}, {}, slot.Fences[i]);
+	slot.Submitted = true;
+}
+
+void egx::DeletionQueue::Collect()
+{
+	vector<function<void()>> deletions;
+	{
+		scoped_lock lock(m_Lock);
+		Slot& slot = m_Slots[m_Ctx->CurrentFrame];
+		if (slot.Submitted)
+		{
+			vector<vk::Fence> fences(slot.Fences.begin(), slot.Fences.end());
+			// The fences were enqueued FramesInFlight frames ago
+			m_Ctx->Submitter->WaitForFences(fences);
+			m_Ctx->Device.resetFences(fences);
+			slot.Submitted = false;
+		}
+		deletions.swap(slot.Deletions);
+	}
+	// Outside of the lock, a deletion may release resources that push their own
+	for (auto& destroy : deletions)
+		destroy();
+}
+
+void egx::DeletionQueue::Flush()
+{
+	// Deletions may push more deletions
+	while (PendingCount() > 0)
+	{
+		vector<function<void()>> deletions;
+		{
+			scoped_lock lock(m_Lock);
+			for (auto& slot : m_Slots)
+			{
+				deletions.insert(deletions.end(), make_move_iterator(slot.Deletions.begin()), make_move_iterator(slot.Deletions.end()));
+				slot.Deletions.clear();
+			}
+		}
+		for (auto& destroy : deletions)
+			destroy();
+	}
+}
+
+size_t egx::DeletionQueue::PendingCount() const
+{
+	scoped_lock lock(m_Lock);
+	size_t count = 0;
+	for (auto& slot : m_Slots)
+		count += slot.Deletions.size();
+	return count;
+}
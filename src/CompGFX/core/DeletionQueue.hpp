@@ -0,0 +1,52 @@
+#pragma once
+#include "egx.hpp"
+#include "FrameScheduler.hpp"
+#include <functional>
+#include <mutex>
+
+namespace egx
+{
+
+	/// <summary>
+	/// Defers the destruction of Vulkan handles until the GPU is done with them, without waiting for the device.
+	/// Push() adds to the current frame slot. EndFrame() (DeviceContext::NextFrame()) enqueues the slot's fences behind
+	/// the frame's work on the graphics and compute queues, and Collect() runs the slot's deletions once the slot comes
+	/// around again and its fences retired, which in steady state does not block.
+	/// Deletions pushed by applications that never call NextFrame() run when the DeviceContext is destroyed.
+	/// </summary>
+	class DeletionQueue
+	{
+	public:
+		DeletionQueue(DeviceContext* pCtx);
+		DeletionQueue(DeletionQueue&) = delete;
+		~DeletionQueue();
+
+		/// <summary>
+		/// Runs destroy after every frame that could have recorded the handles it destroys retired. Thread safe.
+		/// </summary>
+		void Push(std::function<void()> destroy);
+
+		void EndFrame();
+		void Collect();
+		/// <summary>
+		/// Runs every pending deletion, the device must be idle.
+		/// </summary>
+		void Flush();
+
+		size_t PendingCount() const;
+
+	private:
+		struct Slot
+		{
+			std::vector<std::function<void()>> Deletions;
+			std::array<vk::Fence, uint32_t(QueueType::Count)> Fences;
+			bool Submitted = false;
+		};
+
+	private:
+		DeviceContext* m_Ctx;
+		std::vector<Slot> m_Slots;
+		mutable std::mutex m_Lock;
+	};
+
+}
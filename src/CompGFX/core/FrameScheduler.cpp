@@ -0,0 +1,96 @@
+#include "FrameScheduler.hpp"
+#include "QueueSubmitter.hpp"
+
+using namespace egx;
+using namespace std;
+
+egx::FrameScheduler::FrameScheduler(DeviceContext* pCtx) : m_Ctx(pCtx)
+{
+	vk::SemaphoreTypeCreateInfo timelineInfo(vk::SemaphoreType::eTimeline, 0);
+	for (uint32_t i = 0; i < QueueCount; i++)
+	{
+		m_Timelines[i] = pCtx->Device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&timelineInfo));
+		m_NextValues[i] = 1;
+		m_FrameValues[i].assign(pCtx->FramesInFlight, 0);
+	}
+	for (uint32_t i = 0; i < pCtx->FramesInFlight; i++)
+		m_PresentReady.push_back(pCtx->Device.createSemaphore({}));
+}
+
+egx::FrameScheduler::~FrameScheduler()
+{
+	m_Ctx->Submitter->Flush();
+	vector<vk::Semaphore> semaphores;
+	vector<uint64_t> values;
+	for (uint32_t i = 0; i < QueueCount; i++)
+		semaphores.push_back(m_Timelines[i]), values.push_back(m_NextValues[i] - 1);
+	auto waitResult = m_Ctx->Device.waitSemaphores(vk::SemaphoreWaitInfo({}, semaphores, values), numeric_limits<uint64_t>::max());
+	if (waitResult != vk::Result::eSuccess)
+		LOG(WARNING, "Waiting for submitted frames failed, Result={}", vk::to_string(waitResult));
+
+	for (auto timeline : m_Timelines)
+		m_Ctx->Device.destroySemaphore(timeline);
+	for (auto semaphore : m_PresentReady)
+		m_Ctx->Device.destroySemaphore(semaphore);
+}
+
+void egx::FrameScheduler::BeginFrame()
+{
+	array<vk::Semaphore, QueueCount> semaphores;
+	array<uint64_t, QueueCount> values;
+	{
+		scoped_lock lock(m_Lock);
+		for (uint32_t i = 0; i < QueueCount; i++)
+			semaphores[i] = m_Timelines[i], values[i] = m_FrameValues[i][m_Ctx->CurrentFrame];
+	}
+	auto waitResult = m_Ctx->Device.waitSemaphores(vk::SemaphoreWaitInfo({}, semaphores, values), numeric_limits<uint64_t>::max());
+	if (waitResult != vk::Result::eSuccess)
+	{
+		throw runtime_error(cpp::Format("Waiting for frame slot {} failed, Result={}", m_Ctx->CurrentFrame, vk::to_string(waitResult)));
+	}
+}
+
+TimelinePoint egx::FrameScheduler::Submit(QueueType queue, const vector<vk::CommandBuffer>& cmds, const vector<SubmitWait>& waits, const vector<vk::Semaphore>& binarySignals)
+{
+	vector<vk::SemaphoreSubmitInfo> waitInfos;
+	for (auto& wait : waits)
+	{
+		auto stage = vk::PipelineStageFlags2(VkPipelineStageFlags2(VkPipelineStageFlags(wait.Stage)));
+		waitInfos.push_back(vk::SemaphoreSubmitInfo(wait.Semaphore, wait.Value, stage));
+	}
+
+	scoped_lock lock(m_Lock);
+	uint32_t index = uint32_t(queue);
+	uint64_t value = m_NextValues[index]++;
+	vector<vk::SemaphoreSubmitInfo> signalInfos = { vk::SemaphoreSubmitInfo(m_Timelines[index], value, vk::PipelineStageFlagBits2::eAllCommands) };
+	for (auto semaphore : binarySignals)
+		signalInfos.push_back(vk::SemaphoreSubmitInfo(semaphore, 0, vk::PipelineStageFlagBits2::eAllCommands));
+	// Emitted with the rest of the frame by QueueSubmitter::Flush()
+	m_Ctx->Submitter->Enqueue(queue, cmds, waitInfos, signalInfos);
+
+	m_FrameValues[index][m_Ctx->CurrentFrame] = value;
+	return { m_Timelines[index], value };
+}
+
+TimelinePoint egx::FrameScheduler::GetLastSubmitted(QueueType queue) const
+{
+	scoped_lock lock(m_Lock);
+	return { m_Timelines[uint32_t(queue)], m_NextValues[uint32_t(queue)] - 1 };
+}
+
+bool egx::FrameScheduler::IsComplete(const TimelinePoint& point) const
+{
+	return m_Ctx->Device.getSemaphoreCounterValue(point.Semaphore) >= point.Value;
+}
+
+void egx::FrameScheduler::Wait(const TimelinePoint& point) const
+{
+	// The value may still be waiting in the submitter
+	m_Ctx->Submitter->Flush();
+	auto waitResult = m_Ctx->Device.waitSemaphores(vk::SemaphoreWaitInfo({}, point.Semaphore, point.Value), numeric_limits<uint64_t>::max());
+	if (waitResult != vk::Result::eSuccess)
+	{
+		throw runtime_error(cpp::Format("Wait Failed on timeline value {}, Result={}", point.Value, vk::to_string(waitResult)));
+	}
+}
+
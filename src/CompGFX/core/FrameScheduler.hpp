@@ -0,0 +1,88 @@
+#pragma once
+#include "egx.hpp"
+#include <array>
+#include <mutex>
+
+namespace egx
+{
+
+	enum class QueueType : uint32_t
+	{
+		Graphics,
+		Compute,
+		Count
+	};
+
+	/// <summary>
+	/// A value on a timeline semaphore, Value is ignored for binary semaphores (swapchain acquire/present).
+	/// </summary>
+	struct TimelinePoint
+	{
+		vk::Semaphore Semaphore;
+		uint64_t Value = 0;
+	};
+
+	struct SubmitWait
+	{
+		vk::Semaphore Semaphore;
+		uint64_t Value = 0;
+		vk::PipelineStageFlags Stage = vk::PipelineStageFlagBits::eAllCommands;
+
+		SubmitWait() = default;
+		SubmitWait(vk::Semaphore semaphore, uint64_t value, vk::PipelineStageFlags stage) : Semaphore(semaphore), Value(value), Stage(stage) {}
+		SubmitWait(const TimelinePoint& point, vk::PipelineStageFlags stage) : Semaphore(point.Semaphore), Value(point.Value), Stage(stage) {}
+	};
+
+	/// <summary>
+	/// Frame pacing on one timeline semaphore per queue. Every Submit() signals the next (monotonically
+	/// increasing) value of its queue's timeline and the last value submitted by each frame slot is kept,
+	/// so BeginFrame() waits for the frame FramesInFlight frames ago with a single vkWaitSemaphores call.
+	/// Dependencies between submits are (semaphore, value) pairs, binary semaphores are only used for the
+	/// swapchain (one present semaphore per frame slot). Replaces IFramedFence/IFramedSemaphore in the render loop.
+	/// Only available when timeline semaphores are enabled.
+	/// </summary>
+	class FrameScheduler
+	{
+	public:
+		FrameScheduler(DeviceContext* pCtx);
+		FrameScheduler(FrameScheduler&) = delete;
+		~FrameScheduler();
+
+		/// <summary>
+		/// Waits until the GPU finished the work the current frame slot submitted FramesInFlight frames ago.
+		/// </summary>
+		void BeginFrame();
+
+		/// <summary>
+		/// Enqueues cmds on the QueueSubmitter, signals the queue's next timeline value (returned) and binarySignals.
+		/// The work reaches the GPU with the frame's flush (DeviceContext::SubmitFrame()).
+		/// </summary>
+		TimelinePoint Submit(QueueType queue, const std::vector<vk::CommandBuffer>& cmds,
+			const std::vector<SubmitWait>& waits = {}, const std::vector<vk::Semaphore>& binarySignals = {});
+
+		/// <summary>
+		/// Binary semaphore of the current frame slot, signal it from the last submit and pass it to Present().
+		/// </summary>
+		vk::Semaphore GetPresentSemaphore() const { return m_PresentReady[m_Ctx->CurrentFrame]; }
+
+		vk::Semaphore GetTimeline(QueueType queue) const { return m_Timelines[uint32_t(queue)]; }
+		/// <summary>
+		/// The last value submitted on queue (not necessarily completed).
+		/// </summary>
+		TimelinePoint GetLastSubmitted(QueueType queue) const;
+		bool IsComplete(const TimelinePoint& point) const;
+		void Wait(const TimelinePoint& point) const;
+
+	private:
+		static constexpr uint32_t QueueCount = uint32_t(QueueType::Count);
+
+		DeviceContext* m_Ctx;
+		std::array<vk::Semaphore, QueueCount> m_Timelines;
+		std::array<uint64_t, QueueCount> m_NextValues;
+		// [queue][frame slot] last value submitted by the slot
+		std::array<std::vector<uint64_t>, QueueCount> m_FrameValues;
+		std::vector<vk::Semaphore> m_PresentReady;
+		mutable std::mutex m_Lock;
+	};
+
+}
@@ -0,0 +1,258 @@
+#include "GpuProfiler.hpp"
+#include "QueueSubmitter.hpp"
+#include <imgui/imgui.h>
+#include <json.hpp>
+#include <fstream>
+#include <algorithm>
+
+using namespace egx;
+using namespace std;
+
+static const char* ToString(QueueType queue)
+{
+	switch (queue)
+	{
+	case QueueType::Graphics: return "Graphics";
+	case QueueType::Compute: return "Compute";
+	default: return "Unknown";
+	}
+}
+
+egx::GpuProfiler::GpuProfiler(DeviceContext* pCtx, uint32_t maxZones) : m_Ctx(pCtx), m_MaxZones(maxZones)
+{
+	const auto physicalDevice = pCtx->PhysicalDeviceQuery.PhysicalDevice;
+	m_TimestampPeriod = physicalDevice.getProperties().limits.timestampPeriod;
+	auto families = physicalDevice.getQueueFamilyProperties();
+	for (uint32_t i = 0; i < QueueCount; i++)
+	{
+		uint32_t validBits = families[_QueueFamily(QueueType(i))].timestampValidBits;
+		m_TimestampMask[i] = validBits >= 64 ? UINT64_MAX : (uint64_t(1) << validBits) - 1;
+	}
+
+	m_Frames.resize(pCtx->FramesInFlight);
+	for (auto& frame : m_Frames)
+	{
+		for (uint32_t i = 0; i < QueueCount; i++)
+		{
+			// Queues without timestamp support never record zones
+			if (m_TimestampMask[i] == 0)
+				continue;
+			frame.Pools[i] = pCtx->Device.createQueryPool(vk::QueryPoolCreateInfo({}, vk::QueryType::eTimestamp, maxZones * 2));
+			frame.ResetPools[i] = pCtx->Device.createCommandPool(
+				vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, _QueueFamily(QueueType(i))));
+			frame.ResetCmds[i] = pCtx->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(frame.ResetPools[i]).setCommandBufferCount(1))[0];
+		}
+	}
+}
+
+egx::GpuProfiler::~GpuProfiler()
+{
+	for (auto& frame : m_Frames)
+	{
+		for (uint32_t i = 0; i < QueueCount; i++)
+		{
+			if (!frame.Pools[i])
+				continue;
+			m_Ctx->Device.destroyQueryPool(frame.Pools[i]);
+			m_Ctx->Device.destroyCommandPool(frame.ResetPools[i]);
+		}
+	}
+}
+
+uint32_t egx::GpuProfiler::Begin(vk::CommandBuffer cmd, const string& name, QueueType queue)
+{
+	if (!m_Enabled)
+		return InvalidZone;
+	scoped_lock lock(m_Lock);
+	auto& frame = _BeginFrame();
+	uint32_t index = uint32_t(queue);
+	if (!frame.Pools[index] || frame.Used[index] + 2 > m_MaxZones * 2)
+		return InvalidZone;
+
+	if (!frame.ResetEnqueued[index])
+	{
+		// Enqueued before the command buffers recording the zones, which are submitted after they were recorded
+		auto resetCmd = frame.ResetCmds[index];
+		resetCmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		resetCmd.resetQueryPool(frame.Pools[index], 0, m_MaxZones * 2);
+		resetCmd.end();
+		m_Ctx->Submitter->Enqueue(queue, { resetCmd });
+		frame.ResetEnqueued[index] = true;
+	}
+
+	uint32_t query = frame.Used[index];
+	frame.Used[index] += 2;
+	if (m_Ctx->Synchronization2Enabled)
+		cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eTopOfPipe, frame.Pools[index], query);
+	else
+		cmd.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, frame.Pools[index], query);
+	uint32_t depth = frame.Depths[cmd]++;
+	frame.Zones.push_back(Zone{ name, queue, depth, query, cmd });
+	return uint32_t(frame.Zones.size() - 1);
+}
+
+void egx::GpuProfiler::End(vk::CommandBuffer cmd, uint32_t zone)
+{
+	if (zone == InvalidZone)
+		return;
+	scoped_lock lock(m_Lock);
+	auto& frame = m_Frames[m_Ctx->CurrentFrame];
+	// The frame moved on since the zone began, its queries were already reset
+	if (frame.FrameNumber != m_Ctx->FrameCount || zone >= frame.Zones.size())
+		return;
+	auto& entry = frame.Zones[zone];
+	auto pool = frame.Pools[uint32_t(entry.Queue)];
+	if (m_Ctx->Synchronization2Enabled)
+		cmd.writeTimestamp2(vk::PipelineStageFlagBits2::eBottomOfPipe, pool, entry.Query + 1);
+	else
+		cmd.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, pool, entry.Query + 1);
+	entry.Ended = true;
+	frame.Depths[entry.Cmd]--;
+}
+
+GpuFrameTimings egx::GpuProfiler::GetLastFrame() const
+{
+	scoped_lock lock(m_Lock);
+	return m_History.size() > 0 ? m_History.back() : GpuFrameTimings();
+}
+
+vector<GpuFrameTimings> egx::GpuProfiler::GetHistory() const
+{
+	scoped_lock lock(m_Lock);
+	return vector<GpuFrameTimings>(m_History.begin(), m_History.end());
+}
+
+GpuProfiler::FrameQueries& egx::GpuProfiler::_BeginFrame()
+{
+	auto& frame = m_Frames[m_Ctx->CurrentFrame];
+	if (frame.FrameNumber == m_Ctx->FrameCount)
+		return frame;
+	// The slot's previous frame retired before the slot is recorded again
+	if (frame.FrameNumber != UINT64_MAX)
+		_Resolve(frame);
+	frame.FrameNumber = m_Ctx->FrameCount;
+	frame.Used = {};
+	frame.ResetEnqueued = {};
+	frame.Zones.clear();
+	frame.Depths.clear();
+	return frame;
+}
+
+void egx::GpuProfiler::_Resolve(FrameQueries& frame)
+{
+	// [value, availability] per query
+	array<vector<uint64_t>, QueueCount> results;
+	for (uint32_t i = 0; i < QueueCount; i++)
+	{
+		if (frame.Used[i] == 0)
+			continue;
+		results[i].resize(size_t(frame.Used[i]) * 2);
+		// eNotReady only means some queries are unavailable, they are skipped below
+		(void)m_Ctx->Device.getQueryPoolResults(frame.Pools[i], 0, frame.Used[i], results[i].size() * sizeof(uint64_t), results[i].data(),
+			2 * sizeof(uint64_t), vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+	}
+
+	GpuFrameTimings timings;
+	timings.FrameNumber = frame.FrameNumber;
+	for (auto& zone : frame.Zones)
+	{
+		const auto& values = results[uint32_t(zone.Queue)];
+		size_t begin = size_t(zone.Query) * 2, end = size_t(zone.Query + 1) * 2;
+		if (!zone.Ended || !values[begin + 1] || !values[end + 1])
+			continue;
+		uint64_t mask = m_TimestampMask[uint32_t(zone.Queue)];
+		double beginNs = double(values[begin] & mask) * m_TimestampPeriod;
+		double endNs = double(values[end] & mask) * m_TimestampPeriod;
+		timings.Zones.push_back(GpuZoneTiming{ zone.Name, zone.Queue, zone.Depth, beginNs, std::max(beginNs, endNs) });
+	}
+	sort(timings.Zones.begin(), timings.Zones.end(), [](const GpuZoneTiming& a, const GpuZoneTiming& b) { return a.BeginNs < b.BeginNs; });
+
+	m_History.push_back(std::move(timings));
+	while (m_History.size() > HistoryLength)
+		m_History.pop_front();
+}
+
+uint32_t egx::GpuProfiler::_QueueFamily(QueueType queue) const
+{
+	switch (queue)
+	{
+	case QueueType::Graphics:
+		return m_Ctx->GraphicsQueueFamilyIndex;
+	case QueueType::Compute:
+		return m_Ctx->ComputeQueueFamilyIndex;
+	default:
+		throw invalid_argument("QueueType is invalid.");
+	}
+}
+
+string egx::GpuProfiler::DumpChromeTrace() const
+{
+	nlohmann::json events = nlohmann::json::array();
+	for (uint32_t i = 0; i < QueueCount; i++)
+	{
+		events.push_back({ {"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", i}, {"args", { {"name", cpp::Format("{} queue", ToString(QueueType(i)))} }} });
+	}
+	for (auto& frame : GetHistory())
+	{
+		for (auto& zone : frame.Zones)
+		{
+			// Chrome traces are in microseconds
+			events.push_back({
+				{"name", zone.Name},
+				{"cat", "gpu"},
+				{"ph", "X"},
+				{"ts", zone.BeginNs / 1000.0},
+				{"dur", (zone.EndNs - zone.BeginNs) / 1000.0},
+				{"pid", 1},
+				{"tid", uint32_t(zone.Queue)},
+				{"args", { {"frame", frame.FrameNumber} }} });
+		}
+	}
+	nlohmann::json root;
+	root["traceEvents"] = events;
+	root["displayTimeUnit"] = "ms";
+	return root.dump();
+}
+
+void egx::GpuProfiler::SaveChromeTrace(const string& filePath) const
+{
+	ofstream file(filePath);
+	if (!file)
+	{
+		throw runtime_error(cpp::Format("Could not open {} to save the GPU trace.", filePath));
+	}
+	file << DumpChromeTrace();
+}
+
+void egx::GpuProfiler::DrawImGuiOverlay(bool* pOpen) const
+{
+	if (!ImGui::Begin("GPU Timings", pOpen))
+	{
+		ImGui::End();
+		return;
+	}
+	if (!m_Enabled)
+		ImGui::TextDisabled("Profiling is disabled, see GpuProfiler::SetEnabled().");
+
+	auto frame = GetLastFrame();
+	double frameBegin = frame.Zones.size() > 0 ? frame.Zones.front().BeginNs : 0.0;
+	double frameEnd = frameBegin;
+	for (auto& zone : frame.Zones)
+		frameEnd = std::max(frameEnd, zone.EndNs);
+	ImGui::Text("Frame %llu, %.3f ms from first to last zone", (unsigned long long)frame.FrameNumber, (frameEnd - frameBegin) / 1e6);
+	ImGui::Separator();
+
+	for (uint32_t i = 0; i < QueueCount; i++)
+	{
+		bool header = false;
+		for (auto& zone : frame.Zones)
+		{
+			if (uint32_t(zone.Queue) != i)
+				continue;
+			if (!header)
+				ImGui::Text("%s queue", ToString(QueueType(i))), header = true;
+			ImGui::Text("%*s%-32s %8.3f ms", int(zone.Depth + 1) * 2, "", zone.Name.c_str(), zone.DurationMs());
+		}
+	}
+	ImGui::End();
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include "egx.hpp"
+#include "FrameScheduler.hpp"
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+
+namespace egx
+{
+
+	struct GpuZoneTiming
+	{
+		std::string Name;
+		QueueType Queue;
+		// Nesting inside the command buffer the zone was recorded in
+		uint32_t Depth;
+		// Device timestamps converted to nanoseconds
+		double BeginNs;
+		double EndNs;
+
+		double DurationMs() const { return (EndNs - BeginNs) / 1e6; }
+	};
+
+	struct GpuFrameTimings
+	{
+		uint64_t FrameNumber = 0;
+		std::vector<GpuZoneTiming> Zones;
+	};
+
+	/// <summary>
+	/// Measures GPU time with timestamp pairs around RenderGraph stages, IRenderStage::Process() and
+	/// IRenderTarget::Begin()/End() (and any Begin()/End() pair recorded by the application).
+	/// Every frame in flight owns its query pools, they are reset by a small command buffer enqueued before the
+	/// first zone of the frame and read back without waiting the next time the frame slot is used, after its fence retired.
+	/// Disabled by default, Begin() returns right away while disabled.
+	/// </summary>
+	class GpuProfiler
+	{
+	public:
+		static constexpr uint32_t InvalidZone = UINT32_MAX;
+
+		/// <param name="maxZones">Zones per frame and queue, later zones are dropped</param>
+		GpuProfiler(DeviceContext* pCtx, uint32_t maxZones = 512);
+		GpuProfiler(GpuProfiler&) = delete;
+		~GpuProfiler();
+
+		void SetEnabled(bool enable) { m_Enabled = enable; }
+		bool IsEnabled() const { return m_Enabled; }
+
+		/// <summary>
+		/// Writes the begin timestamp, the zone must be ended in a command buffer submitted to the same queue.
+		/// Thread safe, returns InvalidZone when disabled, out of queries or the queue has no timestamp support.
+		/// </summary>
+		uint32_t Begin(vk::CommandBuffer cmd, const std::string& name, QueueType queue = QueueType::Graphics);
+		void End(vk::CommandBuffer cmd, uint32_t zone);
+
+		/// <summary>
+		/// The most recent frame whose timestamps were read back, usually FramesInFlight frames old.
+		/// </summary>
+		GpuFrameTimings GetLastFrame() const;
+		std::vector<GpuFrameTimings> GetHistory() const;
+
+		/// <summary>
+		/// The history in the Chrome trace event format (chrome://tracing, Perfetto), one track per queue.
+		/// </summary>
+		std::string DumpChromeTrace() const;
+		void SaveChromeTrace(const std::string& filePath) const;
+
+		void DrawImGuiOverlay(bool* pOpen = nullptr) const;
+
+		struct Scope
+		{
+			GpuProfiler* pProfiler;
+			vk::CommandBuffer Cmd;
+			uint32_t Zone;
+
+			Scope(GpuProfiler* profiler, vk::CommandBuffer cmd, const std::string& name, QueueType queue = QueueType::Graphics)
+				: pProfiler(profiler), Cmd(cmd), Zone(profiler ? profiler->Begin(cmd, name, queue) : InvalidZone) {}
+			Scope(Scope&) = delete;
+			~Scope() { if (pProfiler) pProfiler->End(Cmd, Zone); }
+		};
+
+	private:
+		struct Zone
+		{
+			std::string Name;
+			QueueType Queue;
+			uint32_t Depth;
+			uint32_t Query;
+			vk::CommandBuffer Cmd;
+			bool Ended = false;
+		};
+
+		struct FrameQueries
+		{
+			std::array<vk::QueryPool, uint32_t(QueueType::Count)> Pools;
+			std::array<uint32_t, uint32_t(QueueType::Count)> Used{};
+			std::array<vk::CommandPool, uint32_t(QueueType::Count)> ResetPools;
+			std::array<vk::CommandBuffer, uint32_t(QueueType::Count)> ResetCmds;
+			std::array<bool, uint32_t(QueueType::Count)> ResetEnqueued{};
+			std::vector<Zone> Zones;
+			// [cmd, open zones]
+			std::unordered_map<VkCommandBuffer, uint32_t> Depths;
+			uint64_t FrameNumber = UINT64_MAX;
+		};
+
+		FrameQueries& _BeginFrame();
+		void _Resolve(FrameQueries& frame);
+		uint32_t _QueueFamily(QueueType queue) const;
+
+	private:
+		static constexpr uint32_t QueueCount = uint32_t(QueueType::Count);
+		static constexpr size_t HistoryLength = 240;
+
+		DeviceContext* m_Ctx;
+		uint32_t m_MaxZones;
+		// Toggled from the UI thread while recording threads call Begin()
+		std::atomic<bool> m_Enabled = false;
+		double m_TimestampPeriod;
+		std::array<uint64_t, QueueCount> m_TimestampMask{};
+		std::vector<FrameQueries> m_Frames;
+		std::deque<GpuFrameTimings> m_History;
+		mutable std::mutex m_Lock;
+	};
+
+}
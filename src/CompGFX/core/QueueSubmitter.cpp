@@ -0,0 +1,144 @@
+#include "QueueSubmitter.hpp"
+
+using namespace egx;
+using namespace std;
+
+egx::QueueSubmitter::QueueSubmitter(DeviceContext* pCtx) : m_Ctx(pCtx) {}
+
+void egx::QueueSubmitter::Enqueue(QueueType queue, const vector<vk::CommandBuffer>& cmds, const vector<vk::SemaphoreSubmitInfo>& waits, const vector<vk::SemaphoreSubmitInfo>& signals, vk::Fence fence)
+{
+	Entry entry;
+	for (auto cmd : cmds)
+		entry.Cmds.push_back(vk::CommandBufferSubmitInfo(cmd));
+	entry.Waits = waits;
+	entry.Signals = signals;
+
+	scoped_lock lock(m_Lock);
+	Batch& batch = m_Batches[uint32_t(queue)];
+	batch.Entries.push_back(std::move(entry));
+	if (fence)
+		batch.Fences.push_back(fence);
+}
+
+void egx::QueueSubmitter::Flush()
+{
+	scoped_lock lock(m_Lock, m_QueueLock);
+	for (uint32_t i = 0; i < QueueCount; i++)
+	{
+		Batch& batch = m_Batches[i];
+		if (batch.Entries.empty() && batch.Fences.empty())
+			continue;
+		vk::Queue queue = _GetQueue(QueueType(i));
+		if (m_Ctx->Synchronization2Enabled)
+			_Submit(queue, batch);
+		else
+			_SubmitLegacy(queue, batch);
+		batch.Entries.clear();
+		batch.Fences.clear();
+	}
+}
+
+bool egx::QueueSubmitter::HasPending() const
+{
+	scoped_lock lock(m_Lock);
+	for (auto& batch : m_Batches)
+	{
+		if (batch.Entries.size() > 0 || batch.Fences.size() > 0)
+			return true;
+	}
+	return false;
+}
+
+vk::Result egx::QueueSubmitter::WaitForFences(const vector<vk::Fence>& fences, uint64_t timeout)
+{
+	bool pending = false;
+	{
+		scoped_lock lock(m_Lock);
+		for (auto& batch : m_Batches)
+		{
+			for (auto fence : fences)
+				pending |= find(batch.Fences.begin(), batch.Fences.end(), fence) != batch.Fences.end();
+		}
+	}
+	if (pending)
+		Flush();
+	return m_Ctx->Device.waitForFences(fences, true, timeout);
+}
+
+void egx::QueueSubmitter::_Submit(vk::Queue queue, Batch& batch)
+{
+	vector<vk::SubmitInfo2> submits;
+	submits.reserve(batch.Entries.size());
+	for (auto& entry : batch.Entries)
+		submits.push_back(vk::SubmitInfo2({}, entry.Waits, entry.Cmds, entry.Signals));
+
+	queue.submit2(submits, batch.Fences.size() > 0 ? batch.Fences[0] : vk::Fence());
+	for (size_t i = 1; i < batch.Fences.size(); i++)
+		queue.submit2({}, batch.Fences[i]);
+}
+
+void egx::QueueSubmitter::_SubmitLegacy(vk::Queue queue, Batch& batch)
+{
+	struct LegacyEntry
+	{
+		vector<vk::Semaphore> WaitSemaphores;
+		vector<uint64_t> WaitValues;
+		vector<vk::PipelineStageFlags> WaitStages;
+		vector<vk::CommandBuffer> Cmds;
+		vector<vk::Semaphore> SignalSemaphores;
+		vector<uint64_t> SignalValues;
+		vk::TimelineSemaphoreSubmitInfo TimelineInfo;
+	};
+
+	// The pNext chains point into the entries, they must not move while submitting
+	vector<LegacyEntry> entries(batch.Entries.size());
+	vector<vk::SubmitInfo> submits;
+	for (size_t i = 0; i < batch.Entries.size(); i++)
+	{
+		auto& entry = batch.Entries[i];
+		auto& legacy = entries[i];
+		for (auto& wait : entry.Waits)
+		{
+			// Stages that only exist in synchronization2 have no legacy equivalent
+			auto stage = vk::PipelineStageFlags(VkPipelineStageFlags(VkPipelineStageFlags2(wait.stageMask)));
+			legacy.WaitSemaphores.push_back(wait.semaphore);
+			legacy.WaitValues.push_back(wait.value);
+			legacy.WaitStages.push_back(stage ? stage : vk::PipelineStageFlagBits::eAllCommands);
+		}
+		for (auto& cmd : entry.Cmds)
+			legacy.Cmds.push_back(cmd.commandBuffer);
+		for (auto& signal : entry.Signals)
+		{
+			legacy.SignalSemaphores.push_back(signal.semaphore);
+			legacy.SignalValues.push_back(signal.value);
+		}
+		auto submitInfo = vk::SubmitInfo()
+			.setWaitSemaphores(legacy.WaitSemaphores)
+			.setWaitDstStageMask(legacy.WaitStages)
+			.setCommandBuffers(legacy.Cmds)
+			.setSignalSemaphores(legacy.SignalSemaphores);
+		if (m_Ctx->TimelineSemaphoreEnabled)
+		{
+			legacy.TimelineInfo.setWaitSemaphoreValues(legacy.WaitValues).setSignalSemaphoreValues(legacy.SignalValues);
+			submitInfo.setPNext(&legacy.TimelineInfo);
+		}
+		submits.push_back(submitInfo);
+	}
+
+	queue.submit(submits, batch.Fences.size() > 0 ? batch.Fences[0] : vk::Fence());
+	for (size_t i = 1; i < batch.Fences.size(); i++)
+		queue.submit({}, batch.Fences[i]);
+}
+
+vk::Queue egx::QueueSubmitter::_GetQueue(QueueType queue) const
+{
+	switch (queue)
+	{
+	case QueueType::Graphics:
+		return m_Ctx->Queue;
+	case QueueType::Compute:
+		return m_Ctx->DedicatedCompute;
+	default:
+		throw invalid_argument("QueueType is invalid.");
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "egx.hpp"
+#include "FrameScheduler.hpp"
+#include <mutex>
+
+namespace egx
+{
+
+	/// <summary>
+	/// Collects the command buffers, waits and signals submitted during the frame and emits them as a single
+	/// vkQueueSubmit2 per queue on Flush() (DeviceContext::SubmitFrame(), before the swapchain presents).
+	/// Enqueue() is thread safe and keeps the submission order per queue. A queue submission command
+	/// signals at most one fence, so with several fences the first is attached to the batch and the others are
+	/// signaled by empty submits right after it (they signal once the whole batch completed).
+	/// Falls back to one vkQueueSubmit per queue when synchronization2 is not enabled.
+	/// Fences of enqueued work must not be waited on before a flush, use WaitForFences().
+	/// Code submitting or presenting on a device queue directly must hold LockQueues(), the dedicated queues alias
+	/// the graphics queue when the device has no separate family.
+	/// </summary>
+	class QueueSubmitter
+	{
+	public:
+		QueueSubmitter(DeviceContext* pCtx);
+		QueueSubmitter(QueueSubmitter&) = delete;
+
+		void Enqueue(QueueType queue, const std::vector<vk::CommandBuffer>& cmds,
+			const std::vector<vk::SemaphoreSubmitInfo>& waits = {},
+			const std::vector<vk::SemaphoreSubmitInfo>& signals = {},
+			vk::Fence fence = nullptr);
+
+		/// <summary>
+		/// Submits everything enqueued so far.
+		/// </summary>
+		void Flush();
+		bool HasPending() const;
+
+		/// <summary>
+		/// Flushes when one of the fences belongs to enqueued work, then waits for them.
+		/// </summary>
+		vk::Result WaitForFences(const std::vector<vk::Fence>& fences, uint64_t timeout = std::numeric_limits<uint64_t>::max());
+
+		/// <summary>
+		/// Externally synchronizes vkQueueSubmit and vkQueuePresentKHR with Flush(), held for the lifetime of the lock.
+		/// </summary>
+		std::unique_lock<std::mutex> LockQueues() const { return std::unique_lock<std::mutex>(m_QueueLock); }
+
+	private:
+		struct Entry
+		{
+			std::vector<vk::CommandBufferSubmitInfo> Cmds;
+			std::vector<vk::SemaphoreSubmitInfo> Waits;
+			std::vector<vk::SemaphoreSubmitInfo> Signals;
+		};
+
+		struct Batch
+		{
+			std::vector<Entry> Entries;
+			std::vector<vk::Fence> Fences;
+		};
+
+		void _Submit(vk::Queue queue, Batch& batch);
+		void _SubmitLegacy(vk::Queue queue, Batch& batch);
+		vk::Queue _GetQueue(QueueType queue) const;
+
+	private:
+		static constexpr uint32_t QueueCount = uint32_t(QueueType::Count);
+
+		DeviceContext* m_Ctx;
+		std::array<Batch, QueueCount> m_Batches;
+		mutable std::mutex m_Lock;
+		// Guards direct use of the device queues
+		mutable std::mutex m_QueueLock;
+	};
+
+}
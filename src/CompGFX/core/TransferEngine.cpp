@@ -0,0 +1,250 @@
+#include "TransferEngine.hpp"
+#include "QueueSubmitter.hpp"
+
+using namespace egx;
+using namespace std;
+
+egx::TransferEngine::TransferEngine(DeviceContext* pCtx) : m_Ctx(pCtx)
+{
+	vk::SemaphoreTypeCreateInfo timelineInfo(vk::SemaphoreType::eTimeline, 0);
+	m_Timeline = pCtx->Device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&timelineInfo));
+	m_AcquireTimeline = pCtx->Device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&timelineInfo));
+
+	auto flags = vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+	m_TransferPool = pCtx->Device.createCommandPool(vk::CommandPoolCreateInfo(flags, pCtx->TransferQueueFamilyIndex));
+	m_GraphicsPool = pCtx->Device.createCommandPool(vk::CommandPoolCreateInfo(flags, pCtx->GraphicsQueueFamilyIndex));
+}
+
+egx::TransferEngine::~TransferEngine()
+{
+	// Enqueued acquires have to reach the queue before their values can be waited on
+	m_Ctx->Submitter->Flush();
+	array<vk::Semaphore, 2> semaphores = { m_Timeline, m_AcquireTimeline };
+	array<uint64_t, 2> values = { m_NextValue - 1, m_NextAcquireValue - 1 };
+	auto waitResult = m_Ctx->Device.waitSemaphores(vk::SemaphoreWaitInfo({}, semaphores, values), numeric_limits<uint64_t>::max());
+	if (waitResult != vk::Result::eSuccess)
+		LOG(WARNING, "Waiting for pending transfers failed, Result={}", vk::to_string(waitResult));
+
+	_Retire();
+	for (auto& block : m_Recording.Staging)
+		m_Ctx->StagingBlocks->Release(block);
+	m_Ctx->Device.destroyCommandPool(m_TransferPool);
+	m_Ctx->Device.destroyCommandPool(m_GraphicsPool);
+	m_Ctx->Device.destroySemaphore(m_Timeline);
+	m_Ctx->Device.destroySemaphore(m_AcquireTimeline);
+}
+
+TransferToken egx::TransferEngine::UploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* pData, vk::DeviceSize size)
+{
+	scoped_lock lock(m_Lock);
+	vk::CommandBuffer cmd = _BeginRecording();
+	auto [stagingBuffer, stagingOffset] = _Stage(pData, size);
+	cmd.copyBuffer(stagingBuffer, dst, vk::BufferCopy(stagingOffset, dstOffset, size));
+
+	uint32_t srcFamily = VK_QUEUE_FAMILY_IGNORED, dstFamily = VK_QUEUE_FAMILY_IGNORED;
+	if (_RequiresOwnershipTransfer())
+		srcFamily = m_Ctx->TransferQueueFamilyIndex, dstFamily = m_Ctx->GraphicsQueueFamilyIndex;
+
+	// Release
+	vk::BufferMemoryBarrier release(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eNone, srcFamily, dstFamily, dst, dstOffset, size);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, release, {});
+
+	Acquire acquire{};
+	acquire.Value = m_Recording.Value;
+	acquire.BufferBarrier = vk::BufferMemoryBarrier(vk::AccessFlagBits::eNone, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite,
+		srcFamily, dstFamily, dst, dstOffset, size);
+	acquire.IsImage = false;
+	m_PendingAcquires.push_back(acquire);
+	return { m_Recording.Value };
+}
+
+TransferToken egx::TransferEngine::UploadImage(vk::Image dst, vk::ImageAspectFlags aspect, int mipLevel, int width, int height,
+	const void* pData, vk::DeviceSize size, vk::ImageLayout finalLayout)
+{
+	scoped_lock lock(m_Lock);
+	vk::CommandBuffer cmd = _BeginRecording();
+	auto [stagingBuffer, stagingOffset] = _Stage(pData, size);
+
+	vk::ImageSubresourceRange range(aspect, mipLevel, 1, 0, 1);
+	// The previous contents are discarded, see the class description
+	vk::ImageMemoryBarrier toTransfer(vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite,
+		vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dst, range);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, toTransfer);
+
+	vk::BufferImageCopy region;
+	region.bufferOffset = stagingOffset;
+	region.imageSubresource = vk::ImageSubresourceLayers(aspect, mipLevel, 0, 1);
+	region.imageExtent = vk::Extent3D(width, height, 1);
+	cmd.copyBufferToImage(stagingBuffer, dst, vk::ImageLayout::eTransferDstOptimal, region);
+
+	Acquire acquire{};
+	acquire.Value = m_Recording.Value;
+	acquire.IsImage = true;
+	if (_RequiresOwnershipTransfer())
+	{
+		// The layout transition happens as part of the release/acquire pair
+		uint32_t srcFamily = m_Ctx->TransferQueueFamilyIndex, dstFamily = m_Ctx->GraphicsQueueFamilyIndex;
+		vk::ImageMemoryBarrier release(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eNone,
+			vk::ImageLayout::eTransferDstOptimal, finalLayout, srcFamily, dstFamily, dst, range);
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, release);
+		acquire.ImageBarrier = vk::ImageMemoryBarrier(vk::AccessFlagBits::eNone, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite,
+			vk::ImageLayout::eTransferDstOptimal, finalLayout, srcFamily, dstFamily, dst, range);
+	}
+	else
+	{
+		vk::ImageMemoryBarrier toFinal(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eNone,
+			vk::ImageLayout::eTransferDstOptimal, finalLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dst, range);
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe, {}, {}, {}, toFinal);
+		acquire.ImageBarrier = vk::ImageMemoryBarrier(vk::AccessFlagBits::eNone, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite,
+			finalLayout, finalLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, dst, range);
+	}
+	m_PendingAcquires.push_back(acquire);
+	return { m_Recording.Value };
+}
+
+TransferToken egx::TransferEngine::Submit()
+{
+	scoped_lock lock(m_Lock);
+	if (!m_Recording.Cmd)
+		return { m_NextValue - 1 };
+
+	m_Recording.Cmd.end();
+	vk::TimelineSemaphoreSubmitInfo timelineInfo;
+	timelineInfo.setSignalSemaphoreValues(m_Recording.Value);
+	auto submitInfo = vk::SubmitInfo()
+		.setPNext(&timelineInfo)
+		.setCommandBuffers(m_Recording.Cmd)
+		.setSignalSemaphores(m_Timeline);
+	{
+		// DedicatedTransfer is the graphics queue when the device has no transfer family
+		auto queueLock = m_Ctx->Submitter->LockQueues();
+		m_Ctx->DedicatedTransfer.submit(submitInfo);
+	}
+
+	TransferToken token{ m_Recording.Value };
+	m_InFlight.push_back(std::move(m_Recording));
+	m_Recording = {};
+	m_NextValue++;
+	_Retire();
+	return token;
+}
+
+bool egx::TransferEngine::IsComplete(TransferToken token) const
+{
+	return m_Ctx->Device.getSemaphoreCounterValue(m_Timeline) >= token.Value;
+}
+
+bool egx::TransferEngine::IsIdle() const
+{
+	scoped_lock lock(m_Lock);
+	if (m_Recording.Cmd || !m_PendingAcquires.empty())
+		return false;
+	return m_Ctx->Device.getSemaphoreCounterValue(m_Timeline) >= m_NextValue - 1;
+}
+
+void egx::TransferEngine::Wait(TransferToken token) const
+{
+	{
+		scoped_lock lock(m_Lock);
+		if (token.Value >= m_NextValue)
+			throw runtime_error(cpp::Format("Cannot wait on transfer token {} before it was submitted.", token.Value));
+	}
+	auto waitResult = m_Ctx->Device.waitSemaphores(vk::SemaphoreWaitInfo({}, m_Timeline, token.Value), numeric_limits<uint64_t>::max());
+	if (waitResult != vk::Result::eSuccess)
+		throw runtime_error(cpp::Format("Wait Failed on transfer token {}, Result={}", token.Value, vk::to_string(waitResult)));
+}
+
+void egx::TransferEngine::Require(TransferToken token)
+{
+	scoped_lock lock(m_Lock);
+	m_RequiredValue = max(m_RequiredValue, token.Value);
+}
+
+void egx::TransferEngine::FlushAcquires()
+{
+	scoped_lock lock(m_Lock);
+	_Retire();
+	if (m_PendingAcquires.empty())
+		return;
+
+	// Tokens of the batch still being recorded cannot be acquired yet
+	uint64_t target = max(m_Ctx->Device.getSemaphoreCounterValue(m_Timeline), min(m_RequiredValue, m_NextValue - 1));
+
+	vector<vk::BufferMemoryBarrier> bufferBarriers;
+	vector<vk::ImageMemoryBarrier> imageBarriers;
+	uint64_t waitValue = 0;
+	erase_if(m_PendingAcquires, [&](const Acquire& acquire) {
+		if (acquire.Value > target)
+			return false;
+		if (acquire.IsImage)
+			imageBarriers.push_back(acquire.ImageBarrier);
+		else
+			bufferBarriers.push_back(acquire.BufferBarrier);
+		waitValue = max(waitValue, acquire.Value);
+		return true;
+	});
+	if (waitValue == 0)
+		return;
+
+	AcquireBatch batch;
+	batch.Value = m_NextAcquireValue++;
+	batch.Cmd = m_Ctx->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_GraphicsPool, vk::CommandBufferLevel::ePrimary, 1))[0];
+	batch.Cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	batch.Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eAllCommands, {}, {}, bufferBarriers, imageBarriers);
+	batch.Cmd.end();
+
+	// Goes out with the frame's flush, ahead of the graphics work FlushUploads() callers enqueue afterwards
+	m_Ctx->Submitter->Enqueue(QueueType::Graphics, { batch.Cmd },
+		{ vk::SemaphoreSubmitInfo(m_Timeline, waitValue, vk::PipelineStageFlagBits2::eAllCommands) },
+		{ vk::SemaphoreSubmitInfo(m_AcquireTimeline, batch.Value, vk::PipelineStageFlagBits2::eAllCommands) });
+	m_InFlightAcquires.push_back(batch);
+
+	if (m_RequiredValue <= target)
+		m_RequiredValue = 0;
+}
+
+vk::CommandBuffer egx::TransferEngine::_BeginRecording()
+{
+	if (m_Recording.Cmd)
+		return m_Recording.Cmd;
+	m_Recording.Value = m_NextValue;
+	m_Recording.Cmd = m_Ctx->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_TransferPool, vk::CommandBufferLevel::ePrimary, 1))[0];
+	m_Recording.Cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	return m_Recording.Cmd;
+}
+
+std::pair<VkBuffer, vk::DeviceSize> egx::TransferEngine::_Stage(const void* pData, vk::DeviceSize size)
+{
+	// Streaming uploads reuse the pooled blocks instead of creating a buffer each
+	StagingBlock block = m_Ctx->StagingBlocks->Acquire(size);
+	memcpy(block.Mapped, pData, size);
+	vmaFlushAllocation(m_Ctx->Allocator, block.Allocation, 0, size);
+	m_Recording.Staging.push_back(block);
+	return { block.Buffer, 0 };
+}
+
+bool egx::TransferEngine::_RequiresOwnershipTransfer() const
+{
+	return m_Ctx->TransferQueueFamilyIndex != m_Ctx->GraphicsQueueFamilyIndex;
+}
+
+void egx::TransferEngine::_Retire()
+{
+	uint64_t completed = m_Ctx->Device.getSemaphoreCounterValue(m_Timeline);
+	erase_if(m_InFlight, [&](Batch& batch) {
+		if (batch.Value > completed)
+			return false;
+		for (auto& block : batch.Staging)
+			m_Ctx->StagingBlocks->Release(block);
+		m_Ctx->Device.freeCommandBuffers(m_TransferPool, batch.Cmd);
+		return true;
+	});
+
+	uint64_t acquired = m_Ctx->Device.getSemaphoreCounterValue(m_AcquireTimeline);
+	erase_if(m_InFlightAcquires, [&](AcquireBatch& batch) {
+		if (batch.Value > acquired)
+			return false;
+		m_Ctx->Device.freeCommandBuffers(m_GraphicsPool, batch.Cmd);
+		return true;
+	});
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "egx.hpp"
+#include <memory/egxstagingpool.hpp>
+#include <mutex>
+
+namespace egx
+{
+
+	/// <summary>
+	/// Completion token of a transfer batch, the value the transfer timeline semaphore
+	/// reaches once the batch finished. Value 0 means there was nothing to wait for.
+	/// </summary>
+	struct TransferToken
+	{
+		uint64_t Value = 0;
+
+		bool IsNull() const { return Value == 0; }
+	};
+
+	/// <summary>
+	/// Records uploads on the dedicated transfer queue and signals a timeline semaphore per batch.
+	/// When the transfer family differs from the graphics family the destination is released by the
+	/// transfer queue and acquired again on the graphics queue. Acquires are enqueued by FlushAcquires()
+	/// (called from DeviceContext::FlushUploads()) once their batch completed, so streaming never stalls the
+	/// graphics queue unless the data was explicitly requested through Require().
+	/// The previous contents of the destination are not preserved across the ownership transfer,
+	/// async writes are meant for freshly created or fully rewritten resources.
+	/// The data is staged in blocks borrowed from DeviceContext::StagingBlocks, returned once the batch retired.
+	/// </summary>
+	class TransferEngine
+	{
+	public:
+		TransferEngine(DeviceContext* pCtx);
+		TransferEngine(TransferEngine&) = delete;
+		~TransferEngine();
+
+		TransferToken UploadBuffer(vk::Buffer dst, vk::DeviceSize dstOffset, const void* pData, vk::DeviceSize size);
+		TransferToken UploadImage(vk::Image dst, vk::ImageAspectFlags aspect, int mipLevel, int width, int height,
+			const void* pData, vk::DeviceSize size, vk::ImageLayout finalLayout);
+
+		/// <summary>
+		/// Submits the batch recorded so far and returns its token.
+		/// </summary>
+		TransferToken Submit();
+
+		bool IsComplete(TransferToken token) const;
+		void Wait(TransferToken token) const;
+
+		/// <summary>
+		/// The next FlushAcquires() acquires everything up to token even if the transfer is still running,
+		/// the graphics queue then waits on the GPU for the token instead of the CPU.
+		/// </summary>
+		void Require(TransferToken token);
+
+		/// <summary>
+		/// Enqueues the graphics queue side of completed (or required) ownership transfers on the QueueSubmitter,
+		/// call it before enqueuing the graphics work that uses them.
+		/// </summary>
+		void FlushAcquires();
+
+		/// <summary>
+		/// Nothing is recorded, running on the transfer queue or waiting to be acquired.
+		/// </summary>
+		bool IsIdle() const;
+
+		vk::Semaphore GetTimelineSemaphore() const { return m_Timeline; }
+
+	private:
+		struct Acquire
+		{
+			uint64_t Value;
+			vk::BufferMemoryBarrier BufferBarrier;
+			vk::ImageMemoryBarrier ImageBarrier;
+			bool IsImage;
+		};
+
+		struct Batch
+		{
+			uint64_t Value = 0;
+			vk::CommandBuffer Cmd;
+			std::vector<StagingBlock> Staging;
+		};
+
+		struct AcquireBatch
+		{
+			uint64_t Value = 0;
+			vk::CommandBuffer Cmd;
+		};
+
+		vk::CommandBuffer _BeginRecording();
+		std::pair<VkBuffer, vk::DeviceSize> _Stage(const void* pData, vk::DeviceSize size);
+		bool _RequiresOwnershipTransfer() const;
+		void _Retire();
+
+	private:
+		DeviceContext* m_Ctx;
+		vk::Semaphore m_Timeline;
+		vk::Semaphore m_AcquireTimeline;
+		vk::CommandPool m_TransferPool;
+		vk::CommandPool m_GraphicsPool;
+
+		Batch m_Recording;
+		std::vector<Batch> m_InFlight;
+		std::vector<Acquire> m_PendingAcquires;
+		std::vector<AcquireBatch> m_InFlightAcquires;
+		uint64_t m_NextValue = 1;
+		uint64_t m_NextAcquireValue = 1;
+		uint64_t m_RequiredValue = 0;
+		mutable std::mutex m_Lock;
+	};
+
+}
@@ -1,4 +1,19 @@
 #include "egx.hpp"
+#include <memory/egxstaging.hpp>
+#include <memory/egxstagingpool.hpp>
+#include <memory/egxreadback.hpp>
+#include <memory/egxdirtyranges.hpp>
+#include <memory/egxmemorystats.hpp>
+#include <memory/egxdefrag.hpp>
+#include <core/TransferEngine.hpp>
+#include <core/FrameScheduler.hpp>
+#include <core/QueueSubmitter.hpp>
+#include <core/GpuProfiler.hpp>
+#include <core/DeletionQueue.hpp>
+#include <pipeline/PersistentPipelineCache.hpp>
+#include <pipeline/PipelineCompiler.hpp>
+#include <pipeline/LayoutCache.hpp>
+#include <ext/ZoneProfiler.hpp>
 #include <vulkan/vulkan.hpp>
 #include <GLFW/glfw3.h>
 
@@ -209,6 +224,42 @@ std::vector<PhysicalDeviceAndQueueFamilyInfo> egx::VulkanICDState::QueryGPGPUDev
 	return query;
 }
 
+static bool IsTimelineSemaphoreEnabled(const VkPhysicalDeviceFeatures2& features)
+{
+	for (auto pNext = (const VkBaseInStructure*)features.pNext; pNext; pNext = pNext->pNext)
+	{
+		if (pNext->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES)
+		{
+			if (((const VkPhysicalDeviceVulkan12Features*)pNext)->timelineSemaphore)
+				return true;
+		}
+		else if (pNext->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES)
+		{
+			if (((const VkPhysicalDeviceTimelineSemaphoreFeatures*)pNext)->timelineSemaphore)
+				return true;
+		}
+	}
+	return false;
+}
+
+static bool IsSynchronization2Enabled(const VkPhysicalDeviceFeatures2& features)
+{
+	for (auto pNext = (const VkBaseInStructure*)features.pNext; pNext; pNext = pNext->pNext)
+	{
+		if (pNext->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES)
+		{
+			if (((const VkPhysicalDeviceVulkan13Features*)pNext)->synchronization2)
+				return true;
+		}
+		else if (pNext->sType == VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES)
+		{
+			if (((const VkPhysicalDeviceSynchronization2Features*)pNext)->synchronization2)
+				return true;
+		}
+	}
+	return false;
+}
+
 DeviceCtx egx::VulkanICDState::CreateDevice(const PhysicalDeviceAndQueueFamilyInfo& deviceQuery, uint32_t max_frames_in_flight)
 {
 	int32_t graphics = -1, compute = -1, transfer = -1;
@@ -284,6 +335,13 @@ DeviceCtx egx::VulkanICDState::CreateDevice(const PhysicalDeviceAndQueueFamilyIn
 		enabledExtensions.push_back(VK_KHR_SHADER_NON_SEMANTIC_INFO_EXTENSION_NAME);
 	}
 
+	// Lets VMA report the driver's budget instead of an estimate
+	bool memoryBudget = deviceQuery.SupportExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memoryBudget)
+	{
+		enabledExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+
 	vk::DeviceCreateInfo createInfo;
 	createInfo.pNext = &deviceQuery.EnabledFeatures;
 	createInfo.pQueueCreateInfos = queueCreateInfos;
@@ -304,6 +362,11 @@ DeviceCtx egx::VulkanICDState::CreateDevice(const PhysicalDeviceAndQueueFamilyIn
 	ctx->Device = device;
 	ctx->ICDState = shared_from_this();
 	ctx->pLogger = pOptionalLogger;
+	ctx->MemoryBudgetExtensionEnabled = memoryBudget;
+	// The feature chain belongs to the caller and is only valid during this call
+	ctx->TimelineSemaphoreEnabled = IsTimelineSemaphoreEnabled(deviceQuery.EnabledFeatures);
+	ctx->Synchronization2Enabled = IsSynchronization2Enabled(deviceQuery.EnabledFeatures);
+	ctx->PhysicalDeviceQuery.EnabledFeatures.pNext = nullptr;
 
 	ctx->Queue = device.getQueue(graphics, 0);
 	ctx->GraphicsQueueFamilyIndex = graphics;
@@ -340,15 +403,110 @@ DeviceCtx egx::VulkanICDState::CreateDevice(const PhysicalDeviceAndQueueFamilyIn
 	allocatorCreateInfo.device = device;
 	allocatorCreateInfo.instance = m_Instance;
 	allocatorCreateInfo.pVulkanFunctions = &vulkanFunctions;
+	if (memoryBudget)
+		allocatorCreateInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
 
 	vmaCreateAllocator(&allocatorCreateInfo, &ctx->Allocator);
 	ctx->FramesInFlight = max_frames_in_flight;
+	ctx->Submitter = make_shared<QueueSubmitter>(ctx.get());
+	ctx->Deletion = make_shared<DeletionQueue>(ctx.get());
+	ctx->PipelineCache = make_shared<PersistentPipelineCache>(ctx.get());
+	ctx->Layouts = make_shared<LayoutCache>(ctx.get());
+	ctx->Compiler = make_shared<PipelineCompiler>(ctx.get());
+	ctx->DirtyRanges = make_shared<DirtyRangeTracker>(ctx->Allocator);
+	ctx->Telemetry = make_shared<MemoryTelemetry>(ctx.get());
+	ctx->Defrag = make_shared<Defragmenter>(ctx.get());
+	ctx->StagingBlocks = make_shared<StagingPool>(ctx.get());
+	ctx->Staging = make_shared<StagingRing>(ctx.get());
+	ctx->Readback = make_shared<ReadbackQueue>(ctx.get());
+	ctx->Profiler = make_shared<GpuProfiler>(ctx.get());
+	if (ctx->TimelineSemaphoreEnabled)
+	{
+		ctx->Transfer = make_shared<TransferEngine>(ctx.get());
+		ctx->Scheduler = make_shared<FrameScheduler>(ctx.get());
+	}
 	return ctx;
 }
 
+void DeviceContext::FlushUploads()
+{
+	if (DirtyRanges)
+		DirtyRanges->Flush();
+	if (Staging)
+		Staging->FlushUploads();
+	if (Transfer)
+	{
+		Transfer->Submit();
+		Transfer->FlushAcquires();
+	}
+}
+
+void DeviceContext::SubmitFrame()
+{
+	FlushUploads();
+	// Enqueued after the frame's work, the readbacks observe everything it rendered
+	if (Readback)
+		Readback->Submit();
+	// Enqueued after the uploads so the relocation copies see them
+	if (Defrag)
+		Defrag->Step();
+	if (Submitter)
+		Submitter->Flush();
+}
+
+void DeviceContext::NextFrame()
+{
+	// Enqueued before the submit, the fences retire with the frame
+	if (Deletion)
+		Deletion->EndFrame();
+	SubmitFrame();
+	CurrentFrame++, CurrentFrame %= FramesInFlight;
+	FrameCount++;
+	if (Deletion)
+		Deletion->Collect();
+	// Refreshes the heap budget
+	vmaSetCurrentFrameIndex(Allocator, (uint32_t)FrameCount);
+	if (Readback)
+		Readback->Poll();
+	if (StagingBlocks)
+		StagingBlocks->Collect();
+	if (Telemetry)
+		Telemetry->CheckBudget();
+	if (PipelineCache)
+		PipelineCache->Tick();
+	if (Compiler)
+		Compiler->Commit();
+	ZoneProfiler::Get().EndFrame();
+}
+
 DeviceContext::~DeviceContext()
 {
+	// Joins the workers before anything they build with goes away
+	Compiler.reset();
+	if (Submitter)
+		Submitter->Flush();
 	Device.waitIdle();
+	if (Deletion)
+		Deletion->Flush();
+	Scheduler.reset();
+	Profiler.reset();
+	// Saves the cache
+	PipelineCache.reset();
+	// Every pipeline is gone, the flush above destroyed the layouts they released
+	Layouts.reset();
+	Defrag.reset();
+	Readback.reset();
+	Staging.reset();
+	// Returns its staging blocks to the pool
+	Transfer.reset();
+	StagingBlocks.reset();
+	DirtyRanges.reset();
+	Telemetry.reset();
+	Deletion.reset();
+	// Destructors above may still have enqueued work
+	if (Submitter)
+		Submitter->Flush();
+	Submitter.reset();
 	vmaDestroyAllocator(Allocator);
 	Device.destroy();
 }
@@ -16,7 +16,7 @@ namespace egx
 		VkPhysicalDeviceFeatures2 EnabledFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
 		bool SupportSwapchain = false;
 
-		bool SupportExtension(const char* pExtensionName)
+		bool SupportExtension(const char* pExtensionName) const
 		{
 			auto extensions = PhysicalDevice.enumerateDeviceExtensionProperties();
 			for (auto& e : extensions)
@@ -29,14 +29,33 @@ namespace egx
 	};
 
 	class VulkanICDState;
+	class StagingRing;
+	class StagingPool;
+	class ReadbackQueue;
+	class DirtyRangeTracker;
+	class MemoryTelemetry;
+	class TransferEngine;
+	class Defragmenter;
+	class FrameScheduler;
+	class QueueSubmitter;
+	class GpuProfiler;
+	class DeletionQueue;
+	class PersistentPipelineCache;
+	class PipelineCompiler;
+	class LayoutCache;
 
 	struct DeviceContext
 	{
 		PhysicalDeviceAndQueueFamilyInfo PhysicalDeviceQuery;
 		bool SwapchainExtensionEnable = false;
+		bool TimelineSemaphoreEnabled = false;
+		bool Synchronization2Enabled = false;
+		bool MemoryBudgetExtensionEnabled = false;
 
 		uint32_t FramesInFlight = 1;
 		uint32_t CurrentFrame = 0;
+		// Total number of NextFrame() calls, unlike CurrentFrame it never wraps around
+		uint64_t FrameCount = 0;
 
 		vk::Device Device;
 		vk::Queue Queue;
@@ -50,6 +69,21 @@ namespace egx
 
 		cpp::Logger* pLogger;
 		std::shared_ptr<VulkanICDState> ICDState;
+		std::shared_ptr<QueueSubmitter> Submitter;
+		std::shared_ptr<StagingRing> Staging;
+		std::shared_ptr<StagingPool> StagingBlocks;
+		std::shared_ptr<ReadbackQueue> Readback;
+		std::shared_ptr<DirtyRangeTracker> DirtyRanges;
+		std::shared_ptr<MemoryTelemetry> Telemetry;
+		std::shared_ptr<Defragmenter> Defrag;
+		std::shared_ptr<GpuProfiler> Profiler;
+		std::shared_ptr<DeletionQueue> Deletion;
+		std::shared_ptr<PersistentPipelineCache> PipelineCache;
+		std::shared_ptr<PipelineCompiler> Compiler;
+		std::shared_ptr<LayoutCache> Layouts;
+		// Only available when the timeline semaphore feature was enabled
+		std::shared_ptr<TransferEngine> Transfer;
+		std::shared_ptr<FrameScheduler> Scheduler;
 
 		~DeviceContext();
 
@@ -59,9 +93,23 @@ namespace egx
 			pLogger->print(level, file, ln, message, std::forward(args));
 		}
 
-		void NextFrame() {
-			CurrentFrame++, CurrentFrame %= FramesInFlight;
-		}
+		/// <summary>
+		/// Flushes the dirty ranges of mapped memory, then submits every upload recorded
+		/// into the staging ring so far together with the pending transfer queue batch
+		/// and the ownership acquires of completed transfers.
+		/// Must be called before submitting work that reads the uploaded data.
+		/// </summary>
+		void FlushUploads();
+		/// <summary>
+		/// Flushes the uploads, records the frame's readbacks and defragmentation copies and submits
+		/// everything the QueueSubmitter collected this frame. Called before presenting and by NextFrame().
+		/// </summary>
+		void SubmitFrame();
+		/// <summary>
+		/// Submits the frame, moves on to the next frame slot, runs the deletions that slot deferred
+		/// and swaps in the pipelines the PipelineCompiler finished.
+		/// </summary>
+		void NextFrame();
 	};
 
 	using DeviceCtx = std::shared_ptr<DeviceContext>;
@@ -2,11 +2,29 @@
 #include "egx.hpp"
 #include <memory/egxbuffer.hpp>
 #include <memory/egximage.hpp>
+#include <memory/egxstaging.hpp>
+#include <memory/egxstagingpool.hpp>
+#include <memory/egxreadback.hpp>
+#include <memory/egxdirtyranges.hpp>
+#include <memory/egxmemorystats.hpp>
+#include <memory/egxdefrag.hpp>
+#include <memory/egxframearena.hpp>
+#include <core/TransferEngine.hpp>
+#include <core/FrameScheduler.hpp>
+#include <core/QueueSubmitter.hpp>
+#include <core/GpuProfiler.hpp>
+#include <core/DeletionQueue.hpp>
+#include <ext/ZoneProfiler.hpp>
 #include <pipeline/Sampler.hpp>
 #include <pipeline/pipeline.hpp>
+#include <pipeline/PersistentPipelineCache.hpp>
+#include <pipeline/PipelineCompiler.hpp>
+#include <pipeline/LayoutCache.hpp>
 #include <pipeline/RenderTarget.hpp>
 #include <pipeline/DearImGuiController.hpp>
 #include <pipeline/shaders/shader.hpp>
+#include <pipeline/shaders/ShaderArchive.hpp>
+#include <pipeline/shaders/ShaderHotReload.hpp>
 #include <pipeline/ShaderBinding.hpp>
 #include <window/BitmapWindow.hpp>
 #include <window/PlatformWindow.hpp>
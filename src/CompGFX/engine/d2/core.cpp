@@ -1,7 +1,10 @@
 #include "core.hpp"
+#include <core/QueueSubmitter.hpp>
+#include <pipeline/shaders/ShaderArchive.hpp>
 #include <stb/stb_image.h>
 #include <stb/stb_image_write.h>
 #include <Utility/CppUtility.hpp>
+#include <thread>
 
 using namespace egx::d2;
 using namespace std;
@@ -256,14 +259,35 @@ void egx::d2::Canvas::SaveScreenshotToDisk(const std::string& filepath)
 	stbi_write_png(filepath.c_str(), w, h, 4, buffer.data(), w * 4);
 }
 
+egx::ReadbackHandle egx::d2::Canvas::SaveScreenshotToDiskAsync(const std::string& filepath)
+{
+	const auto w = m_renderTarget.Width();
+	const auto h = m_renderTarget.Height();
+	return m_renderTarget.GetAttachment(0).ReadAsync(0, [filepath, w, h](const vector<uint8_t>& data) {
+		thread([filepath, w, h, pixels = data]() {
+			stbi_write_png(filepath.c_str(), w, h, 4, pixels.data(), w * 4);
+		}).detach();
+	});
+}
+
 void egx::d2::Scene::Init(const egx::DeviceCtx& ctx, const Canvas& canvas)
 {
 	m_ctx = ctx;
 	m_canvas = canvas;
-	m_drawCallData = Buffer(ctx, 1024 * 1024, egx::MemoryPreset::DeviceAndHost, egx::HostMemoryAccess::Sequential, vk::BufferUsageFlagBits::eStorageBuffer, true);
-	m_transformData = Buffer(ctx, 100 * sizeof(glm::mat4), egx::MemoryPreset::DeviceAndHost, egx::HostMemoryAccess::Sequential, vk::BufferUsageFlagBits::eStorageBuffer, true);
-	Shader vertex(ctx, "C:\\Users\\youssef\\source\\repos\\CompGFX\\src\\CompGFX\\internal_assets\\d2\\body_vertex_shader.vert");
-	Shader fragment(ctx, "C:\\Users\\youssef\\source\\repos\\CompGFX\\src\\CompGFX\\internal_assets\\d2\\body_fragment_shader.frag");
+	m_drawCallData = Buffer(ctx, 1024 * 1024, egx::MemoryPreset::DeviceAndHost, egx::HostMemoryAccess::Sequential, vk::BufferUsageFlagBits::eStorageBuffer, true, true);
+	m_transformData = Buffer(ctx, 100 * sizeof(glm::mat4), egx::MemoryPreset::DeviceAndHost, egx::HostMemoryAccess::Sequential, vk::BufferUsageFlagBits::eStorageBuffer, true, true);
+	m_drawCallData.SetGrowthPolicy({ .MinCapacity = 1024 * 1024 });
+	m_transformData.SetGrowthPolicy({ .MinCapacity = 100 * sizeof(glm::mat4) });
+	// Packs are built with egx-shaderc from internal_assets/
+	Shader vertex, fragment;
+	if (auto pack = Shader::GetGlobalPack()) {
+		vertex = Shader(ctx, *pack, "d2/body_vertex_shader.vert");
+		fragment = Shader(ctx, *pack, "d2/body_fragment_shader.frag");
+	}
+	else {
+		vertex = Shader(ctx, "internal_assets/d2/body_vertex_shader.vert");
+		fragment = Shader(ctx, "internal_assets/d2/body_fragment_shader.frag");
+	}
 	PipelineSpecification spec;
 	spec
 		.SetFrontFace(vk::FrontFace::eClockwise).SetCullMode(vk::CullModeFlagBits::eNone)
@@ -289,13 +313,9 @@ void egx::d2::Scene::Paint()
 	// 1) Upload nodes into gpu buffer
 	size_t vertices_count = bodies.size();
 	size_t vertices_size = vertices_count * sizeof(DrawCall);
-	if (m_drawCallData.Size() < vertices_size) {
-		m_drawCallData.Resize(vertices_size);
-	}
-	// (TODO): Make minimim buffer size
-	else if (m_drawCallData.Size() > vertices_size * 2) {
-		m_drawCallData.Resize(vertices_size);
-	}
+	// The growth policy decides when the allocations actually change
+	m_drawCallData.Resize(std::max(vertices_size, sizeof(DrawCall)));
+	m_transformData.Resize(std::max(vertices_count, size_t(1)) * sizeof(mat4));
 	uint8_t* vt_ptr = (uint8_t*)m_drawCallData.Map();
 	uint8_t* tf_ptr = (uint8_t*)m_transformData.Map();
 	size_t vt_offset = 0;
@@ -314,8 +334,8 @@ void egx::d2::Scene::Paint()
 		vt_offset += sizeof(DrawCall);
 		tf_offset += sizeof(mat4);
 	}
-	m_drawCallData.FlushToGpu();
-	m_transformData.FlushToGpu();
+	m_drawCallData.MarkDirty(0, vt_offset);
+	m_transformData.MarkDirty(0, tf_offset);
 	// 2) Instance Draw Call
 	auto fidx = m_ctx->CurrentFrame;
 	// update shader binding
@@ -330,9 +350,8 @@ void egx::d2::Scene::Paint()
 	m_cmd[fidx].draw(6, (uint32_t)bodies.size(), 0, 0);
 	m_canvas.m_renderTarget.End(m_cmd[fidx]);
 	m_cmd[fidx].end();
-	vk::SubmitInfo submit;
-	submit.setCommandBufferCount(1).setCommandBuffers(m_cmd[fidx]);
-	m_ctx->Queue.submit(submit, m_fence);
-	m_ctx->Device.waitForFences(m_fence, true, 1e9);
+	m_ctx->FlushUploads();
+	m_ctx->Submitter->Enqueue(egx::QueueType::Graphics, { m_cmd[fidx] }, {}, {}, m_fence);
+	m_ctx->Submitter->WaitForFences({ m_fence }, 1e9);
 	m_ctx->Device.resetFences(m_fence);
 }
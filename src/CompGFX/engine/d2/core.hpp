@@ -204,6 +204,8 @@ namespace egx::d2 {
 		void Create(const egx::DeviceCtx& ctx, int width, int height, ImageMemoryType memoryType);
 		void ReadToBuffer();
 		void SaveScreenshotToDisk(const std::string& filepath);
+		// Reads the canvas after the current frame and encodes the png on a worker thread, the frame never waits
+		egx::ReadbackHandle SaveScreenshotToDiskAsync(const std::string& filepath);
 	public:
 		glm::ivec2 resolution;
 		ImageMemoryType memoryType;
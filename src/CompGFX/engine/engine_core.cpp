@@ -17,8 +17,11 @@ bool egx::CoreEngine::Startup(int backBufferCount)
 		throw std::runtime_error("No devices found that support Vulkan.");
 	}
 	PhysicalDevice = devices[0];
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES};
+	timelineFeatures.timelineSemaphore = true;
 	VkPhysicalDeviceSynchronization2Features features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES};
 	features.synchronization2 = true;
+	features.pNext = &timelineFeatures;
 	PhysicalDevice.EnabledFeatures.pNext = &features;
 	Device = ICD->CreateDevice(PhysicalDevice, backBufferCount);
 	return true;
@@ -83,17 +86,32 @@ egx::GraphicsPipelineBuilder& egx::GraphicsPipelineBuilder::SetFragmentShaderCod
 
 void egx::GraphicsPipelineBuilder::Invalidate(const CoreEngine& engine, const IRenderTarget& renderTarget, bool compileInDebugMode, PipelineSpecification pipelineSpec)
 {
+	Shader vertexShader, fragmentShader;
 	thread vsCompile = thread{ [&]() {
-			VertexShader = Shader(engine.Device, _vertexShaderCode, Shader::Type::Vertex, {}, {}, compileInDebugMode);
+			vertexShader = Shader(engine.Device, _vertexShaderCode, Shader::Type::Vertex, {}, {}, compileInDebugMode);
 		}
 	};
 	thread fsCompile = thread{ [&]() {
-			FragmentShader = Shader(engine.Device, _fragmentShaderCode, Shader::Type::Fragment, {}, {}, compileInDebugMode);
+			fragmentShader = Shader(engine.Device, _fragmentShaderCode, Shader::Type::Fragment, {}, {}, compileInDebugMode);
 		}
 	};
 	vsCompile.join();
 	fsCompile.join();
-	Pipeline = IGraphicsPipeline(engine.Device, VertexShader, FragmentShader, renderTarget, pipelineSpec);
-	Pipeline.Invalidate();
+	auto pipeline = IGraphicsPipeline(engine.Device, vertexShader, fragmentShader, renderTarget, pipelineSpec);
+	pipeline.Invalidate();
+	Pipeline = pipeline;
+}
+
+void egx::GraphicsPipelineBuilder::InvalidateAsync(const CoreEngine& engine, const IRenderTarget& renderTarget, bool compileInDebugMode, PipelineSpecification pipelineSpec)
+{
+	// Captured by value, the builder may change its sources before the build ran
+	engine.Device->Compiler->Recompile<IGraphicsPipeline>(Pipeline, [device = engine.Device, renderTarget, compileInDebugMode, pipelineSpec,
+		vertexCode = _vertexShaderCode, fragmentCode = _fragmentShaderCode]() {
+		Shader vertexShader(device, vertexCode, Shader::Type::Vertex, {}, {}, compileInDebugMode);
+		Shader fragmentShader(device, fragmentCode, Shader::Type::Fragment, {}, {}, compileInDebugMode);
+		auto pipeline = IGraphicsPipeline(device, vertexShader, fragmentShader, renderTarget, pipelineSpec);
+		pipeline.Invalidate();
+		return pipeline;
+	});
 }
 
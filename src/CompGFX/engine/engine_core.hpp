@@ -52,6 +52,7 @@ namespace egx {
 		}
 
 		inline void WaitIdle() const {
+			Device->Submitter->Flush();
 			Device->Device.waitIdle();
 		}
 
@@ -78,12 +79,18 @@ namespace egx {
 		GraphicsPipelineBuilder& SetFragmentShader(const std::string& path);
 		GraphicsPipelineBuilder& SetFragmentShaderCode(const std::string& code);
 
+		/// <summary>
+		/// Compiles the shaders and the pipeline on the calling thread.
+		/// </summary>
 		void Invalidate(const CoreEngine& engine, const IRenderTarget& renderTarget, bool compileInDebugMode, PipelineSpecification pipelineSpec = {});
+		/// <summary>
+		/// Compiles on the device's PipelineCompiler, Pipeline keeps the previous pipeline until the
+		/// frame boundary after the build finished.
+		/// </summary>
+		void InvalidateAsync(const CoreEngine& engine, const IRenderTarget& renderTarget, bool compileInDebugMode, PipelineSpecification pipelineSpec = {});
 
 	public:
-		Shader VertexShader;
-		Shader FragmentShader;
-		IGraphicsPipeline Pipeline;
+		PendingPipeline<IGraphicsPipeline> Pipeline;
 
 	private:
 		std::string _vertexShaderCode;
@@ -0,0 +1,111 @@
+#include "Sha256.hpp"
+#include <cstring>
+#include <algorithm>
+
+using namespace egx;
+using namespace std;
+
+static constexpr uint32_t RoundConstants[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline uint32_t RotateRight(uint32_t value, uint32_t count)
+{
+	return (value >> count) | (value << (32 - count));
+}
+
+egx::Sha256::Sha256()
+{
+	static constexpr uint32_t InitialState[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+	memcpy(m_State, InitialState, sizeof(m_State));
+}
+
+void egx::Sha256::Update(const void* data, size_t size)
+{
+	auto bytes = (const uint8_t*)data;
+	m_Length += size;
+	while (size > 0)
+	{
+		size_t count = std::min(size, sizeof(m_Block) - m_BlockSize);
+		memcpy(m_Block + m_BlockSize, bytes, count);
+		m_BlockSize += count;
+		bytes += count;
+		size -= count;
+		if (m_BlockSize == sizeof(m_Block))
+		{
+			_Transform(m_Block);
+			m_BlockSize = 0;
+		}
+	}
+}
+
+Sha256::Digest egx::Sha256::Finalize()
+{
+	uint64_t bitLength = m_Length * 8;
+	uint8_t padding[72] = { 0x80 };
+	size_t paddingSize = (m_BlockSize < 56 ? 56 : 120) - m_BlockSize;
+	for (int i = 0; i < 8; i++)
+		padding[paddingSize + i] = uint8_t(bitLength >> (56 - i * 8));
+	Update(padding, paddingSize + 8);
+
+	Digest digest;
+	for (int i = 0; i < 8; i++)
+	{
+		digest[i * 4 + 0] = uint8_t(m_State[i] >> 24);
+		digest[i * 4 + 1] = uint8_t(m_State[i] >> 16);
+		digest[i * 4 + 2] = uint8_t(m_State[i] >> 8);
+		digest[i * 4 + 3] = uint8_t(m_State[i]);
+	}
+	return digest;
+}
+
+string egx::Sha256::ToHex(const Digest& digest)
+{
+	static constexpr char Digits[] = "0123456789abcdef";
+	string hex;
+	hex.reserve(digest.size() * 2);
+	for (uint8_t byte : digest)
+	{
+		hex += Digits[byte >> 4];
+		hex += Digits[byte & 0xf];
+	}
+	return hex;
+}
+
+void egx::Sha256::_Transform(const uint8_t* block)
+{
+	uint32_t w[64];
+	for (int i = 0; i < 16; i++)
+		w[i] = uint32_t(block[i * 4]) << 24 | uint32_t(block[i * 4 + 1]) << 16 | uint32_t(block[i * 4 + 2]) << 8 | uint32_t(block[i * 4 + 3]);
+	for (int i = 16; i < 64; i++)
+	{
+		uint32_t s0 = RotateRight(w[i - 15], 7) ^ RotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+		uint32_t s1 = RotateRight(w[i - 2], 17) ^ RotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = m_State[0], b = m_State[1], c = m_State[2], d = m_State[3];
+	uint32_t e = m_State[4], f = m_State[5], g = m_State[6], h = m_State[7];
+	for (int i = 0; i < 64; i++)
+	{
+		uint32_t s1 = RotateRight(e, 6) ^ RotateRight(e, 11) ^ RotateRight(e, 25);
+		uint32_t choose = (e & f) ^ (~e & g);
+		uint32_t temp1 = h + s1 + choose + RoundConstants[i] + w[i];
+		uint32_t s0 = RotateRight(a, 2) ^ RotateRight(a, 13) ^ RotateRight(a, 22);
+		uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+		uint32_t temp2 = s0 + majority;
+		h = g, g = f, f = e, e = d + temp1;
+		d = c, c = b, b = a, a = temp1 + temp2;
+	}
+	m_State[0] += a, m_State[1] += b, m_State[2] += c, m_State[3] += d;
+	m_State[4] += e, m_State[5] += f, m_State[6] += g, m_State[7] += h;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace egx {
+
+	/// <summary>
+	/// Incremental SHA-256 (FIPS 180-4), used for content addressed caches.
+	/// </summary>
+	class Sha256 {
+	public:
+		using Digest = std::array<uint8_t, 32>;
+
+		Sha256();
+
+		void Update(const void* data, size_t size);
+		void Update(std::string_view text) { Update(text.data(), text.size()); }
+		template <typename T>
+		void UpdateValue(const T& value) { Update(&value, sizeof(T)); }
+		// The size is hashed first, "ab" + "c" and "a" + "bc" give different digests
+		void UpdateString(std::string_view text) { UpdateValue(uint64_t(text.size())), Update(text); }
+
+		/// <summary>
+		/// Pads the message and returns the digest, the object must not be updated afterwards.
+		/// </summary>
+		Digest Finalize();
+
+		static Digest Hash(std::string_view text) { Sha256 sha; sha.Update(text); return sha.Finalize(); }
+		static std::string ToHex(const Digest& digest);
+
+	private:
+		void _Transform(const uint8_t* block);
+
+	private:
+		uint32_t m_State[8];
+		uint8_t m_Block[64];
+		size_t m_BlockSize = 0;
+		uint64_t m_Length = 0;
+	};
+
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+namespace egx {
+
+	/// <summary>
+	/// Fixed set of worker threads for fork/join work. ParallelFor() hands out indices to the workers and
+	/// the calling thread, which takes part as thread ThreadCount(), and returns once every index ran.
+	/// The thread index is stable for the lifetime of the pool so callers can keep per-thread state.
+	/// </summary>
+	class ThreadPool {
+	public:
+		ThreadPool(uint32_t threadCount = 0) {
+			if (threadCount == 0)
+				threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1u;
+			for (uint32_t i = 0; i < threadCount; i++)
+				m_Workers.emplace_back([this, i] { _WorkerLoop(i); });
+		}
+
+		ThreadPool(ThreadPool&) = delete;
+
+		~ThreadPool() {
+			{
+				std::scoped_lock lock(m_Lock);
+				m_Exit = true;
+			}
+			m_WorkReady.notify_all();
+			for (auto& worker : m_Workers)
+				worker.join();
+		}
+
+		/// <summary>
+		/// Number of worker threads, per-thread state must have room for ThreadCount() + 1 (the caller).
+		/// </summary>
+		inline uint32_t ThreadCount() const { return uint32_t(m_Workers.size()); }
+
+		/// <summary>
+		/// Runs fn(index, thread) for index in [0, count), blocks until all calls returned.
+		/// The first exception thrown by fn is rethrown on the calling thread.
+		/// </summary>
+		void ParallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t thread)>& fn) {
+			if (count == 0)
+				return;
+			std::scoped_lock dispatch(m_DispatchLock);
+			{
+				std::scoped_lock lock(m_Lock);
+				m_Job = &fn;
+				m_Count = count;
+				m_Next = 0;
+				m_Remaining = count;
+				m_Error = nullptr;
+				m_Generation++;
+			}
+			m_WorkReady.notify_all();
+			_Run(ThreadCount());
+
+			std::unique_lock lock(m_Lock);
+			m_WorkDone.wait(lock, [this] { return m_Remaining == 0 && m_Active == 0; });
+			m_Job = nullptr;
+			if (m_Error)
+				std::rethrow_exception(m_Error);
+		}
+
+	private:
+		void _WorkerLoop(uint32_t thread) {
+			uint64_t generation = 0;
+			while (true) {
+				{
+					std::unique_lock lock(m_Lock);
+					m_WorkReady.wait(lock, [&] { return m_Exit || generation != m_Generation; });
+					if (m_Exit)
+						return;
+					generation = m_Generation;
+					// Woke up after the dispatch already finished
+					if (!m_Job)
+						continue;
+					m_Active++;
+				}
+				_Run(thread);
+				{
+					std::scoped_lock lock(m_Lock);
+					m_Active--;
+				}
+				m_WorkDone.notify_all();
+			}
+		}
+
+		void _Run(uint32_t thread) {
+			for (uint32_t index = m_Next++; index < m_Count; index = m_Next++) {
+				try {
+					(*m_Job)(index, thread);
+				}
+				catch (...) {
+					std::scoped_lock lock(m_Lock);
+					if (!m_Error)
+						m_Error = std::current_exception();
+				}
+				if (--m_Remaining == 0) {
+					std::scoped_lock lock(m_Lock);
+					m_WorkDone.notify_all();
+				}
+			}
+		}
+
+	private:
+		std::vector<std::thread> m_Workers;
+		std::mutex m_DispatchLock;
+		std::mutex m_Lock;
+		std::condition_variable m_WorkReady;
+		std::condition_variable m_WorkDone;
+		const std::function<void(uint32_t, uint32_t)>* m_Job = nullptr;
+		std::atomic<uint32_t> m_Count = 0;
+		std::atomic<uint32_t> m_Next = 0;
+		std::atomic<uint32_t> m_Remaining = 0;
+		uint32_t m_Active = 0;
+		uint64_t m_Generation = 0;
+		bool m_Exit = false;
+		std::exception_ptr m_Error;
+	};
+
+}
@@ -0,0 +1,212 @@
+#include "ZoneProfiler.hpp"
+#include "Utility/CppUtility.hpp"
+#include <json.hpp>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+using namespace egx;
+using namespace std;
+
+static constexpr char PathSeparator = '\x1f';
+
+egx::ZoneProfiler::ZoneProfiler()
+{
+	m_Clock.Reset();
+}
+
+ZoneProfiler& egx::ZoneProfiler::Get()
+{
+	static ZoneProfiler profiler;
+	return profiler;
+}
+
+void egx::ZoneProfiler::SetThreadName(const char* name)
+{
+	_ThreadRing().Name = name;
+}
+
+const char* egx::ZoneProfiler::Intern(const string& name)
+{
+	scoped_lock lock(m_NamesLock);
+	return m_Names.insert(name).first->c_str();
+}
+
+uint64_t egx::ZoneProfiler::NowNs() const
+{
+	return uint64_t(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - m_Clock.StartMeasurement).count());
+}
+
+void egx::ZoneProfiler::Record(const ZoneEvent& event)
+{
+	auto& ring = _ThreadRing();
+	uint64_t head = ring.Head.load(memory_order_relaxed);
+	if (head - ring.Tail.load(memory_order_acquire) >= RingCapacity)
+	{
+		ring.Dropped.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+	ring.Events[head % RingCapacity] = event;
+	ring.Head.store(head + 1, memory_order_release);
+}
+
+ZoneProfiler::ThreadRing& egx::ZoneProfiler::_ThreadRing()
+{
+	// The profiler holds a reference too, events of exited threads are still drained
+	thread_local shared_ptr<ThreadRing> ring;
+	if (!ring)
+	{
+		ring = make_shared<ThreadRing>();
+		ring->Events.resize(RingCapacity);
+		scoped_lock lock(m_RingsLock);
+		ring->ThreadIndex = uint32_t(m_Rings.size());
+		m_Rings.push_back(ring);
+	}
+	return *ring;
+}
+
+void egx::ZoneProfiler::EndFrame()
+{
+	vector<shared_ptr<ThreadRing>> rings;
+	{
+		scoped_lock lock(m_RingsLock);
+		rings = m_Rings;
+	}
+
+	FrameEvents frame;
+	struct FrameZone
+	{
+		const char* Name;
+		uint32_t Depth;
+		uint32_t Calls = 0;
+		uint64_t TotalNs = 0;
+	};
+	unordered_map<string, FrameZone> zones;
+	for (auto& ring : rings)
+	{
+		uint64_t tail = ring->Tail.load(memory_order_relaxed);
+		uint64_t head = ring->Head.load(memory_order_acquire);
+		vector<ZoneEvent> events;
+		events.reserve(head - tail);
+		for (; tail < head; tail++)
+			events.push_back(ring->Events[tail % RingCapacity]);
+		ring->Tail.store(tail, memory_order_release);
+
+		// Parents begin first and end last, a zone is nested in the closest one still open
+		sort(events.begin(), events.end(), [](const ZoneEvent& a, const ZoneEvent& b) {
+			return a.BeginNs != b.BeginNs ? a.BeginNs < b.BeginNs : a.EndNs > b.EndNs;
+		});
+		vector<pair<uint64_t, string>> open;
+		for (auto& event : events)
+		{
+			while (open.size() > 0 && open.back().first <= event.BeginNs)
+				open.pop_back();
+			string path = open.size() > 0 ? open.back().second + PathSeparator + event.Name : string(event.Name);
+			auto& zone = zones.try_emplace(path, FrameZone{ event.Name, uint32_t(open.size()) }).first->second;
+			zone.Calls++;
+			zone.TotalNs += event.EndNs - event.BeginNs;
+			open.push_back({ event.EndNs, std::move(path) });
+			frame.Events.push_back({ ring->ThreadIndex, event });
+		}
+	}
+
+	scoped_lock lock(m_Lock);
+	frame.Frame = ++m_Frame;
+	for (auto& [path, zone] : zones)
+	{
+		auto& history = m_Zones.try_emplace(path, ZoneHistory{ zone.Name, zone.Depth }).first->second;
+		history.Samples.push_back(zone.TotalNs / 1e6);
+		if (history.Samples.size() > HistoryLength)
+			history.Samples.pop_front();
+		history.LastCalls = zone.Calls;
+		history.LastFrame = m_Frame;
+	}
+	erase_if(m_Zones, [this](const auto& entry) { return m_Frame - entry.second.LastFrame > HistoryLength; });
+
+	m_History.push_back(std::move(frame));
+	if (m_History.size() > HistoryLength)
+		m_History.pop_front();
+}
+
+vector<ZoneStatistics> egx::ZoneProfiler::GetStatistics() const
+{
+	scoped_lock lock(m_Lock);
+	vector<ZoneStatistics> statistics;
+	for (auto& [path, zone] : m_Zones)
+	{
+		ZoneStatistics entry;
+		entry.Name = zone.Name;
+		entry.Path = path;
+		replace(entry.Path.begin(), entry.Path.end(), PathSeparator, '/');
+		entry.Depth = zone.Depth;
+		bool ranLastFrame = zone.LastFrame == m_Frame;
+		entry.Calls = ranLastFrame ? zone.LastCalls : 0;
+		entry.LastMs = ranLastFrame ? zone.Samples.back() : 0.0;
+
+		vector<double> samples(zone.Samples.begin(), zone.Samples.end());
+		double total = 0.0;
+		for (double sample : samples)
+			total += sample;
+		entry.AverageMs = samples.size() > 0 ? total / samples.size() : 0.0;
+		sort(samples.begin(), samples.end());
+		size_t p99 = size_t(ceil(samples.size() * 0.99));
+		entry.P99Ms = samples.size() > 0 ? samples[std::max<size_t>(p99, 1) - 1] : 0.0;
+		statistics.push_back(std::move(entry));
+	}
+	return statistics;
+}
+
+uint64_t egx::ZoneProfiler::DroppedEvents() const
+{
+	scoped_lock lock(m_RingsLock);
+	uint64_t dropped = 0;
+	for (auto& ring : m_Rings)
+		dropped += ring->Dropped.load(memory_order_relaxed);
+	return dropped;
+}
+
+string egx::ZoneProfiler::DumpChromeTrace() const
+{
+	nlohmann::json events = nlohmann::json::array();
+	{
+		scoped_lock lock(m_RingsLock);
+		for (auto& ring : m_Rings)
+		{
+			string name = ring->Name ? ring->Name : cpp::Format("Thread {}", ring->ThreadIndex);
+			events.push_back({ {"name", "thread_name"}, {"ph", "M"}, {"pid", 0}, {"tid", ring->ThreadIndex}, {"args", { {"name", name} }} });
+		}
+	}
+
+	scoped_lock lock(m_Lock);
+	for (auto& frame : m_History)
+	{
+		for (auto& [thread, event] : frame.Events)
+		{
+			// Chrome traces are in microseconds
+			events.push_back({
+				{"name", event.Name},
+				{"cat", "cpu"},
+				{"ph", "X"},
+				{"ts", event.BeginNs / 1000.0},
+				{"dur", (event.EndNs - event.BeginNs) / 1000.0},
+				{"pid", 0},
+				{"tid", thread},
+				{"args", { {"frame", frame.Frame} }} });
+		}
+	}
+	nlohmann::json root;
+	root["traceEvents"] = events;
+	root["displayTimeUnit"] = "ms";
+	return root.dump();
+}
+
+void egx::ZoneProfiler::SaveChromeTrace(const string& filePath) const
+{
+	ofstream file(filePath);
+	if (!file)
+	{
+		throw runtime_error(cpp::Format("Could not open {} to save the CPU trace.", filePath));
+	}
+	file << DumpChromeTrace();
+}
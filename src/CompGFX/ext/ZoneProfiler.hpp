@@ -0,0 +1,159 @@
+#pragma once
+#include "StopWatch.hpp"
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#define EGX_ZONE_CONCAT_INNER(a, b) a##b
+#define EGX_ZONE_CONCAT(a, b) EGX_ZONE_CONCAT_INNER(a, b)
+// name must outlive the profiler, e.g. a string literal
+#define EGX_ZONE(name) ::egx::ZoneScope EGX_ZONE_CONCAT(_egxZone, __LINE__)(name)
+#define EGX_ZONE_FUNCTION() EGX_ZONE(__FUNCTION__)
+
+namespace egx {
+
+	struct ZoneEvent {
+		const char* Name;
+		// Nanoseconds since the profiler started
+		uint64_t BeginNs;
+		uint64_t EndNs;
+		uint32_t Depth;
+	};
+
+	struct ZoneStatistics {
+		std::string Name;
+		// Names of the enclosing zones and this one, separated by '/'
+		std::string Path;
+		uint32_t Depth;
+		// Calls in the last frame
+		uint32_t Calls;
+		double LastMs;
+		double AverageMs;
+		double P99Ms;
+	};
+
+	/// <summary>
+	/// Hierarchical CPU profiler. ZoneScope (EGX_ZONE) measures a scope with a StopWatch and pushes the event into a
+	/// lock-free ring buffer owned by the calling thread, events are dropped while the ring is full.
+	/// EndFrame() (called by DeviceContext::NextFrame()) drains every ring, folds the frame into trees per thread keyed by
+	/// the zone path and keeps rolling averages and p99 values over the last HistoryLength frames.
+	/// Disabled by default, a disabled zone only reads a flag.
+	/// </summary>
+	class ZoneProfiler {
+	public:
+		static constexpr size_t RingCapacity = 8192;
+		static constexpr size_t HistoryLength = 240;
+
+		static ZoneProfiler& Get();
+
+		void SetEnabled(bool enable) { m_Enabled.store(enable, std::memory_order_relaxed); }
+		bool IsEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+		/// <summary>
+		/// Names the calling thread in traces, name must outlive the profiler.
+		/// </summary>
+		void SetThreadName(const char* name);
+		/// <summary>
+		/// Returns a copy of name that lives as long as the profiler, for zone names built at runtime.
+		/// </summary>
+		const char* Intern(const std::string& name);
+
+		void Record(const ZoneEvent& event);
+		uint64_t NowNs() const;
+
+		void EndFrame();
+
+		/// <summary>
+		/// Every zone path seen in the history, parents before their children.
+		/// </summary>
+		std::vector<ZoneStatistics> GetStatistics() const;
+		uint64_t DroppedEvents() const;
+
+		/// <summary>
+		/// The events of the history in the Chrome trace event format (chrome://tracing, Perfetto), one track per thread.
+		/// </summary>
+		std::string DumpChromeTrace() const;
+		void SaveChromeTrace(const std::string& filePath) const;
+
+	private:
+		ZoneProfiler();
+
+		// Written by its thread only, drained by EndFrame()
+		struct ThreadRing {
+			uint32_t ThreadIndex;
+			const char* Name = nullptr;
+			std::vector<ZoneEvent> Events;
+			std::atomic<uint64_t> Head = 0;
+			std::atomic<uint64_t> Tail = 0;
+			std::atomic<uint64_t> Dropped = 0;
+		};
+
+		struct ZoneHistory {
+			const char* Name;
+			uint32_t Depth;
+			uint32_t LastCalls = 0;
+			uint64_t LastFrame = 0;
+			// Total milliseconds of the frames the zone ran in
+			std::deque<double> Samples;
+		};
+
+		struct FrameEvents {
+			uint64_t Frame;
+			// [thread index, event]
+			std::vector<std::pair<uint32_t, ZoneEvent>> Events;
+		};
+
+		ThreadRing& _ThreadRing();
+
+	private:
+		std::atomic<bool> m_Enabled = false;
+		StopWatch m_Clock;
+		mutable std::mutex m_RingsLock;
+		std::vector<std::shared_ptr<ThreadRing>> m_Rings;
+		std::mutex m_NamesLock;
+		// Node based, the strings never move
+		std::unordered_set<std::string> m_Names;
+
+		mutable std::mutex m_Lock;
+		uint64_t m_Frame = 0;
+		// [path, history], the path separator sorts below every printable character so parents precede children
+		std::map<std::string, ZoneHistory> m_Zones;
+		std::deque<FrameEvents> m_History;
+	};
+
+	class ZoneScope {
+	public:
+		ZoneScope(const char* name) : m_Name(name) {
+			if (!ZoneProfiler::Get().IsEnabled())
+				return;
+			m_Active = true;
+			m_Depth = s_Depth++;
+			m_Watch.Reset();
+		}
+
+		ZoneScope(ZoneScope&) = delete;
+
+		~ZoneScope() {
+			if (!m_Active)
+				return;
+			m_Watch.Stop();
+			s_Depth--;
+			auto& profiler = ZoneProfiler::Get();
+			uint64_t end = profiler.NowNs();
+			profiler.Record({ m_Name, end - m_Watch.TimeAsNanoseconds(), end, m_Depth });
+		}
+
+	private:
+		const char* m_Name;
+		bool m_Active = false;
+		uint32_t m_Depth = 0;
+		StopWatch m_Watch;
+		static inline thread_local uint32_t s_Depth = 0;
+	};
+
+}
@@ -1,9 +1,13 @@
 #include "egxbuffer.hpp"
+#include "egxstaging.hpp"
+#include "egxdirtyranges.hpp"
+#include "egxdefrag.hpp"
 #include <core/CommandBuffer.hpp>
+#include <core/DeletionQueue.hpp>
 
 using namespace egx;
 
-egx::Buffer::Buffer(const DeviceCtx& pCtx, size_t size, MemoryPreset memoryPreset, HostMemoryAccess memoryAccess, vk::BufferUsageFlags usage, bool isFrameResource)
+egx::Buffer::Buffer(const DeviceCtx& pCtx, size_t size, MemoryPreset memoryPreset, HostMemoryAccess memoryAccess, vk::BufferUsageFlags usage, bool isFrameResource, bool persistentMapped)
 	: m_Size(size), m_MemoryAccessBehavior(memoryAccess), m_MemoryType(memoryPreset)
 	, IsFrameResource(isFrameResource)
 {
@@ -12,15 +16,24 @@ egx::Buffer::Buffer(const DeviceCtx& pCtx, size_t size, MemoryPreset memoryPrese
 
 	m_Data = std::make_shared<Buffer::DataWrapper>();
 	m_Data->m_Ctx = pCtx;
+	m_Data->m_Capacity = size;
+	m_Data->m_Capacities.assign(IsFrameResource ? pCtx->FramesInFlight : 1, size);
+	if (persistentMapped && memoryPreset == MemoryPreset::DeviceOnly)
+	{
+		throw std::invalid_argument("DeviceOnly buffers cannot be persistently mapped.");
+	}
+	m_Data->m_PersistentMapped = persistentMapped;
 
 	if (!IsFrameResource)
 	{
-		VkResult result = _CreateBufferVma((VkBuffer*)&m_Data->m_Buffer, &m_Data->m_Allocation);
+		VkResult result = _CreateBufferVma(size, (VkBuffer*)&m_Data->m_Buffer, &m_Data->m_Allocation);
 
 		if (result != VK_SUCCESS)
 		{
 			throw std::runtime_error(cpp::Format("Could create buffer with {} bytes, usage={}, error code {}", size, vk::to_string(usage), vk::to_string(vk::Result(result))));
 		}
+		if (persistentMapped)
+			m_Data->m_MappedPtr = _GetPersistentPtr(m_Data->m_Allocation);
 	}
 	else
 	{
@@ -29,14 +42,51 @@ egx::Buffer::Buffer(const DeviceCtx& pCtx, size_t size, MemoryPreset memoryPrese
 		for (uint32_t i = 0; i < pCtx->FramesInFlight; i++)
 		{
 			VkBuffer temp;
-			VkResult result = _CreateBufferVma(&temp, &m_Data->m_Allocations[i]);
+			VkResult result = _CreateBufferVma(size, &temp, &m_Data->m_Allocations[i]);
 			if (result != VK_SUCCESS)
 			{
 				throw std::runtime_error(cpp::Format("Could create buffer with {} bytes, usage={}, error code {}", size, vk::to_string(usage), vk::to_string(vk::Result(result))));
 			}
 			m_Data->m_Buffers.push_back(temp);
+			if (persistentMapped)
+				m_Data->m_MappedPtrs[i] = _GetPersistentPtr(m_Data->m_Allocations[i]);
 		}
 	}
+	m_Data->m_IsMapped = persistentMapped;
+	for (uint32_t i = 0; i < m_Data->m_Capacities.size(); i++)
+		_RegisterRelocation(i);
+
+	if (IsFrameResource)
+		m_Data->m_Category = MemoryCategory::FrameResource;
+	else if (usage & (vk::BufferUsageFlagBits::eVertexBuffer | vk::BufferUsageFlagBits::eIndexBuffer))
+		m_Data->m_Category = MemoryCategory::Mesh;
+	else if (memoryPreset == MemoryPreset::HostOnly)
+		m_Data->m_Category = MemoryCategory::Staging;
+	pCtx->Telemetry->Register(m_Data.get(), m_Data->m_Category, size * m_Data->m_Capacities.size());
+}
+
+Buffer egx::Buffer::CreateFromHandle(const DeviceCtx& pCtx, vk::Buffer handle, size_t size, vk::BufferUsageFlags usage)
+{
+	Buffer buffer;
+	buffer.m_Size = size;
+	buffer.m_MemoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+	buffer.m_MemoryType = MemoryPreset::DeviceOnly;
+	buffer.m_MemoryAccessBehavior = HostMemoryAccess::None;
+	buffer.Usage = usage;
+	buffer.IsFrameResource = false;
+	buffer.m_Data = std::make_shared<Buffer::DataWrapper>();
+	buffer.m_Data->m_Ctx = pCtx;
+	buffer.m_Data->m_Buffer = handle;
+	buffer.m_Data->m_Capacity = size;
+	buffer.m_Data->m_Capacities = { size };
+	buffer.m_Data->m_ExternalHandle = true;
+	return buffer;
+}
+
+void Buffer::SetCategory(MemoryCategory category)
+{
+	m_Data->m_Category = category;
+	m_Data->m_Ctx->Telemetry->SetCategory(m_Data.get(), category);
 }
 uint8_t& Buffer::operator[](size_t index)
 {
@@ -53,29 +103,25 @@ void Buffer::_Write(const void* pData, size_t offset, size_t size, int resourceI
 		bool previousMappedState = m_Data->m_IsMapped;
 		Map();
 
-		if (IsFrameResource)
+		uint8_t* pMemory = (uint8_t*)(IsFrameResource ? m_Data->m_MappedPtrs[resourceId] : m_Data->m_MappedPtr);
+		VmaAllocation allocation = IsFrameResource ? m_Data->m_Allocations[resourceId] : m_Data->m_Allocation;
+		memcpy(pMemory + offset, pData, size);
+		if (previousMappedState)
 		{
-			uint8_t* pMemory = (uint8_t*)m_Data->m_MappedPtrs[resourceId];
-			memcpy(pMemory + offset, pData, size);
-			vmaFlushAllocation(m_Data->m_Ctx->Allocator, m_Data->m_Allocations[resourceId], offset, size);
+			// The mapping outlives this call, flush together with the other writes of the frame
+			m_Data->m_Ctx->DirtyRanges->Add(allocation, offset, size);
 		}
 		else
 		{
-			uint8_t* pMemory = (uint8_t*)Map();
-			memcpy(pMemory + offset, pData, size);
-			vmaFlushAllocation(m_Data->m_Ctx->Allocator, m_Data->m_Allocation, offset, size);
-		}
-		if (!previousMappedState)
+			vmaFlushAllocation(m_Data->m_Ctx->Allocator, allocation, offset, size);
 			Unmap();
+		}
 
 		return;
 	}
 
-	ScopedCommandBuffer cmd(m_Data->m_Ctx);
-	Buffer stage(m_Data->m_Ctx, size, MemoryPreset::HostOnly, HostMemoryAccess::Sequential, vk::BufferUsageFlagBits::eTransferSrc, false);
-	stage[0] = 8;
-	stage.Write(pData);
-	stage._CopyTo(*cmd, *this, 0, offset, size, resourceId);
+	// Recorded into the frame's upload batch, submitted by DeviceContext::FlushUploads()
+	m_Data->m_Ctx->Staging->Upload(GetHandle(resourceId), offset, pData, size);
 }
 
 void Buffer::Write(const void* pData, size_t offset, size_t size)
@@ -86,25 +132,32 @@ void Buffer::Write(const void* pData)
 {
 	Write(pData, 0, m_Size);
 }
+TransferToken Buffer::WriteAsync(const void* pData, size_t offset, size_t size)
+{
+	auto& transfer = m_Data->m_Ctx->Transfer;
+	// A buffer being relocated is written on the graphics queue, ordered after the relocation copy
+	VmaAllocation allocation = IsFrameResource ? m_Data->m_Allocations[m_Data->m_Ctx->CurrentFrame] : m_Data->m_Allocation;
+	if (m_MemoryType != MemoryPreset::DeviceOnly || !transfer || m_Data->m_Ctx->Defrag->IsMoving(allocation))
+	{
+		Write(pData, offset, size);
+		return {};
+	}
+	return transfer->UploadBuffer(GetHandle(), offset, pData, size);
+}
+
 void* Buffer::Map()
 {
-	// Issue potential resize
-	bool resizeFlag = false;
-	this->GetHandle(-1, &resizeFlag);
+	// Issue potential resize, the reallocation keeps the mapping
+	this->GetHandle();
 	auto currentFrame = m_Data->m_Ctx->CurrentFrame;
-	if (!m_Data->m_IsMapped || resizeFlag)
+	if (!m_Data->m_IsMapped)
 	{
 		if (!IsFrameResource)
 			vmaMapMemory(m_Data->m_Ctx->Allocator, m_Data->m_Allocation, &m_Data->m_MappedPtr);
 		else
 		{
-			if (resizeFlag) {
-				vmaMapMemory(m_Data->m_Ctx->Allocator, m_Data->m_Allocations[currentFrame], &m_Data->m_MappedPtrs[currentFrame]);
-			}
-			else {
-				for (auto i = 0; i < m_Data->m_Ctx->FramesInFlight; i++) {
-					vmaMapMemory(m_Data->m_Ctx->Allocator, m_Data->m_Allocations[i], &m_Data->m_MappedPtrs[i]);
-				}
+			for (auto i = 0; i < m_Data->m_Ctx->FramesInFlight; i++) {
+				vmaMapMemory(m_Data->m_Ctx->Allocator, m_Data->m_Allocations[i], &m_Data->m_MappedPtrs[i]);
 			}
 		}
 	}
@@ -115,8 +168,10 @@ void* Buffer::Map()
 }
 void Buffer::Unmap()
 {
-	if (!m_Data->m_IsMapped)
+	if (!m_Data->m_IsMapped || m_Data->m_PersistentMapped)
 		return;
+	// Dirty ranges can only be flushed while the memory is mapped
+	m_Data->m_Ctx->DirtyRanges->Flush();
 	if (IsFrameResource)
 	{
 		for (uint32_t i = 0; i < m_Data->m_Ctx->FramesInFlight; i++)
@@ -135,10 +190,18 @@ void Buffer::Unmap()
 
 void Buffer::FlushToGpu()
 {
-	if (IsFrameResource)
-		vmaFlushAllocation(m_Data->m_Ctx->Allocator, m_Data->m_Allocations[m_Data->m_Ctx->CurrentFrame], 0, m_Size);
+	MarkDirty(0, m_Size);
+}
+
+void Buffer::MarkDirty(size_t offset, size_t size)
+{
+	if (m_MemoryType == MemoryPreset::DeviceOnly)
+		return;
+	VmaAllocation allocation = IsFrameResource ? m_Data->m_Allocations[m_Data->m_Ctx->CurrentFrame] : m_Data->m_Allocation;
+	if (m_Data->m_IsMapped)
+		m_Data->m_Ctx->DirtyRanges->Add(allocation, offset, size);
 	else
-		vmaFlushAllocation(m_Data->m_Ctx->Allocator, m_Data->m_Allocation, 0, m_Size);
+		vmaFlushAllocation(m_Data->m_Ctx->Allocator, allocation, offset, size);
 }
 
 void Buffer::InvalidateToCpu()
@@ -175,11 +238,24 @@ void Buffer::Read(size_t offset, size_t size, void* pOutData)
 		memcpy(pOutData, mapScope.Ptr + offset, size);
 		return;
 	}
-	ScopedCommandBuffer cmd(m_Data->m_Ctx);
-	Buffer stage(m_Data->m_Ctx, size, MemoryPreset::HostOnly, HostMemoryAccess::Sequential, vk::BufferUsageFlagBits::eTransferDst, false);
-	CopyTo(*cmd, stage, offset, 0, size);
-	cmd.RunNow();
-	memcpy(pOutData, stage.Map(), size);
+	auto readback = ReadAsync(offset, size);
+	memcpy(pOutData, readback.Get().data(), size);
+}
+
+ReadbackHandle Buffer::ReadAsync(size_t offset, size_t size, ReadbackQueue::ReadyCallback onReady)
+{
+	if (m_MemoryType != MemoryPreset::DeviceOnly)
+	{
+		std::vector<uint8_t> data(size);
+		Read(offset, size, data.data());
+		if (onReady)
+			onReady(data);
+		return ReadbackHandle::FromData(std::move(data));
+	}
+	vk::Buffer src = GetHandle();
+	return m_Data->m_Ctx->Readback->Record(size, [src, offset, size](vk::CommandBuffer cmd, vk::Buffer dst) {
+		cmd.copyBuffer(src, dst, vk::BufferCopy(offset, 0, size));
+	}, std::move(onReady));
 }
 
 void Buffer::Read(void* pOutData)
@@ -189,19 +265,34 @@ void Buffer::Read(void* pOutData)
 
 bool Buffer::Resize(size_t size)
 {
-	if (size == m_Size)
-		return false;
-	m_Data->m_ResizeBufferFrameIds.clear();
-	if (!IsFrameResource) {
-		m_Data->m_ResizeBufferFrameIds.push_back(0);
+	if (size == 0)
+	{
+		throw std::invalid_argument("Size == 0, cannot resize buffer to size 0");
 	}
-	else {
-		for (uint32_t i = 0; i < m_Data->m_Allocations.size(); i++) {
-			m_Data->m_ResizeBufferFrameIds.push_back(i);
-		}
+	if (m_Data->m_ExternalHandle)
+	{
+		throw std::runtime_error("Cannot resize a buffer created from an external handle.");
 	}
 	m_Size = size;
-	Unmap();
+
+	const auto& policy = m_Data->m_GrowthPolicy;
+	size_t capacity = m_Data->m_Capacity;
+	if (size > capacity)
+	{
+		capacity = std::max({ capacity, policy.MinCapacity, size_t(1) });
+		while (capacity < size)
+			capacity = std::max(size_t(double(capacity) * policy.GrowthFactor), capacity + 1);
+	}
+	else if (double(size) <= double(capacity) * policy.ShrinkRatio)
+	{
+		capacity = std::max(size_t(double(size) * policy.GrowthFactor), policy.MinCapacity);
+		capacity = std::clamp(capacity, size, m_Data->m_Capacity);
+	}
+
+	if (capacity == m_Data->m_Capacity)
+		return false;
+	// Every resource picks up the new capacity the next time its handle is requested
+	m_Data->m_Capacity = capacity;
 	return true;
 }
 
@@ -210,18 +301,20 @@ void Buffer::_CopyTo(vk::CommandBuffer cmd, Buffer& dst, size_t srcOffset, size_
 	cmd.copyBuffer(GetHandle(dstResourceId), dst.GetHandle(dstResourceId), vk::BufferCopy(srcOffset, dstOffset, size));
 }
 
-VkResult egx::Buffer::_CreateBufferVma(VkBuffer* pOutBuffer, VmaAllocation* pOutAllocation) const
+VkResult egx::Buffer::_CreateBufferVma(size_t size, VkBuffer* pOutBuffer, VmaAllocation* pOutAllocation) const
 {
-	if (m_Size == 0)
+	if (size == 0)
 	{
 		throw std::invalid_argument("Size == 0, cannot create buffer with size 0");
 	}
 	VkBufferCreateInfo createInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-	createInfo.size = m_Size;
+	createInfo.size = size;
 	createInfo.usage = VkBufferUsageFlags(Usage);
 	createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 	VmaAllocationCreateInfo allocCreateInfo{};
 	allocCreateInfo.flags = VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT;
+	if (m_Data->m_PersistentMapped)
+		allocCreateInfo.flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
 
 	switch (m_MemoryAccessBehavior)
 	{
@@ -277,64 +370,143 @@ void Buffer::CopyTo(vk::CommandBuffer cmd, Buffer& dst)
 vk::Buffer Buffer::GetHandle(int specificFrameIndex, bool* pOutResizeFlag) const
 {
 	uint32_t frame = specificFrameIndex < 0 ? m_Data->m_Ctx->CurrentFrame : specificFrameIndex;
+	uint32_t resourceId = IsFrameResource ? frame : 0;
+	bool resizeFlag = m_Data->m_Capacities[resourceId] != m_Data->m_Capacity;
+	if (resizeFlag)
+		_Reallocate(resourceId);
 	if (pOutResizeFlag)
-		*pOutResizeFlag = false;
-	if (m_Data->m_ResizeBufferFrameIds.size() == 0) {
-		return IsFrameResource ? m_Data->m_Buffers[frame] : m_Data->m_Buffer;
+		*pOutResizeFlag = resizeFlag;
+	return IsFrameResource ? m_Data->m_Buffers[frame] : m_Data->m_Buffer;
+}
+
+void Buffer::_Reallocate(uint32_t resourceId) const
+{
+	vk::Buffer& buffer = IsFrameResource ? m_Data->m_Buffers[resourceId] : m_Data->m_Buffer;
+	VmaAllocation& allocation = IsFrameResource ? m_Data->m_Allocations[resourceId] : m_Data->m_Allocation;
+	void*& mappedPtr = IsFrameResource ? m_Data->m_MappedPtrs[resourceId] : m_Data->m_MappedPtr;
+	const auto allocator = m_Data->m_Ctx->Allocator;
+
+	size_t capacity = m_Data->m_Capacity;
+	size_t preservedSize = std::min(m_Data->m_Capacities[resourceId], capacity);
+
+	VkBuffer newBuffer;
+	VmaAllocation newAllocation;
+	auto result = _CreateBufferVma(capacity, &newBuffer, &newAllocation);
+	if (result != VK_SUCCESS)
+	{
+		throw std::runtime_error(cpp::Format("Could create buffer with {} bytes, usage={}, error code {}", capacity, vk::to_string(Usage), vk::to_string(vk::Result(result))));
 	}
-	else {
-		// Resize buffer and return handle
-		if (IsFrameResource) {
-			bool resize_flag = false;
-			uint32_t i = 0;
-			for (; i < m_Data->m_ResizeBufferFrameIds.size(); i++) {
-				if (frame == m_Data->m_ResizeBufferFrameIds[i]) {
-					resize_flag = true;
-					break;
-				}
-			}
 
-			if (resize_flag) {
-				m_Data->m_ResizeBufferFrameIds.erase(m_Data->m_ResizeBufferFrameIds.begin() + i);
-				vmaDestroyBuffer(m_Data->m_Ctx->Allocator, m_Data->m_Buffers[frame], m_Data->m_Allocations[frame]);
-				auto result = _CreateBufferVma((VkBuffer*)&m_Data->m_Buffers[frame], &m_Data->m_Allocations[frame]);
-				if (result != VK_SUCCESS)
-				{
-					throw std::runtime_error(cpp::Format("Could create buffer with {} bytes, usage={}, error code {}", m_Size, vk::to_string(Usage), vk::to_string(vk::Result(result))));
-				}
-			}
+	if (m_MemoryType != MemoryPreset::DeviceOnly)
+	{
+		bool persistent = m_Data->m_PersistentMapped;
+		void* pOld = mappedPtr;
+		if (!pOld)
+			vmaMapMemory(allocator, allocation, &pOld);
+		void* pNew = nullptr;
+		if (persistent)
+			pNew = _GetPersistentPtr(newAllocation);
+		else
+			vmaMapMemory(allocator, newAllocation, &pNew);
+		vmaInvalidateAllocation(allocator, allocation, 0, preservedSize);
+		memcpy(pNew, pOld, preservedSize);
+		vmaFlushAllocation(allocator, newAllocation, 0, preservedSize);
+		// The old allocation loses its mapping either way, a mapped buffer stays mapped through the new one
+		if (!persistent)
+			vmaUnmapMemory(allocator, allocation);
+		if (m_Data->m_IsMapped)
+			mappedPtr = pNew;
+		else
+			vmaUnmapMemory(allocator, newAllocation);
+	}
+	else
+	{
+		// Enqueued on its own right away, after the pending uploads and the work already enqueued against the old
+		// buffer and before anything using the new one. Left in the upload batch it could run ahead of that work.
+		auto& staging = m_Data->m_Ctx->Staging;
+		staging->FlushUploads();
+		vk::Buffer src = buffer, dst = newBuffer;
+		staging->Record([src, dst, preservedSize](vk::CommandBuffer cmd) {
+			vk::MemoryBarrier barrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferRead);
+			cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, barrier, {}, {});
+			cmd.copyBuffer(src, dst, vk::BufferCopy(0, 0, preservedSize));
+		});
+		staging->FlushUploads();
+	}
 
-			if (pOutResizeFlag)
-				*pOutResizeFlag = resize_flag;
+	// Frames in flight may still reference the old buffer, memory being moved is freed by the defragmenter
+	m_Data->m_Ctx->DirtyRanges->Forget(allocation);
+	bool moving = m_Data->m_Ctx->Defrag->Unregister(allocation);
+	m_Data->m_Ctx->Deletion->Push([allocator = m_Data->m_Ctx->Allocator, buffer, allocation = moving ? nullptr : allocation] {
+		vmaDestroyBuffer(allocator, buffer, allocation);
+	});
+	buffer = newBuffer;
+	allocation = newAllocation;
+	m_Data->m_Capacities[resourceId] = capacity;
+	_RegisterRelocation(resourceId);
 
-			return m_Data->m_Buffers[frame];
-		}
-		else {
-			m_Data->m_ResizeBufferFrameIds.clear();
-			vmaDestroyBuffer(m_Data->m_Ctx->Allocator, m_Data->m_Buffer, m_Data->m_Allocation);
-			auto result = _CreateBufferVma((VkBuffer*)&m_Data->m_Buffer, &m_Data->m_Allocation);
-			if (result != VK_SUCCESS)
-			{
-				throw std::runtime_error(cpp::Format("Could create buffer with {} bytes, usage={}, error code {}", m_Size, vk::to_string(Usage), vk::to_string(vk::Result(result))));
-			}
-			if (pOutResizeFlag)
-				*pOutResizeFlag = true;
-			return m_Data->m_Buffer;
+	size_t totalCapacity = 0;
+	for (auto resourceCapacity : m_Data->m_Capacities)
+		totalCapacity += resourceCapacity;
+	m_Data->m_Ctx->Telemetry->Update(m_Data.get(), totalCapacity);
+}
+
+void Buffer::_RegisterRelocation(uint32_t resourceId) const
+{
+	// Host visible memory may be mapped, only device only buffers are relocated
+	if (m_MemoryType != MemoryPreset::DeviceOnly)
+		return;
+	DataWrapper* data = m_Data.get();
+	VmaAllocation allocation = IsFrameResource ? data->m_Allocations[resourceId] : data->m_Allocation;
+	data->m_Ctx->Defrag->Register(allocation, [data, resourceId, frameResource = IsFrameResource, usage = Usage](vk::CommandBuffer cmd, VmaAllocation dstAllocation) {
+		const auto& ctx = data->m_Ctx;
+		vk::Buffer& buffer = frameResource ? data->m_Buffers[resourceId] : data->m_Buffer;
+		size_t capacity = data->m_Capacities[resourceId];
+		vk::Buffer newBuffer = ctx->Device.createBuffer(vk::BufferCreateInfo({}, capacity, usage, vk::SharingMode::eExclusive));
+		if (vmaBindBufferMemory(ctx->Allocator, dstAllocation, newBuffer) != VK_SUCCESS)
+		{
+			ctx->Device.destroyBuffer(newBuffer);
+			return false;
 		}
-	}
+		cmd.copyBuffer(buffer, newBuffer, vk::BufferCopy(0, 0, capacity));
+		ctx->Defrag->DeferDestroy([device = ctx->Device, oldBuffer = buffer] { device.destroyBuffer(oldBuffer); });
+		buffer = newBuffer;
+		return true;
+	});
+}
+
+void* Buffer::_GetPersistentPtr(VmaAllocation allocation) const
+{
+	VmaAllocationInfo allocationInfo{};
+	vmaGetAllocationInfo(m_Data->m_Ctx->Allocator, allocation, &allocationInfo);
+	return allocationInfo.pMappedData;
 }
 
 Buffer::DataWrapper::~DataWrapper()
 {
+	if (m_ExternalHandle)
+		return;
+	m_Ctx->Telemetry->Unregister(this);
+	for (auto allocation : m_Allocations)
+		m_Ctx->DirtyRanges->Forget(allocation);
+	if (m_Allocation)
+		m_Ctx->DirtyRanges->Forget(m_Allocation);
+	auto destroy = [this](VkBuffer buffer, VmaAllocation allocation) {
+		// The relocation copy in flight may still write the buffer, its memory is freed by the defragmenter
+		if (m_Ctx->Defrag->Unregister(allocation))
+			m_Ctx->Defrag->DeferDestroy([device = m_Ctx->Device, buffer] { device.destroyBuffer(buffer); });
+		else
+			m_Ctx->Deletion->Push([allocator = m_Ctx->Allocator, buffer, allocation] { vmaDestroyBuffer(allocator, buffer, allocation); });
+	};
 	if (m_Buffers.size() > 0)
 	{
 		for (auto i = 0ull; i < m_Buffers.size(); i++)
 		{
-			vmaDestroyBuffer(m_Ctx->Allocator, m_Buffers[i], m_Allocations[i]);
+			destroy(m_Buffers[i], m_Allocations[i]);
 		}
 	}
 	else
 	{
-		vmaDestroyBuffer(m_Ctx->Allocator, m_Buffer, m_Allocation);
+		destroy(m_Buffer, m_Allocation);
 	}
 }
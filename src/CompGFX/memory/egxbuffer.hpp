@@ -1,5 +1,8 @@
 #pragma once
 #include <core/egx.hpp>
+#include <core/TransferEngine.hpp>
+#include "egxmemorystats.hpp"
+#include "egxreadback.hpp"
 
 namespace egx
 {
@@ -18,10 +21,21 @@ namespace egx
 		Default = Sequential,
 	};
 
+	struct BufferGrowthPolicy
+	{
+		// The capacity never drops below this many bytes
+		size_t MinCapacity = 0;
+		// Capacity multiplier applied until a growing size fits
+		double GrowthFactor = 2.0;
+		// Shrink only once the size is at most Capacity * ShrinkRatio, the new capacity is Size * GrowthFactor
+		double ShrinkRatio = 0.25;
+	};
+
 	class Buffer
 	{
 	public:
-		Buffer(const DeviceCtx& pCtx, size_t size, MemoryPreset memoryPreset, HostMemoryAccess memoryAccess, vk::BufferUsageFlags usage, bool isFrameResource);
+		/// <param name="persistentMapped">Keeps host visible memory mapped for the lifetime of the buffer, Map()/Unmap() become free</param>
+		Buffer(const DeviceCtx& pCtx, size_t size, MemoryPreset memoryPreset, HostMemoryAccess memoryAccess, vk::BufferUsageFlags usage, bool isFrameResource, bool persistentMapped = false);
 		Buffer() = default;
 		
 		~Buffer() noexcept {
@@ -34,12 +48,29 @@ namespace egx
 
 		void Write(const void* pData, size_t offset, size_t size);
 		void Write(const void* pData);
+
+		/// <summary>
+		/// Uploads through the dedicated transfer queue without blocking, DeviceOnly buffers only.
+		/// The data is usable by the graphics queue once the token completed and DeviceContext::FlushUploads()
+		/// submitted the ownership acquire (use TransferEngine::Require() to make the graphics queue wait for it).
+		/// Falls back to Write() when the device has no TransferEngine or the memory is host visible.
+		/// </summary>
+		TransferToken WriteAsync(const void* pData, size_t offset, size_t size);
 		void* Map();
 		void Unmap();
 
+		/// <summary>
+		/// Marks the whole buffer of the current frame as written, see MarkDirty().
+		/// </summary>
 		void FlushToGpu();
 		void InvalidateToCpu();
 
+		/// <summary>
+		/// Records a host write into the mapped memory of the current frame. Dirty ranges are coalesced and
+		/// flushed together by DeviceContext::FlushUploads() (or by Unmap()), coherent memory is never flushed.
+		/// </summary>
+		void MarkDirty(size_t offset, size_t size);
+
 		void WriteAll(const void* pData, size_t offset, size_t size);
 		void WriteAll(const void* pData);
 
@@ -47,21 +78,41 @@ namespace egx
 		void Read(void* pOutData);
 
 		/// <summary>
-		/// This function issues a resize commands,
-		/// when GetHandle() is called, the current frame's
-		/// buffer is resized.
+		/// Reads without blocking, device only memory is copied after the current frame's work and the
+		/// handle (and onReady) resolve once the copy retired. Host visible memory is read immediately.
+		/// </summary>
+		ReadbackHandle ReadAsync(size_t offset, size_t size, ReadbackQueue::ReadyCallback onReady = {});
+		ReadbackHandle ReadAsync(ReadbackQueue::ReadyCallback onReady = {}) { return ReadAsync(0, m_Size, std::move(onReady)); }
+
+		/// <summary>
+		/// Changes the size of the buffer, the backing allocation is only replaced when
+		/// the size leaves the capacity range allowed by the growth policy.
+		/// The reallocation happens lazily, per frame, in GetHandle() and preserves the contents
+		/// (memcpy for host visible memory, a copy enqueued on the submitter for device only memory).
+		/// Command buffers recorded against the previous handle must be enqueued before the reallocation.
 		/// </summary>
 		/// <param name="size"></param>
-		/// <returns>Was the buffer resized.</returns>
+		/// <returns>Was the buffer reallocated.</returns>
 		bool Resize(size_t size);
 
+		void SetGrowthPolicy(const BufferGrowthPolicy& policy) { m_Data->m_GrowthPolicy = policy; }
+		const BufferGrowthPolicy& GetGrowthPolicy() const { return m_Data->m_GrowthPolicy; }
+
 		void CopyTo(vk::CommandBuffer cmd, Buffer& dst, size_t srcOffset, size_t dstOffset, size_t size);
 		void CopyTo(vk::CommandBuffer cmd, Buffer& dst);
 
 		vk::Buffer GetHandle(int specificFrameIndex = -1, bool* pOutResizeFlag = nullptr) const;
 
 		bool IsMapped() const { return m_Data->m_IsMapped; }
+		bool IsPersistentMapped() const { return m_Data->m_PersistentMapped; }
 		size_t Size() const { return m_Size; }
+		size_t Capacity() const { return m_Data->m_Capacity; }
+
+		/// <summary>
+		/// Overrides the memory telemetry category, inferred from the usage flags at creation.
+		/// </summary>
+		void SetCategory(MemoryCategory category);
+		MemoryCategory GetCategory() const { return m_Data->m_Category; }
 
 		template<typename T>
 		static Buffer CreateFromVector(const DeviceCtx& device, const std::vector<T>& data, MemoryPreset memoryPreset, HostMemoryAccess memoryAccess, vk::BufferUsageFlags usage, bool isFrameResource) {
@@ -70,6 +121,12 @@ namespace egx
 			return result;
 		}
 
+		/// <summary>
+		/// Wraps a device only buffer whose memory is owned elsewhere (e.g. RenderGraph transients),
+		/// the handle is not destroyed with the wrapper and the buffer cannot be resized or mapped.
+		/// </summary>
+		static Buffer CreateFromHandle(const DeviceCtx& pCtx, vk::Buffer handle, size_t size, vk::BufferUsageFlags usage);
+
 	public:
 		vk::BufferUsageFlags Usage;
 		bool IsFrameResource;
@@ -77,23 +134,34 @@ namespace egx
 	private:
 		void _Write(const void* pData, size_t offset, size_t size, int resourceId);
 		void _CopyTo(vk::CommandBuffer cmd, Buffer& dst, size_t srcOffset, size_t dstOffset, size_t size, int dstResourceId);
-		VkResult _CreateBufferVma(VkBuffer* pOutBuffer, VmaAllocation* pOutAllocation) const;
+		VkResult _CreateBufferVma(size_t size, VkBuffer* pOutBuffer, VmaAllocation* pOutAllocation) const;
+		void _Reallocate(uint32_t resourceId) const;
+		void _RegisterRelocation(uint32_t resourceId) const;
+		void* _GetPersistentPtr(VmaAllocation allocation) const;
 
 		struct DataWrapper
 		{
 			DeviceCtx m_Ctx;
-			mutable std::vector<uint32_t> m_ResizeBufferFrameIds;
+			BufferGrowthPolicy m_GrowthPolicy;
+			// Capacity every resource is reallocated to
+			size_t m_Capacity = 0;
+			// Capacity of each resource (one per frame for frame resources)
+			mutable std::vector<size_t> m_Capacities;
 
 			mutable vk::Buffer m_Buffer;
 			mutable std::vector<vk::Buffer> m_Buffers;
 			
-			void* m_MappedPtr = nullptr;
-			std::vector<void*> m_MappedPtrs;
+			mutable void* m_MappedPtr = nullptr;
+			mutable std::vector<void*> m_MappedPtrs;
 
 			mutable VmaAllocation m_Allocation = nullptr;
 			mutable std::vector<VmaAllocation> m_Allocations;
 
 			bool m_IsMapped = false;
+			bool m_PersistentMapped = false;
+			// Created by CreateFromHandle(), nothing is destroyed or reported to telemetry
+			bool m_ExternalHandle = false;
+			MemoryCategory m_Category = MemoryCategory::Other;
 
 			DataWrapper() = default;
 			DataWrapper(DataWrapper&) = delete;
@@ -118,15 +186,30 @@ namespace egx
 		bool _CurrentMapState;
 		T& _Resource;
 
+		size_t _Offset = 0;
+		size_t _Size = SIZE_MAX;
+
 		MemoryMappedScope(T& resource) : _Resource(resource)
 		{
 			_CurrentMapState = resource.IsMapped();
 			Ptr = (uint8_t*)resource.Map();
 		}
 
+		/// <summary>
+		/// Only [offset, offset + size) is flushed when the scope ends, Ptr still points to the start of the resource.
+		/// </summary>
+		MemoryMappedScope(T& resource, size_t offset, size_t size) : MemoryMappedScope(resource)
+		{
+			_Offset = offset;
+			_Size = size;
+		}
+
 		~MemoryMappedScope()
 		{
-			_Resource.FlushToGpu();
+			if (_Size == SIZE_MAX)
+				_Resource.FlushToGpu();
+			else
+				_Resource.MarkDirty(_Offset, _Size);
 			if (!_CurrentMapState)
 			{
 				_Resource.Unmap();
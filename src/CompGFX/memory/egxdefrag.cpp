@@ -0,0 +1,199 @@
+#include "egxdefrag.hpp"
+#include <core/TransferEngine.hpp>
+#include <core/QueueSubmitter.hpp>
+
+using namespace egx;
+using namespace std;
+
+egx::Defragmenter::Defragmenter(DeviceContext* pCtx) : m_Ctx(pCtx)
+{
+	auto poolInfo = vk::CommandPoolCreateInfo()
+		.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+		.setQueueFamilyIndex(pCtx->GraphicsQueueFamilyIndex);
+	m_Pool = pCtx->Device.createCommandPool(poolInfo);
+	m_Cmd = pCtx->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_Pool, vk::CommandBufferLevel::ePrimary, 1))[0];
+	m_Fence = pCtx->Device.createFence({});
+}
+
+egx::Defragmenter::~Defragmenter()
+{
+	Cancel();
+	m_Ctx->Device.destroyFence(m_Fence);
+	m_Ctx->Device.destroyCommandPool(m_Pool);
+}
+
+void egx::Defragmenter::Begin(const DefragmentationSettings& settings)
+{
+	scoped_lock lock(m_Lock);
+	if (m_Context)
+		return;
+	VmaDefragmentationInfo info{};
+	info.flags = settings.Flags;
+	info.maxBytesPerPass = settings.MaxBytesPerPass;
+	info.maxAllocationsPerPass = settings.MaxAllocationsPerPass;
+	VkResult result = vmaBeginDefragmentation(m_Ctx->Allocator, &info, &m_Context);
+	if (result != VK_SUCCESS)
+	{
+		throw runtime_error(cpp::Format("Could not begin defragmentation, error code {}", vk::to_string(vk::Result(result))));
+	}
+}
+
+void egx::Defragmenter::Cancel()
+{
+	scoped_lock lock(m_Lock);
+	if (!m_Context)
+		return;
+	if (m_PassActive)
+	{
+		m_Ctx->Submitter->WaitForFences({ m_Fence });
+		_EndPass();
+	}
+	if (m_Context)
+		_Finish();
+}
+
+void egx::Defragmenter::Step()
+{
+	scoped_lock lock(m_Lock);
+	if (!m_Context)
+		return;
+	if (m_PassActive)
+	{
+		// Frames recorded before the pass may still reference the old handles
+		if (m_Ctx->FrameCount < m_PassFrameCount + m_Ctx->FramesInFlight)
+			return;
+		if (m_Ctx->Device.getFenceStatus(m_Fence) != vk::Result::eSuccess)
+			return;
+		_EndPass();
+		if (!m_Context)
+			return;
+	}
+	// Transfer queue uploads could still target the resources a pass would copy
+	if (m_Ctx->Transfer && !m_Ctx->Transfer->IsIdle())
+		return;
+	_BeginPass();
+}
+
+bool egx::Defragmenter::IsMoving(VmaAllocation allocation) const
+{
+	scoped_lock lock(m_Lock);
+	if (!m_PassActive)
+		return false;
+	for (uint32_t i = 0; i < m_Pass.moveCount; i++)
+	{
+		const auto& move = m_Pass.pMoves[i];
+		if (move.srcAllocation == allocation && move.operation == VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY)
+			return true;
+	}
+	return false;
+}
+
+void egx::Defragmenter::Register(VmaAllocation allocation, RelocateCallback callback)
+{
+	scoped_lock lock(m_Lock);
+	m_Relocatable[allocation] = std::move(callback);
+}
+
+bool egx::Defragmenter::Unregister(VmaAllocation allocation)
+{
+	scoped_lock lock(m_Lock);
+	m_Relocatable.erase(allocation);
+	if (!m_PassActive)
+		return false;
+	for (uint32_t i = 0; i < m_Pass.moveCount; i++)
+	{
+		auto& move = m_Pass.pMoves[i];
+		if (move.srcAllocation == allocation && move.operation == VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY)
+		{
+			// VMA frees both the old and the new place when the pass ends
+			move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+			return true;
+		}
+	}
+	return false;
+}
+
+void egx::Defragmenter::DeferDestroy(function<void()> destroy)
+{
+	scoped_lock lock(m_Lock);
+	if (!m_PassActive)
+	{
+		destroy();
+		return;
+	}
+	m_Deferred.push_back(std::move(destroy));
+}
+
+void egx::Defragmenter::_BeginPass()
+{
+	m_Pass = {};
+	VkResult result = vmaBeginDefragmentationPass(m_Ctx->Allocator, m_Context, &m_Pass);
+	if (result == VK_SUCCESS)
+	{
+		// Nothing left to move
+		_Finish();
+		return;
+	}
+	if (result != VK_INCOMPLETE)
+	{
+		LOG(WARNING, "Defragmentation pass failed, error code {}", vk::to_string(vk::Result(result)));
+		_Finish();
+		return;
+	}
+
+	m_Ctx->Device.resetCommandPool(m_Pool);
+	m_Cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	// Earlier submits may still write the resources being copied
+	vk::MemoryBarrier barrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferRead);
+	m_Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, barrier, {}, {});
+
+	m_PassActive = true;
+	uint32_t moved = 0;
+	for (uint32_t i = 0; i < m_Pass.moveCount; i++)
+	{
+		auto& move = m_Pass.pMoves[i];
+		auto relocatable = m_Relocatable.find(move.srcAllocation);
+		if (relocatable == m_Relocatable.end() || !relocatable->second(m_Cmd, move.dstTmpAllocation))
+		{
+			// Host visible, mapped or otherwise pinned resources stay in place
+			move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+			continue;
+		}
+		moved++;
+	}
+
+	barrier = vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+	m_Cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, barrier, {}, {});
+	m_Cmd.end();
+
+	if (moved == 0)
+	{
+		_EndPass();
+		return;
+	}
+	m_Ctx->Device.resetFences(m_Fence);
+	m_Ctx->Submitter->Enqueue(QueueType::Graphics, { m_Cmd }, {}, {}, m_Fence);
+	m_PassFrameCount = m_Ctx->FrameCount;
+}
+
+void egx::Defragmenter::_EndPass()
+{
+	m_PassActive = false;
+	for (auto& destroy : m_Deferred)
+		destroy();
+	m_Deferred.clear();
+
+	// The old places are released, the moved allocations now refer to their new place
+	VkResult result = vmaEndDefragmentationPass(m_Ctx->Allocator, m_Context, &m_Pass);
+	m_Pass = {};
+	if (result == VK_SUCCESS)
+		_Finish();
+}
+
+void egx::Defragmenter::_Finish()
+{
+	vmaEndDefragmentation(m_Ctx->Allocator, m_Context, &m_LastStats);
+	m_Context = nullptr;
+	LOG(INFO, "Defragmentation moved {} bytes ({} allocations), freed {} bytes ({} blocks).",
+		m_LastStats.bytesMoved, m_LastStats.allocationsMoved, m_LastStats.bytesFreed, m_LastStats.deviceMemoryBlocksFreed);
+}
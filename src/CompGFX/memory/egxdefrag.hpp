@@ -0,0 +1,94 @@
+#pragma once
+#include <core/egx.hpp>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace egx
+{
+
+	struct DefragmentationSettings
+	{
+		// Upper bound of the bytes copied by one pass (one pass per frame), 0 means no limit
+		vk::DeviceSize MaxBytesPerPass = 16ull * 1024ull * 1024ull;
+		// Upper bound of the allocations moved by one pass, 0 means no limit
+		uint32_t MaxAllocationsPerPass = 64;
+		VmaDefragmentationFlags Flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+	};
+
+	/// <summary>
+	/// Incremental defragmentation on top of the VMA defragmentation API.
+	/// Resources register the allocations they are able to relocate (device only buffers and
+	/// sampled images) together with a callback that creates the resource on the new memory,
+	/// records the copy and patches the handles of its DataWrapper in place.
+	/// Step() runs from DeviceContext::NextFrame(): each pass is bounded by DefragmentationSettings,
+	/// its copies are submitted on the graphics queue without waiting, and the pass is only ended
+	/// (old memory released, old handles destroyed) once its fence signaled and every frame that
+	/// could have recorded the old handles retired. ResourceDescriptor rewrites bindings whose
+	/// handles changed the next time it is bound.
+	/// </summary>
+	class Defragmenter
+	{
+	public:
+		/// <summary>
+		/// Creates the resource on dstAllocation (vmaBindBufferMemory()/vmaBindImageMemory()), records the copy
+		/// from the old resource and swaps the handles. Old handles are handed to DeferDestroy().
+		/// Returning false leaves the allocation in place.
+		/// </summary>
+		using RelocateCallback = std::function<bool(vk::CommandBuffer cmd, VmaAllocation dstAllocation)>;
+
+		Defragmenter(DeviceContext* pCtx);
+		Defragmenter(Defragmenter&) = delete;
+		~Defragmenter();
+
+		/// <summary>
+		/// Starts defragmenting the default pools, does nothing when already running.
+		/// </summary>
+		void Begin(const DefragmentationSettings& settings = {});
+		/// <summary>
+		/// Finishes the pass in flight (waits for its copies) and stops defragmenting.
+		/// </summary>
+		void Cancel();
+		void Step();
+
+		bool IsRunning() const { return m_Context != nullptr; }
+		/// <summary>
+		/// The allocation is being copied by the pass in flight, writes from other queues must wait for the pass.
+		/// </summary>
+		bool IsMoving(VmaAllocation allocation) const;
+		const VmaDefragmentationStats& GetLastStats() const { return m_LastStats; }
+
+		void Register(VmaAllocation allocation, RelocateCallback callback);
+		/// <summary>
+		/// Returns true when the allocation is being moved by the pass in flight. The defragmenter then
+		/// frees the memory itself at the end of the pass, the caller only destroys its handles (through DeferDestroy()).
+		/// </summary>
+		bool Unregister(VmaAllocation allocation);
+
+		/// <summary>
+		/// Runs destroy once the pass in flight ended, immediately when no pass is in flight.
+		/// </summary>
+		void DeferDestroy(std::function<void()> destroy);
+
+	private:
+		void _BeginPass();
+		void _EndPass();
+		void _Finish();
+
+	private:
+		DeviceContext* m_Ctx;
+		VmaDefragmentationContext m_Context = nullptr;
+		VmaDefragmentationPassMoveInfo m_Pass{};
+		bool m_PassActive = false;
+		uint64_t m_PassFrameCount = 0;
+		vk::CommandPool m_Pool;
+		vk::CommandBuffer m_Cmd;
+		vk::Fence m_Fence;
+
+		std::unordered_map<VmaAllocation, RelocateCallback> m_Relocatable;
+		std::vector<std::function<void()>> m_Deferred;
+		VmaDefragmentationStats m_LastStats{};
+		mutable std::recursive_mutex m_Lock;
+	};
+
+}
@@ -0,0 +1,65 @@
+#include "egxdirtyranges.hpp"
+#include <algorithm>
+
+using namespace egx;
+using namespace std;
+
+void egx::DirtyRangeTracker::Add(VmaAllocation allocation, vk::DeviceSize offset, vk::DeviceSize size)
+{
+	if (size == 0)
+		return;
+	VkMemoryPropertyFlags memoryFlags;
+	vmaGetAllocationMemoryProperties(m_Allocator, allocation, &memoryFlags);
+	if (memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+		return;
+
+	scoped_lock lock(m_Lock);
+	// Sequential writes into the same allocation extend the previous range
+	if (m_Ranges.size() > 0)
+	{
+		Range& last = m_Ranges.back();
+		if (last.Allocation == allocation && offset <= last.End && offset + size >= last.Offset)
+		{
+			last.Offset = min(last.Offset, offset);
+			last.End = max(last.End, offset + size);
+			return;
+		}
+	}
+	m_Ranges.push_back({ allocation, offset, offset + size });
+}
+
+void egx::DirtyRangeTracker::Forget(VmaAllocation allocation)
+{
+	scoped_lock lock(m_Lock);
+	erase_if(m_Ranges, [allocation](const Range& range) { return range.Allocation == allocation; });
+}
+
+void egx::DirtyRangeTracker::Flush()
+{
+	scoped_lock lock(m_Lock);
+	if (m_Ranges.empty())
+		return;
+
+	sort(m_Ranges.begin(), m_Ranges.end(), [](const Range& a, const Range& b) {
+		return a.Allocation != b.Allocation ? a.Allocation < b.Allocation : a.Offset < b.Offset;
+	});
+
+	vector<VmaAllocation> allocations;
+	vector<VkDeviceSize> offsets, sizes;
+	for (size_t i = 0; i < m_Ranges.size();)
+	{
+		Range merged = m_Ranges[i++];
+		while (i < m_Ranges.size() && m_Ranges[i].Allocation == merged.Allocation && m_Ranges[i].Offset <= merged.End)
+			merged.End = max(merged.End, m_Ranges[i++].End);
+		allocations.push_back(merged.Allocation);
+		offsets.push_back(merged.Offset);
+		sizes.push_back(merged.End - merged.Offset);
+	}
+	m_Ranges.clear();
+
+	VkResult result = vmaFlushAllocations(m_Allocator, (uint32_t)allocations.size(), allocations.data(), offsets.data(), sizes.data());
+	if (result != VK_SUCCESS)
+	{
+		LOG(WARNING, "Flushing {} dirty ranges failed, error code {}", allocations.size(), vk::to_string(vk::Result(result)));
+	}
+}
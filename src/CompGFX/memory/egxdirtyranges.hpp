@@ -0,0 +1,40 @@
+#pragma once
+#include <core/egx.hpp>
+#include <mutex>
+
+namespace egx
+{
+
+	/// <summary>
+	/// Collects host writes to mapped non-coherent allocations and flushes them in a single
+	/// vmaFlushAllocations() call. Overlapping and adjacent ranges of an allocation are merged.
+	/// DeviceContext::FlushUploads() flushes before work is submitted, allocations must be
+	/// forgotten before they are freed.
+	/// </summary>
+	class DirtyRangeTracker
+	{
+	public:
+		DirtyRangeTracker(VmaAllocator allocator) : m_Allocator(allocator) {}
+		DirtyRangeTracker(DirtyRangeTracker&) = delete;
+
+		/// <summary>
+		/// Records a written range, ignored for host coherent memory.
+		/// </summary>
+		void Add(VmaAllocation allocation, vk::DeviceSize offset, vk::DeviceSize size);
+		void Forget(VmaAllocation allocation);
+		void Flush();
+
+	private:
+		struct Range
+		{
+			VmaAllocation Allocation;
+			vk::DeviceSize Offset;
+			vk::DeviceSize End;
+		};
+
+		VmaAllocator m_Allocator;
+		std::vector<Range> m_Ranges;
+		std::mutex m_Lock;
+	};
+
+}
@@ -0,0 +1,95 @@
+#include "egxframearena.hpp"
+#include "egxmemorystats.hpp"
+#include <core/DeletionQueue.hpp>
+
+using namespace egx;
+using namespace std;
+
+egx::FrameArena::FrameArena(const DeviceCtx& pCtx, vk::DeviceSize capacityPerFrame, vk::BufferUsageFlags usage)
+{
+	if (capacityPerFrame == 0)
+	{
+		throw std::invalid_argument("Size == 0, cannot create frame arena with size 0");
+	}
+
+	m_Data = make_shared<FrameArena::DataWrapper>();
+	m_Data->m_Ctx = pCtx;
+	m_Data->m_Capacity = capacityPerFrame;
+
+	auto limits = pCtx->PhysicalDeviceQuery.PhysicalDevice.getProperties().limits;
+	if (usage & vk::BufferUsageFlagBits::eUniformBuffer)
+		m_Data->m_Alignment = max(m_Data->m_Alignment, limits.minUniformBufferOffsetAlignment);
+	if (usage & vk::BufferUsageFlagBits::eStorageBuffer)
+		m_Data->m_Alignment = max(m_Data->m_Alignment, limits.minStorageBufferOffsetAlignment);
+
+	VkBufferCreateInfo createInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	createInfo.size = capacityPerFrame;
+	createInfo.usage = VkBufferUsageFlags(usage);
+	createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VmaAllocationCreateInfo allocCreateInfo{};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO;
+	allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	// Coherent memory so allocations never have to be flushed individually
+	allocCreateInfo.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	m_Data->m_Blocks.resize(pCtx->FramesInFlight);
+	for (auto& block : m_Data->m_Blocks)
+	{
+		VmaAllocationInfo allocationInfo{};
+		VkResult result = vmaCreateBuffer(pCtx->Allocator, &createInfo, &allocCreateInfo, &block.Buffer, &block.Allocation, &allocationInfo);
+		if (result != VK_SUCCESS)
+		{
+			throw std::runtime_error(cpp::Format("Could not create frame arena with {} bytes, usage={}, error code {}", capacityPerFrame, vk::to_string(usage), vk::to_string(vk::Result(result))));
+		}
+		block.Mapped = (uint8_t*)allocationInfo.pMappedData;
+	}
+	pCtx->Telemetry->Register(m_Data.get(), MemoryCategory::FrameResource, capacityPerFrame * pCtx->FramesInFlight);
+}
+
+FrameAllocation egx::FrameArena::Allocate(vk::DeviceSize size, vk::DeviceSize alignment)
+{
+	uint32_t frame = m_Data->m_Ctx->CurrentFrame;
+	if (m_Data->m_FrameCount != m_Data->m_Ctx->FrameCount)
+	{
+		// The previous use of this frame's buffer retired together with the frame
+		m_Data->m_FrameCount = m_Data->m_Ctx->FrameCount;
+		m_Data->m_Head = 0;
+	}
+
+	alignment = max(alignment, m_Data->m_Alignment);
+	vk::DeviceSize offset = (m_Data->m_Head + alignment - 1) / alignment * alignment;
+	if (offset + size > m_Data->m_Capacity)
+	{
+		throw std::runtime_error(cpp::Format("Frame arena out of memory, requested {} bytes with {} of {} bytes used.", size, m_Data->m_Head, m_Data->m_Capacity));
+	}
+	m_Data->m_Head = offset + size;
+
+	const Block& block = m_Data->m_Blocks[frame];
+	FrameAllocation allocation;
+	allocation.Buffer = block.Buffer;
+	allocation.Offset = offset;
+	allocation.Size = size;
+	allocation.Ptr = block.Mapped + offset;
+	return allocation;
+}
+
+vk::Buffer egx::FrameArena::GetHandle(int specificFrameIndex) const
+{
+	uint32_t frame = specificFrameIndex < 0 ? m_Data->m_Ctx->CurrentFrame : specificFrameIndex;
+	return m_Data->m_Blocks[frame].Buffer;
+}
+
+vk::DeviceSize egx::FrameArena::Used() const
+{
+	return m_Data->m_FrameCount == m_Data->m_Ctx->FrameCount ? m_Data->m_Head : 0;
+}
+
+FrameArena::DataWrapper::~DataWrapper()
+{
+	m_Ctx->Telemetry->Unregister(this);
+	// Frames in flight may still read their block
+	for (auto& block : m_Blocks)
+		m_Ctx->Deletion->Push([allocator = m_Ctx->Allocator, buffer = block.Buffer, allocation = block.Allocation] {
+			vmaDestroyBuffer(allocator, buffer, allocation);
+		});
+}
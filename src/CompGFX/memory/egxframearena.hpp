@@ -0,0 +1,75 @@
+#pragma once
+#include <core/egx.hpp>
+
+namespace egx
+{
+
+	struct FrameAllocation
+	{
+		vk::Buffer Buffer;
+		vk::DeviceSize Offset = 0;
+		vk::DeviceSize Size = 0;
+		void* Ptr = nullptr;
+
+		template<typename T>
+		T* As() const { return (T*)Ptr; }
+	};
+
+	/// <summary>
+	/// Linear allocator for transient per frame data (per draw uniforms, instance data, ...).
+	/// Owns one persistently mapped host coherent buffer per frame in flight, Allocate() bumps
+	/// an offset into the current frame's buffer which is rewound the first time it is used
+	/// in a new frame. Meant to be bound once as a dynamic uniform/storage buffer through
+	/// ResourceDescriptor::SetInput() and addressed with ResourceDescriptor::SetBufferOffset().
+	/// </summary>
+	class FrameArena
+	{
+	public:
+		FrameArena() = default;
+		FrameArena(const DeviceCtx& pCtx, vk::DeviceSize capacityPerFrame,
+			vk::BufferUsageFlags usage = vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer);
+
+		/// <summary>
+		/// Allocates from the current frame's buffer, throws when the frame's capacity is exhausted.
+		/// </summary>
+		/// <param name="alignment">0 uses the minimum offset alignment required by the usage flags</param>
+		FrameAllocation Allocate(vk::DeviceSize size, vk::DeviceSize alignment = 0);
+
+		template<typename T>
+		FrameAllocation Push(const T& value) {
+			auto allocation = Allocate(sizeof(T));
+			memcpy(allocation.Ptr, &value, sizeof(T));
+			return allocation;
+		}
+
+		vk::Buffer GetHandle(int specificFrameIndex = -1) const;
+		vk::DeviceSize CapacityPerFrame() const { return m_Data->m_Capacity; }
+		vk::DeviceSize Used() const;
+		vk::DeviceSize Alignment() const { return m_Data->m_Alignment; }
+
+	private:
+		struct Block
+		{
+			VkBuffer Buffer = nullptr;
+			VmaAllocation Allocation = nullptr;
+			uint8_t* Mapped = nullptr;
+		};
+
+		struct DataWrapper
+		{
+			DeviceCtx m_Ctx;
+			std::vector<Block> m_Blocks;
+			vk::DeviceSize m_Capacity = 0;
+			vk::DeviceSize m_Alignment = 1;
+			vk::DeviceSize m_Head = 0;
+			uint64_t m_FrameCount = UINT64_MAX;
+
+			DataWrapper() = default;
+			DataWrapper(DataWrapper&) = delete;
+			~DataWrapper();
+		};
+
+		std::shared_ptr<DataWrapper> m_Data;
+	};
+
+}
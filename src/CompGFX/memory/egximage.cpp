@@ -1,6 +1,10 @@
 #include "egximage.hpp"
 #include "formatsize.hpp"
+#include "egxdefrag.hpp"
+#include "egxstaging.hpp"
+#include <numeric>
 #include <core/CommandBuffer.hpp>
+#include <core/DeletionQueue.hpp>
 #include <imgui/backends/imgui_impl_vulkan.h>
 #include <stb/stb_image.h>
 
@@ -46,10 +50,21 @@ Image2D::Image2D(const DeviceCtx& pCtx, int width, int height, vk::Format format
 	}
 
 	m_Data->m_Image = handle;
+	m_Data->m_CreateInfo = createInfo;
 	m_TexelBytes = egx::FormatByteCount(VkFormat(format));
 
-	size_t size = (static_cast<size_t>(width) * m_TexelBytes) * height;
-	m_Data->m_StageBuffer = std::make_unique<Buffer>(m_Data->m_Ctx, size, egx::MemoryPreset::HostOnly, egx::HostMemoryAccess::Sequential, vk::BufferUsageFlagBits::eTransferSrc, false);
+	if (usage & (vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment))
+		m_Data->m_Category = MemoryCategory::RenderTarget;
+	VmaAllocationInfo allocationInfo{};
+	vmaGetAllocationInfo(pCtx->Allocator, m_Data->m_Allocation, &allocationInfo);
+	pCtx->Telemetry->Register(m_Data.get(), m_Data->m_Category, allocationInfo.size);
+	_RegisterRelocation();
+
+	// Only streaming images keep their own staging buffer, everything else borrows from the device's staging ring and pool
+	if (streaming) {
+		size_t size = (static_cast<size_t>(width) * m_TexelBytes) * height;
+		m_Data->m_StageBuffer = std::make_unique<Buffer>(m_Data->m_Ctx, size, egx::MemoryPreset::HostOnly, egx::HostMemoryAccess::Sequential, vk::BufferUsageFlagBits::eTransferSrc, false);
+	}
 	SetLayout(initialLayout);
 }
 
@@ -109,38 +124,41 @@ void Image2D::GetPixel(int mipLevel, int x, int y)
 
 void Image2D::SetImageData(int mipLevel, int xOffset, int yOffset, int width, int height, const void* pData)
 {
-	ScopedCommandBuffer cmd(m_Data->m_Ctx);
-	m_Data->m_StageBuffer->Write(pData, 0, (width * m_TexelBytes) * height);
-
-	VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
-	barrier.srcAccessMask = VK_ACCESS_NONE;
-	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.oldLayout = VkImageLayout(CurrentLayout);
-	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = m_Data->m_Image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.subresourceRange.baseMipLevel = 0;
-	vkCmdPipelineBarrier(cmd.Get(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-	VkBufferImageCopy region{};
-	region.imageOffset = { (int32_t)xOffset, (int32_t)yOffset, (int32_t)0 };
-	region.imageExtent = { (uint32_t)width, (uint32_t)height, 1 };
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageSubresource.mipLevel = 0;
-	vkCmdCopyBufferToImage(cmd.Get(), m_Data->m_StageBuffer->GetHandle(), m_Data->m_Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.newLayout = VkImageLayout(CurrentLayout);
-	barrier.srcAccessMask = barrier.dstAccessMask;
-	barrier.dstAccessMask = VK_ACCESS_NONE;
-	vkCmdPipelineBarrier(cmd.Get(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	// An undefined image is transitioned from eUndefined, the layout is only updated once the copy was recorded
+	vk::ImageLayout oldLayout = CurrentLayout;
+	vk::ImageLayout finalLayout = oldLayout == vk::ImageLayout::eUndefined ? vk::ImageLayout::eGeneral : oldLayout;
+	vk::DeviceSize size = (static_cast<vk::DeviceSize>(width) * m_TexelBytes) * height;
+
+	auto record = [&](vk::CommandBuffer cmd, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset) {
+		vk::ImageSubresourceRange range(GetFormatAspectFlags(Format), mipLevel, 1, 0, 1);
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+			vk::ImageMemoryBarrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferWrite, oldLayout, vk::ImageLayout::eTransferDstOptimal,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_Data->m_Image, range));
+
+		vk::BufferImageCopy region;
+		region.bufferOffset = stagingOffset;
+		region.imageOffset = vk::Offset3D(xOffset, yOffset, 0);
+		region.imageExtent = vk::Extent3D(width, height, 1);
+		region.imageSubresource = vk::ImageSubresourceLayers(GetFormatAspectFlags(Format), mipLevel, 0, 1);
+		cmd.copyBufferToImage(stagingBuffer, m_Data->m_Image, vk::ImageLayout::eTransferDstOptimal, region);
+
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, {}, {},
+			vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead, vk::ImageLayout::eTransferDstOptimal, finalLayout,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, m_Data->m_Image, range));
+	};
+
+	if (m_Data->m_StageBuffer) {
+		// Streaming images reuse their own staging buffer, the copy runs immediately
+		ScopedCommandBuffer cmd(m_Data->m_Ctx);
+		m_Data->m_StageBuffer->Write(pData, 0, size);
+		record(*cmd, m_Data->m_StageBuffer->GetHandle(), 0);
+	}
+	else {
+		// Recorded into the frame's upload batch, submitted by DeviceContext::FlushUploads()
+		m_Data->m_Ctx->Staging->Stage(pData, size, std::lcm<vk::DeviceSize>(m_TexelBytes, 4), record);
+	}
+	CurrentLayout = finalLayout;
+	m_Data->m_Layout = finalLayout;
 }
 
 void Image2D::SetImageData(int mipLevel, const void* pData)
@@ -148,73 +166,65 @@ void Image2D::SetImageData(int mipLevel, const void* pData)
 	SetImageData(mipLevel, 0, 0, Width, Height, pData);
 }
 
-void Image2D::Read(int mipLevel, int xOffset, int yOffset, int width, int height, void* pOutBuffer)
+TransferToken Image2D::SetImageDataAsync(int mipLevel, const void* pData)
 {
-	ScopedCommandBuffer cmd(m_Data->m_Ctx);
-	cmd->pipelineBarrier(
-		vk::PipelineStageFlagBits::eTopOfPipe,
-		vk::PipelineStageFlagBits::eTransfer,
-		vk::DependencyFlagBits(0), {}, {}, vk::ImageMemoryBarrier(
-			vk::AccessFlagBits::eNone,
-			vk::AccessFlagBits::eTransferRead,
-			CurrentLayout,
-			vk::ImageLayout::eTransferSrcOptimal,
-			VK_QUEUE_FAMILY_IGNORED,
-			VK_QUEUE_FAMILY_IGNORED,
-			m_Data->m_Image,
-			vk::ImageSubresourceRange(
-				GetFormatAspectFlags(Format),
-				mipLevel,
-				1,
-				0,
-				1
-			)
-		));
-
-	vk::BufferImageCopy region;
-
-	region.imageOffset.x = xOffset;
-	region.imageOffset.y = yOffset;
-	region.imageExtent.width = width;
-	region.imageExtent.height = height;
-	region.imageExtent.depth = 1;
-	region.imageSubresource.aspectMask = GetFormatAspectFlags(Format);
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageSubresource.mipLevel = 0;
-
-	cmd->copyImageToBuffer(m_Data->m_Image, vk::ImageLayout::eTransferSrcOptimal, m_Data->m_StageBuffer->GetHandle(), region);
-
-	if (CurrentLayout == vk::ImageLayout::eUndefined) {
-		CurrentLayout = vk::ImageLayout::eGeneral;
+	auto& transfer = m_Data->m_Ctx->Transfer;
+	// An image being relocated is written on the graphics queue, ordered after the relocation copy
+	if (!transfer || m_Data->m_Ctx->Defrag->IsMoving(m_Data->m_Allocation))
+	{
+		SetImageData(mipLevel, pData);
+		return {};
 	}
+	// UploadImage() transitions from eUndefined, the layout is only updated once the upload was recorded
+	vk::ImageLayout finalLayout = CurrentLayout == vk::ImageLayout::eUndefined ? vk::ImageLayout::eGeneral : CurrentLayout;
+	int width = std::max(Width >> mipLevel, 1);
+	int height = std::max(Height >> mipLevel, 1);
+	vk::DeviceSize size = (static_cast<vk::DeviceSize>(width) * m_TexelBytes) * height;
+	auto token = transfer->UploadImage(m_Data->m_Image, GetFormatAspectFlags(Format), mipLevel, width, height, pData, size, finalLayout);
+	CurrentLayout = finalLayout;
+	m_Data->m_Layout = finalLayout;
+	return token;
+}
+
+void Image2D::Read(int mipLevel, int xOffset, int yOffset, int width, int height, void* pOutBuffer)
+{
+	auto readback = ReadAsync(mipLevel, xOffset, yOffset, width, height);
+	const auto& data = readback.Get();
+	memcpy(pOutBuffer, data.data(), data.size());
+}
 
-	cmd->pipelineBarrier(
-		vk::PipelineStageFlagBits::eTransfer,
-		vk::PipelineStageFlagBits::eTransfer,
-		vk::DependencyFlagBits(0), {}, {}, vk::ImageMemoryBarrier(
-			vk::AccessFlagBits::eTransferRead,
-			vk::AccessFlagBits::eNone,
-			vk::ImageLayout::eTransferSrcOptimal,
-			CurrentLayout,
-			VK_QUEUE_FAMILY_IGNORED,
-			VK_QUEUE_FAMILY_IGNORED,
-			m_Data->m_Image,
-			vk::ImageSubresourceRange(
-				GetFormatAspectFlags(Format),
-				mipLevel,
-				1,
-				0,
-				1
-			)
-		));
-
-	cmd.RunNow();
-
-	size_t memorySize = (static_cast<size_t>(width) * m_TexelBytes) * height;
-	egx::MemoryMappedScope scope(*m_Data->m_StageBuffer.get());
-	memcpy(pOutBuffer, scope.Ptr, memorySize);
+ReadbackHandle Image2D::ReadAsync(int mipLevel, int xOffset, int yOffset, int width, int height, ReadbackQueue::ReadyCallback onReady)
+{
+	vk::DeviceSize size = (static_cast<vk::DeviceSize>(width) * m_TexelBytes) * height;
+	auto aspect = GetFormatAspectFlags(Format);
+	// Recorded by ReadbackQueue::Submit() after the frame's work, the layout is the one that work left the image in
+	return m_Data->m_Ctx->Readback->Record(size, [data = m_Data, aspect, mipLevel, xOffset, yOffset, width, height](vk::CommandBuffer cmd, vk::Buffer dst) {
+		vk::ImageLayout oldLayout = data->m_Layout;
+		vk::ImageLayout finalLayout = oldLayout == vk::ImageLayout::eUndefined ? vk::ImageLayout::eGeneral : oldLayout;
+		vk::ImageSubresourceRange range(aspect, mipLevel, 1, 0, 1);
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, {}, {},
+			vk::ImageMemoryBarrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferRead, oldLayout, vk::ImageLayout::eTransferSrcOptimal,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, data->m_Image, range));
+
+		vk::BufferImageCopy region;
+		region.imageOffset = vk::Offset3D(xOffset, yOffset, 0);
+		region.imageExtent = vk::Extent3D(width, height, 1);
+		region.imageSubresource = vk::ImageSubresourceLayers(aspect, mipLevel, 0, 1);
+		cmd.copyImageToBuffer(data->m_Image, vk::ImageLayout::eTransferSrcOptimal, dst, region);
+
+		cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, {}, {},
+			vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferRead, vk::AccessFlagBits::eNone, vk::ImageLayout::eTransferSrcOptimal, finalLayout,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, data->m_Image, range));
+		// CurrentLayout of an undefined image stays eUndefined, transitioning from it later is always valid
+		data->m_Layout = finalLayout;
+	}, std::move(onReady));
+}
+
+ReadbackHandle Image2D::ReadAsync(int mipLevel, ReadbackQueue::ReadyCallback onReady)
+{
+	return ReadAsync(mipLevel, 0, 0, std::max(Width >> mipLevel, 1), std::max(Height >> mipLevel, 1), std::move(onReady));
 }
+
 void Image2D::Read(int mipLevel, void* pOutBuffer)
 {
 	Read(mipLevel, 0, 0, Width, Height, pOutBuffer);
@@ -325,6 +335,7 @@ void egx::Image2D::SetLayout(vk::ImageLayout layout)
 	cmd->pipelineBarrier2(barrier);
 
 	CurrentLayout = layout;
+	m_Data->m_Layout = layout;
 }
 
 vk::ImageView Image2D::CreateView(int id, int mipLevel, int mipCount, vk::ComponentMapping RGBASwizzle)
@@ -337,9 +348,9 @@ vk::ImageView Image2D::CreateView(int id, int mipLevel, int mipCount, vk::Compon
 		.setBaseMipLevel(mipLevel)
 		.setLevelCount(mipCount)
 		.setLayerCount(VK_REMAINING_ARRAY_LAYERS);
-	m_Data->m_Views[id] = m_Data->m_Ctx->Device.createImageView(vk::ImageViewCreateInfo(
-		{}, m_Data->m_Image, vk::ImageViewType::e2D, Format, RGBASwizzle, range
-	));
+	auto viewInfo = vk::ImageViewCreateInfo({}, m_Data->m_Image, vk::ImageViewType::e2D, Format, RGBASwizzle, range);
+	m_Data->m_Views[id] = m_Data->m_Ctx->Device.createImageView(viewInfo);
+	m_Data->m_ViewInfos[id] = viewInfo;
 	return m_Data->m_Views[id];
 }
 
@@ -380,12 +391,24 @@ void egx::Image2D::DataWrapper::Reset()
 	if (m_TextureID)
 		ImGui_ImplVulkan_RemoveTexture((VkDescriptorSet)m_TextureID);
 
-	for (auto& [id, view] : m_Views) {
-		m_Ctx->Device.destroyImageView(view);
+	if (m_Views.size() > 0) {
+		vector<vk::ImageView> views;
+		for (auto& [id, view] : m_Views)
+			views.push_back(view);
+		m_Ctx->Deletion->Push([device = m_Ctx->Device, views] {
+			for (auto view : views)
+				device.destroyImageView(view);
+		});
 	}
 	m_Views.clear();
+	m_ViewInfos.clear();
 	if (m_Ctx && m_Allocation) {
-		vmaDestroyImage(m_Ctx->Allocator, m_Image, m_Allocation);
+		m_Ctx->Telemetry->Unregister(this);
+		// The relocation copy in flight may still write the image, its memory is freed by the defragmenter
+		if (m_Ctx->Defrag->Unregister(m_Allocation))
+			m_Ctx->Defrag->DeferDestroy([device = m_Ctx->Device, image = m_Image] { device.destroyImage(image); });
+		else
+			m_Ctx->Deletion->Push([allocator = m_Ctx->Allocator, image = m_Image, allocation = m_Allocation] { vmaDestroyImage(allocator, image, allocation); });
 		m_Allocation = nullptr;
 	}
 }
@@ -394,5 +417,71 @@ void egx::Image2D::RecreateImageWithDifferentResolution(int width, int height)
 {
 	Image2D resized_image(m_Data->m_Ctx, ivec2{width, height}, Format, m_RequestedMipLevels, Usage, vk::ImageLayout::eUndefined, StreamingMode);
 	resized_image.SetLayout(CurrentLayout);
+	resized_image.SetCategory(m_Data->m_Category);
 	m_Data = resized_image.m_Data;
 }
+
+void egx::Image2D::SetCategory(MemoryCategory category)
+{
+	m_Data->m_Category = category;
+	m_Data->m_Ctx->Telemetry->SetCategory(m_Data.get(), category);
+}
+
+void egx::Image2D::_RegisterRelocation()
+{
+	// Attachments can be referenced by framebuffers outside of the image
+	if (Usage & (vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eDepthStencilAttachment))
+		return;
+	DataWrapper* data = m_Data.get();
+	data->m_Ctx->Defrag->Register(data->m_Allocation, [data](vk::CommandBuffer cmd, VmaAllocation dstAllocation) {
+		// ImGui owns the descriptor set of the texture id
+		if (data->m_TextureID)
+			return false;
+		const auto& ctx = data->m_Ctx;
+		vk::Image image = ctx->Device.createImage(data->m_CreateInfo);
+		if (vmaBindImageMemory(ctx->Allocator, dstAllocation, image) != VK_SUCCESS)
+		{
+			ctx->Device.destroyImage(image);
+			return false;
+		}
+
+		const auto& createInfo = data->m_CreateInfo;
+		auto aspect = GetFormatAspectFlags(vk::Format(createInfo.format));
+		vk::ImageSubresourceRange range(aspect, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS);
+		// Undefined contents do not have to be copied
+		if (data->m_Layout != vk::ImageLayout::eUndefined)
+		{
+			std::array<vk::ImageMemoryBarrier, 2> barriers = {
+				vk::ImageMemoryBarrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferRead, data->m_Layout, vk::ImageLayout::eTransferSrcOptimal,
+					VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, data->m_Image, range),
+				vk::ImageMemoryBarrier(vk::AccessFlagBits::eNone, vk::AccessFlagBits::eTransferWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal,
+					VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, range)
+			};
+			cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, {}, {}, barriers);
+
+			std::vector<vk::ImageCopy> regions(createInfo.mipLevels);
+			for (uint32_t mip = 0; mip < createInfo.mipLevels; mip++)
+			{
+				vk::ImageSubresourceLayers subresource(aspect, mip, 0, 1);
+				vk::Extent3D extent(std::max(createInfo.extent.width >> mip, 1u), std::max(createInfo.extent.height >> mip, 1u), 1);
+				regions[mip] = vk::ImageCopy(subresource, {}, subresource, {}, extent);
+			}
+			cmd.copyImage(data->m_Image, vk::ImageLayout::eTransferSrcOptimal, image, vk::ImageLayout::eTransferDstOptimal, regions);
+
+			auto finalBarrier = vk::ImageMemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead, vk::ImageLayout::eTransferDstOptimal, data->m_Layout,
+				VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image, range);
+			cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, {}, {}, finalBarrier);
+		}
+
+		auto device = ctx->Device;
+		for (auto& [id, viewInfo] : data->m_ViewInfos)
+		{
+			viewInfo.image = image;
+			ctx->Defrag->DeferDestroy([device, view = data->m_Views[id]] { device.destroyImageView(view); });
+			data->m_Views[id] = device.createImageView(viewInfo);
+		}
+		ctx->Defrag->DeferDestroy([device, oldImage = data->m_Image] { device.destroyImage(oldImage); });
+		data->m_Image = image;
+		return true;
+	});
+}
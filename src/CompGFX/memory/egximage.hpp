@@ -25,9 +25,23 @@ namespace egx
 		void SetImageData(int mipLevel, int xOffset, int yOffset, int width, int height, const void *pData);
 		void SetImageData(int mipLevel, const void *pData);
 
+		/// <summary>
+		/// Uploads a whole mip level through the dedicated transfer queue without blocking.
+		/// The previous contents of the mip level are discarded. Falls back to SetImageData()
+		/// when the device has no TransferEngine.
+		/// </summary>
+		TransferToken SetImageDataAsync(int mipLevel, const void *pData);
+
 		void Read(int mipLevel, int xOffset, int yOffset, int width, int height, void *pOutBuffer);
 		void Read(int mipLevel, void *pOutBuffer);
 
+		/// <summary>
+		/// Records the copy after the current frame's work and returns without blocking,
+		/// the handle (and onReady) resolve once the copy retired. See ReadbackQueue.
+		/// </summary>
+		ReadbackHandle ReadAsync(int mipLevel, int xOffset, int yOffset, int width, int height, ReadbackQueue::ReadyCallback onReady = {});
+		ReadbackHandle ReadAsync(int mipLevel, ReadbackQueue::ReadyCallback onReady = {});
+
 		void GenerateMipmaps();
 		void SetLayout(vk::ImageLayout layout);
 
@@ -40,6 +54,12 @@ namespace egx
 		}
 
 		vk::Image GetHandle() const;
+
+		/// <summary>
+		/// Overrides the memory telemetry category, inferred from the usage flags at creation.
+		/// </summary>
+		void SetCategory(MemoryCategory category);
+		MemoryCategory GetCategory() const { return m_Data->m_Category; }
 		ImTextureID GetImGuiTextureID(vk::Sampler sampler, uint32_t viewId = 0);
 
 		static Image2D CreateFromFile(const DeviceCtx& pCtx, const std::string& filePath, vk::Format format, int mipLevels, vk::ImageUsageFlags usage, vk::ImageLayout initalLayout, bool streaming);
@@ -53,14 +73,22 @@ namespace egx
 		vk::ImageLayout CurrentLayout;
 
 	private:
+		void _RegisterRelocation();
+
 		struct DataWrapper
 		{
 			DeviceCtx m_Ctx;
 			vk::Image m_Image = nullptr;
 			std::unique_ptr<egx::Buffer> m_StageBuffer;
 			std::map<int, vk::ImageView> m_Views;
+			// Kept to recreate the image and its views when the defragmenter relocates the allocation
+			VkImageCreateInfo m_CreateInfo{};
+			std::map<int, vk::ImageViewCreateInfo> m_ViewInfos;
+			// Last layout set through any copy of the image
+			vk::ImageLayout m_Layout = vk::ImageLayout::eUndefined;
 			VmaAllocation m_Allocation = nullptr;
 			ImTextureID m_TextureID = nullptr;
+			MemoryCategory m_Category = MemoryCategory::Texture;
 
 			void Reset();
 
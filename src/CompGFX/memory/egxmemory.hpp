@@ -1,3 +1,10 @@
 #pragma once
 #include "egxbuffer.hpp"
-#include "egximage.hpp"
\ No newline at end of file
+#include "egximage.hpp"
+#include "egxstaging.hpp"
+#include "egxstagingpool.hpp"
+#include "egxreadback.hpp"
+#include "egxdirtyranges.hpp"
+#include "egxmemorystats.hpp"
+#include "egxdefrag.hpp"
+#include "egxframearena.hpp"
\ No newline at end of file
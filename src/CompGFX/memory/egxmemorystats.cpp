@@ -0,0 +1,210 @@
+#include "egxmemorystats.hpp"
+#include <imgui/imgui.h>
+#include <json.hpp>
+#include <fstream>
+
+using namespace egx;
+using namespace std;
+
+const char* egx::ToString(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Mesh: return "Mesh";
+	case MemoryCategory::Texture: return "Texture";
+	case MemoryCategory::Staging: return "Staging";
+	case MemoryCategory::RenderTarget: return "RenderTarget";
+	case MemoryCategory::FrameResource: return "FrameResource";
+	case MemoryCategory::Other: return "Other";
+	default: return "Unknown";
+	}
+}
+
+void egx::MemoryTelemetry::Register(const void* owner, MemoryCategory category, vk::DeviceSize size)
+{
+	scoped_lock lock(m_Lock);
+	m_Entries[owner] = { category, size };
+	auto& usage = m_Usage[(size_t)category];
+	usage.Bytes += size;
+	usage.Count++;
+}
+
+void egx::MemoryTelemetry::Update(const void* owner, vk::DeviceSize size)
+{
+	scoped_lock lock(m_Lock);
+	auto entry = m_Entries.find(owner);
+	if (entry == m_Entries.end())
+		return;
+	auto& usage = m_Usage[(size_t)entry->second.Category];
+	usage.Bytes = usage.Bytes - entry->second.Size + size;
+	entry->second.Size = size;
+}
+
+void egx::MemoryTelemetry::SetCategory(const void* owner, MemoryCategory category)
+{
+	scoped_lock lock(m_Lock);
+	auto entry = m_Entries.find(owner);
+	if (entry == m_Entries.end())
+		return;
+	auto& previous = m_Usage[(size_t)entry->second.Category];
+	previous.Bytes -= entry->second.Size;
+	previous.Count--;
+	auto& next = m_Usage[(size_t)category];
+	next.Bytes += entry->second.Size;
+	next.Count++;
+	entry->second.Category = category;
+}
+
+void egx::MemoryTelemetry::Unregister(const void* owner)
+{
+	scoped_lock lock(m_Lock);
+	auto entry = m_Entries.find(owner);
+	if (entry == m_Entries.end())
+		return;
+	auto& usage = m_Usage[(size_t)entry->second.Category];
+	usage.Bytes -= entry->second.Size;
+	usage.Count--;
+	m_Entries.erase(entry);
+}
+
+MemoryCategoryUsage egx::MemoryTelemetry::GetCategoryUsage(MemoryCategory category) const
+{
+	scoped_lock lock(m_Lock);
+	return m_Usage[(size_t)category];
+}
+
+std::vector<MemoryHeapBudget> egx::MemoryTelemetry::GetHeapBudgets() const
+{
+	const VkPhysicalDeviceMemoryProperties* pMemoryProperties = nullptr;
+	vmaGetMemoryProperties(m_Ctx->Allocator, &pMemoryProperties);
+	vector<VmaBudget> budgets(pMemoryProperties->memoryHeapCount);
+	vmaGetHeapBudgets(m_Ctx->Allocator, budgets.data());
+
+	vector<MemoryHeapBudget> heaps;
+	for (uint32_t i = 0; i < pMemoryProperties->memoryHeapCount; i++)
+	{
+		MemoryHeapBudget heap{};
+		heap.HeapIndex = i;
+		heap.Flags = vk::MemoryHeapFlags(pMemoryProperties->memoryHeaps[i].flags);
+		heap.BudgetBytes = budgets[i].budget;
+		heap.UsageBytes = budgets[i].usage;
+		heap.AllocationBytes = budgets[i].statistics.allocationBytes;
+		heap.BlockBytes = budgets[i].statistics.blockBytes;
+		heap.AllocationCount = budgets[i].statistics.allocationCount;
+		heap.BlockCount = budgets[i].statistics.blockCount;
+		heaps.push_back(heap);
+	}
+	return heaps;
+}
+
+VmaTotalStatistics egx::MemoryTelemetry::GetStatistics() const
+{
+	VmaTotalStatistics statistics{};
+	vmaCalculateStatistics(m_Ctx->Allocator, &statistics);
+	return statistics;
+}
+
+void egx::MemoryTelemetry::CheckBudget()
+{
+	auto heaps = GetHeapBudgets();
+	scoped_lock lock(m_Lock);
+	m_OverBudget.resize(heaps.size(), false);
+	for (auto& heap : heaps)
+	{
+		bool overBudget = heap.IsOverBudget();
+		if (overBudget && !m_OverBudget[heap.HeapIndex])
+		{
+			LOG(WARNING, "Memory heap {} ({}) is over budget, {} MB used of {} MB.", heap.HeapIndex, vk::to_string(heap.Flags),
+				heap.UsageBytes / (1024 * 1024), heap.BudgetBytes / (1024 * 1024));
+		}
+		m_OverBudget[heap.HeapIndex] = overBudget;
+	}
+}
+
+std::string egx::MemoryTelemetry::DumpJson(bool includeVmaDetails) const
+{
+	nlohmann::json root;
+
+	for (uint32_t i = 0; i < (uint32_t)MemoryCategory::Count; i++)
+	{
+		auto usage = GetCategoryUsage(MemoryCategory(i));
+		root["categories"][ToString(MemoryCategory(i))] = { {"bytes", usage.Bytes}, {"count", usage.Count} };
+	}
+
+	root["heaps"] = nlohmann::json::array();
+	for (auto& heap : GetHeapBudgets())
+	{
+		root["heaps"].push_back({
+			{"index", heap.HeapIndex},
+			{"flags", vk::to_string(heap.Flags)},
+			{"budget", heap.BudgetBytes},
+			{"usage", heap.UsageBytes},
+			{"allocationBytes", heap.AllocationBytes},
+			{"blockBytes", heap.BlockBytes},
+			{"allocationCount", heap.AllocationCount},
+			{"blockCount", heap.BlockCount},
+			{"overBudget", heap.IsOverBudget()} });
+	}
+
+	auto statistics = GetStatistics();
+	root["total"] = {
+		{"allocationBytes", statistics.total.statistics.allocationBytes},
+		{"blockBytes", statistics.total.statistics.blockBytes},
+		{"allocationCount", statistics.total.statistics.allocationCount},
+		{"blockCount", statistics.total.statistics.blockCount},
+		{"unusedRangeCount", statistics.total.unusedRangeCount},
+		{"allocationSizeMax", statistics.total.allocationSizeMax},
+		{"unusedRangeSizeMax", statistics.total.unusedRangeSizeMax} };
+
+	if (includeVmaDetails)
+	{
+		char* pStats = nullptr;
+		vmaBuildStatsString(m_Ctx->Allocator, &pStats, VK_TRUE);
+		root["vma"] = nlohmann::json::parse(pStats);
+		vmaFreeStatsString(m_Ctx->Allocator, pStats);
+	}
+	return root.dump(4);
+}
+
+void egx::MemoryTelemetry::SaveJson(const std::string& filePath, bool includeVmaDetails) const
+{
+	ofstream file(filePath);
+	if (!file)
+	{
+		throw runtime_error(cpp::Format("Could not open {} to save memory telemetry.", filePath));
+	}
+	file << DumpJson(includeVmaDetails);
+}
+
+void egx::MemoryTelemetry::DrawImGuiOverlay(bool* pOpen) const
+{
+	constexpr double MB = 1024.0 * 1024.0;
+	if (!ImGui::Begin("GPU Memory", pOpen))
+	{
+		ImGui::End();
+		return;
+	}
+
+	for (auto& heap : GetHeapBudgets())
+	{
+		float fraction = heap.BudgetBytes > 0 ? float(double(heap.UsageBytes) / double(heap.BudgetBytes)) : 0.0f;
+		char label[64];
+		snprintf(label, sizeof(label), "%.1f / %.1f MB", heap.UsageBytes / MB, heap.BudgetBytes / MB);
+		ImGui::Text("Heap %u %s", heap.HeapIndex, heap.Flags & vk::MemoryHeapFlagBits::eDeviceLocal ? "(device local)" : "");
+		if (heap.IsOverBudget())
+			ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.9f, 0.2f, 0.2f, 1.0f));
+		ImGui::ProgressBar(fraction, ImVec2(-1, 0), label);
+		if (heap.IsOverBudget())
+			ImGui::PopStyleColor();
+		ImGui::Text("  %u allocations in %u blocks (%.1f MB used of %.1f MB)", heap.AllocationCount, heap.BlockCount,
+			heap.AllocationBytes / MB, heap.BlockBytes / MB);
+	}
+
+	ImGui::Separator();
+	for (uint32_t i = 0; i < (uint32_t)MemoryCategory::Count; i++)
+	{
+		auto usage = GetCategoryUsage(MemoryCategory(i));
+		ImGui::Text("%-14s %8.2f MB  (%u)", ToString(MemoryCategory(i)), usage.Bytes / MB, usage.Count);
+	}
+	ImGui::End();
+}
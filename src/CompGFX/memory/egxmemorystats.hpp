@@ -0,0 +1,89 @@
+#pragma once
+#include <core/egx.hpp>
+#include <array>
+#include <mutex>
+#include <unordered_map>
+
+namespace egx
+{
+
+	enum class MemoryCategory : uint32_t
+	{
+		Mesh,
+		Texture,
+		Staging,
+		RenderTarget,
+		FrameResource,
+		Other,
+		Count
+	};
+
+	const char* ToString(MemoryCategory category);
+
+	struct MemoryCategoryUsage
+	{
+		vk::DeviceSize Bytes = 0;
+		uint32_t Count = 0;
+	};
+
+	struct MemoryHeapBudget
+	{
+		uint32_t HeapIndex;
+		vk::MemoryHeapFlags Flags;
+		// Estimated by the driver (VK_EXT_memory_budget) or by VMA when the extension is not available
+		vk::DeviceSize BudgetBytes;
+		vk::DeviceSize UsageBytes;
+		// Memory allocated through VMA, BlockBytes are the vkAllocateMemory blocks the allocations live in
+		vk::DeviceSize AllocationBytes;
+		vk::DeviceSize BlockBytes;
+		uint32_t AllocationCount;
+		uint32_t BlockCount;
+
+		bool IsOverBudget() const { return UsageBytes > BudgetBytes; }
+	};
+
+	/// <summary>
+	/// Tracks the device memory owned by the engine's resources per category and exposes the
+	/// VMA budget of each heap. Resources register themselves at creation (see Buffer::SetCategory
+	/// and Image2D::SetCategory to override the inferred category).
+	/// </summary>
+	class MemoryTelemetry
+	{
+	public:
+		MemoryTelemetry(DeviceContext* pCtx) : m_Ctx(pCtx) {}
+		MemoryTelemetry(MemoryTelemetry&) = delete;
+
+		void Register(const void* owner, MemoryCategory category, vk::DeviceSize size);
+		void Update(const void* owner, vk::DeviceSize size);
+		void SetCategory(const void* owner, MemoryCategory category);
+		void Unregister(const void* owner);
+
+		MemoryCategoryUsage GetCategoryUsage(MemoryCategory category) const;
+		std::vector<MemoryHeapBudget> GetHeapBudgets() const;
+		VmaTotalStatistics GetStatistics() const;
+
+		/// <summary>
+		/// Logs a warning the first time a heap exceeds its budget, called by DeviceContext::NextFrame().
+		/// </summary>
+		void CheckBudget();
+
+		std::string DumpJson(bool includeVmaDetails = false) const;
+		void SaveJson(const std::string& filePath, bool includeVmaDetails = false) const;
+
+		void DrawImGuiOverlay(bool* pOpen = nullptr) const;
+
+	private:
+		struct Entry
+		{
+			MemoryCategory Category;
+			vk::DeviceSize Size;
+		};
+
+		DeviceContext* m_Ctx;
+		std::unordered_map<const void*, Entry> m_Entries;
+		std::array<MemoryCategoryUsage, (size_t)MemoryCategory::Count> m_Usage{};
+		std::vector<bool> m_OverBudget;
+		mutable std::mutex m_Lock;
+	};
+
+}
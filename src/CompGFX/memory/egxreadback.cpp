@@ -0,0 +1,206 @@
+#include "egxreadback.hpp"
+#include <core/QueueSubmitter.hpp>
+
+using namespace egx;
+using namespace std;
+
+ReadbackHandle egx::ReadbackHandle::FromData(vector<uint8_t> data)
+{
+	ReadbackHandle handle;
+	handle.m_Request = make_shared<Request>();
+	handle.m_Request->Size = data.size();
+	handle.m_Request->Data = std::move(data);
+	handle.m_Request->Resolved = true;
+	return handle;
+}
+
+bool egx::ReadbackHandle::IsReady() const
+{
+	if (!m_Request)
+		return false;
+	if (m_Request->Resolved || !m_Queue)
+		return m_Request->Resolved;
+	return m_Queue->_IsReady(m_Request);
+}
+
+void egx::ReadbackHandle::Wait() const
+{
+	if (!m_Request)
+	{
+		throw runtime_error("Cannot wait on a null readback handle.");
+	}
+	if (!m_Request->Resolved && m_Queue)
+		m_Queue->_Wait(m_Request);
+}
+
+const vector<uint8_t>& egx::ReadbackHandle::Get() const
+{
+	Wait();
+	return m_Request->Data;
+}
+
+egx::ReadbackQueue::ReadbackQueue(DeviceContext* pCtx) : m_Ctx(pCtx)
+{
+	auto poolInfo = vk::CommandPoolCreateInfo()
+		.setFlags(vk::CommandPoolCreateFlagBits::eTransient | vk::CommandPoolCreateFlagBits::eResetCommandBuffer)
+		.setQueueFamilyIndex(pCtx->GraphicsQueueFamilyIndex);
+	m_Pool = pCtx->Device.createCommandPool(poolInfo);
+}
+
+egx::ReadbackQueue::~ReadbackQueue()
+{
+	Submit();
+	vector<shared_ptr<Request>> resolved;
+	for (auto& submission : m_InFlight)
+	{
+		m_Ctx->Submitter->WaitForFences({ submission.Fence });
+		_Retire(submission, resolved);
+		m_Ctx->Device.destroyFence(submission.Fence);
+	}
+	_RunCallbacks(resolved);
+	for (auto& submission : m_Free)
+		m_Ctx->Device.destroyFence(submission.Fence);
+	m_Ctx->Device.destroyCommandPool(m_Pool);
+}
+
+ReadbackHandle egx::ReadbackQueue::Record(vk::DeviceSize size, const RecordCallback& record, ReadyCallback onReady)
+{
+	scoped_lock lock(m_Lock);
+	auto request = make_shared<Request>();
+	request->Block = m_Ctx->StagingBlocks->Acquire(size, true);
+	request->Size = size;
+	request->Record = record;
+	request->OnReady = std::move(onReady);
+	m_Recording.Requests.push_back(request);
+
+	ReadbackHandle handle;
+	handle.m_Queue = this;
+	handle.m_Request = request;
+	return handle;
+}
+
+void egx::ReadbackQueue::Submit()
+{
+	scoped_lock lock(m_Lock);
+	if (m_Recording.Requests.empty())
+		return;
+	if (m_Free.size() > 0)
+	{
+		m_Recording.Cmd = m_Free.back().Cmd;
+		m_Recording.Fence = m_Free.back().Fence;
+		m_Free.pop_back();
+	}
+	else
+	{
+		m_Recording.Cmd = m_Ctx->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(m_Pool, vk::CommandBufferLevel::ePrimary, 1))[0];
+		m_Recording.Fence = m_Ctx->Device.createFence({});
+	}
+
+	// Recorded now rather than in Record(), the frame's work has been recorded and the layouts it left are known
+	auto cmd = m_Recording.Cmd;
+	cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	// Everything submitted before (the frame's rendering) must be done writing
+	vk::MemoryBarrier readBarrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferRead);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, {}, readBarrier, {}, {});
+	for (auto& request : m_Recording.Requests)
+	{
+		request->Record(cmd, request->Block.Buffer);
+		request->Record = {};
+	}
+	vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eHostRead);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, {}, barrier, {}, {});
+	cmd.end();
+
+	// Pending uploads must execute before the copies
+	m_Ctx->FlushUploads();
+	m_Ctx->Submitter->Enqueue(QueueType::Graphics, { cmd }, {}, {}, m_Recording.Fence);
+	for (auto& request : m_Recording.Requests)
+		request->Fence = m_Recording.Fence;
+	m_InFlight.push_back(std::move(m_Recording));
+	m_Recording = {};
+}
+
+void egx::ReadbackQueue::Poll()
+{
+	vector<shared_ptr<Request>> resolved;
+	{
+		scoped_lock lock(m_Lock);
+		_Poll(resolved);
+	}
+	_RunCallbacks(resolved);
+}
+
+void egx::ReadbackQueue::_Poll(vector<shared_ptr<Request>>& resolved)
+{
+	erase_if(m_InFlight, [&](Submission& submission) {
+		if (m_Ctx->Device.getFenceStatus(submission.Fence) != vk::Result::eSuccess)
+			return false;
+		_Retire(submission, resolved);
+		m_Free.push_back(std::move(submission));
+		return true;
+	});
+}
+
+void egx::ReadbackQueue::_Resolve(Request& request)
+{
+	vmaInvalidateAllocation(m_Ctx->Allocator, request.Block.Allocation, 0, request.Size);
+	request.Data.assign(request.Block.Mapped, request.Block.Mapped + request.Size);
+	m_Ctx->StagingBlocks->Release(request.Block);
+	request.Block = {};
+	request.Fence = nullptr;
+	request.Resolved = true;
+}
+
+void egx::ReadbackQueue::_Retire(Submission& submission, vector<shared_ptr<Request>>& resolved)
+{
+	for (auto& request : submission.Requests)
+	{
+		if (request->Resolved)
+			continue;
+		_Resolve(*request);
+		resolved.push_back(request);
+	}
+	submission.Requests.clear();
+	m_Ctx->Device.resetFences(submission.Fence);
+	submission.Cmd.reset();
+}
+
+void egx::ReadbackQueue::_Wait(const shared_ptr<Request>& request)
+{
+	vector<shared_ptr<Request>> resolved;
+	{
+		scoped_lock lock(m_Lock);
+		if (request->Resolved)
+			return;
+		if (!request->Fence)
+			Submit();
+		m_Ctx->Submitter->WaitForFences({ request->Fence });
+		// Retires the whole submission, other readbacks of the same frame resolve together
+		_Poll(resolved);
+	}
+	_RunCallbacks(resolved);
+}
+
+bool egx::ReadbackQueue::_IsReady(const shared_ptr<Request>& request)
+{
+	vector<shared_ptr<Request>> resolved;
+	bool ready;
+	{
+		scoped_lock lock(m_Lock);
+		if (!request->Resolved && request->Fence && m_Ctx->Device.getFenceStatus(request->Fence) == vk::Result::eSuccess)
+			_Poll(resolved);
+		ready = request->Resolved;
+	}
+	_RunCallbacks(resolved);
+	return ready;
+}
+
+void egx::ReadbackQueue::_RunCallbacks(const vector<shared_ptr<Request>>& resolved)
+{
+	// Called without m_Lock, the callbacks may record or poll readbacks
+	for (auto& request : resolved)
+	{
+		if (request->OnReady)
+			request->OnReady(request->Data);
+	}
+}
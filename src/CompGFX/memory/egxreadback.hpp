@@ -0,0 +1,122 @@
+#pragma once
+#include <core/egx.hpp>
+#include "egxstagingpool.hpp"
+#include <functional>
+#include <mutex>
+#include <atomic>
+
+namespace egx
+{
+
+	class ReadbackQueue;
+
+	/// <summary>
+	/// Future like result of an asynchronous readback. Copies of the handle share the same request.
+	/// </summary>
+	class ReadbackHandle
+	{
+	public:
+		ReadbackHandle() = default;
+
+		/// <summary>
+		/// A handle whose data is already available (e.g. reads from host visible memory).
+		/// </summary>
+		static ReadbackHandle FromData(std::vector<uint8_t> data);
+
+		bool IsNull() const { return m_Request == nullptr; }
+		/// <summary>
+		/// Non blocking, true once the copy retired.
+		/// </summary>
+		bool IsReady() const;
+		/// <summary>
+		/// Blocks until the copy retired, submits it first when it is still being recorded.
+		/// </summary>
+		void Wait() const;
+		/// <summary>
+		/// Waits and returns the read bytes.
+		/// </summary>
+		const std::vector<uint8_t>& Get() const;
+
+	private:
+		friend class ReadbackQueue;
+
+		struct Request
+		{
+			StagingBlock Block;
+			vk::DeviceSize Size = 0;
+			// Records the copy when the queue is submitted, released afterwards
+			std::function<void(vk::CommandBuffer cmd, vk::Buffer dst)> Record;
+			// Null until the copy was submitted
+			vk::Fence Fence;
+			// Read by IsReady()/Wait() without the queue's lock
+			std::atomic<bool> Resolved = false;
+			std::vector<uint8_t> Data;
+			std::function<void(const std::vector<uint8_t>& data)> OnReady;
+		};
+
+		ReadbackQueue* m_Queue = nullptr;
+		std::shared_ptr<Request> m_Request;
+	};
+
+	/// <summary>
+	/// Records GPU to host copies into a command buffer that is submitted by DeviceContext::NextFrame()
+	/// after the frame's work, so the copies observe everything the frame rendered. The copies are only recorded
+	/// by Submit(), they see the resource state (e.g. image layouts) the frame's work left behind. Each readback borrows
+	/// a host cached block from the StagingPool, the data is copied out and the block returned once the
+	/// submission's fence signaled. Retired readbacks are resolved (and their callbacks run) by Poll().
+	/// </summary>
+	class ReadbackQueue
+	{
+	public:
+		using RecordCallback = std::function<void(vk::CommandBuffer cmd, vk::Buffer dst)>;
+		using ReadyCallback = std::function<void(const std::vector<uint8_t>& data)>;
+
+		ReadbackQueue(DeviceContext* pCtx);
+		ReadbackQueue(ReadbackQueue&) = delete;
+		~ReadbackQueue();
+
+		/// <summary>
+		/// Queues a copy of size bytes into dst (offset 0), onReady runs once the data arrived. record runs
+		/// in Submit() and must capture what it uses by value.
+		/// </summary>
+		ReadbackHandle Record(vk::DeviceSize size, const RecordCallback& record, ReadyCallback onReady = {});
+
+		/// <summary>
+		/// Submits the copies recorded so far (after the pending uploads).
+		/// </summary>
+		void Submit();
+		/// <summary>
+		/// Resolves the readbacks whose submission retired, never blocks. Their callbacks run after the queue's lock
+		/// was released, so they may record new readbacks.
+		/// </summary>
+		void Poll();
+
+	private:
+		friend class ReadbackHandle;
+		using Request = ReadbackHandle::Request;
+
+		struct Submission
+		{
+			vk::CommandBuffer Cmd;
+			vk::Fence Fence;
+			std::vector<std::shared_ptr<Request>> Requests;
+		};
+
+		// _Poll, _Resolve and _Retire are called with m_Lock held, resolved collects the requests whose callbacks are due
+		void _Poll(std::vector<std::shared_ptr<Request>>& resolved);
+		void _Resolve(Request& request);
+		void _Retire(Submission& submission, std::vector<std::shared_ptr<Request>>& resolved);
+		void _RunCallbacks(const std::vector<std::shared_ptr<Request>>& resolved);
+		void _Wait(const std::shared_ptr<Request>& request);
+		bool _IsReady(const std::shared_ptr<Request>& request);
+
+	private:
+		DeviceContext* m_Ctx;
+		vk::CommandPool m_Pool;
+		Submission m_Recording;
+		std::vector<Submission> m_InFlight;
+		std::vector<Submission> m_Free;
+		std::recursive_mutex m_Lock;
+	};
+
+}
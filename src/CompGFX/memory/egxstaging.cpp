@@ -0,0 +1,203 @@
+#include "egxstaging.hpp"
+#include "egxmemorystats.hpp"
+#include "egxstagingpool.hpp"
+#include <core/QueueSubmitter.hpp>
+
+using namespace egx;
+using namespace std;
+
+static vk::DeviceSize AlignUp(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+	if (alignment <= 1)
+		return value;
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+egx::StagingRing::StagingRing(DeviceContext* pCtx, vk::DeviceSize capacityPerFrame) : m_Ctx(pCtx)
+{
+	m_Slots.resize(pCtx->FramesInFlight);
+	for (auto& slot : m_Slots)
+	{
+		auto poolInfo = vk::CommandPoolCreateInfo()
+			.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+			.setQueueFamilyIndex(pCtx->GraphicsQueueFamilyIndex);
+		slot.Pool = pCtx->Device.createCommandPool(poolInfo);
+		_CreateBlock(slot, capacityPerFrame);
+	}
+}
+
+egx::StagingRing::~StagingRing()
+{
+	for (auto& slot : m_Slots)
+	{
+		for (uint32_t i = 0; i < slot.SubmittedCount; i++)
+			m_Ctx->Submitter->WaitForFences({ slot.Submissions[i].Fence });
+		for (auto& submission : slot.Submissions)
+			m_Ctx->Device.destroyFence(submission.Fence);
+		m_Ctx->Device.destroyCommandPool(slot.Pool);
+		for (auto& block : slot.Borrowed)
+			m_Ctx->StagingBlocks->Release(block);
+		_DestroyBlock(slot);
+	}
+}
+
+void egx::StagingRing::Upload(vk::Buffer dst, vk::DeviceSize dstOffset, const void* pData, vk::DeviceSize size)
+{
+	Stage(pData, size, 4, [&](vk::CommandBuffer cmd, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset) {
+		cmd.copyBuffer(stagingBuffer, dst, vk::BufferCopy(stagingOffset, dstOffset, size));
+	});
+}
+
+void egx::StagingRing::Stage(const void* pData, vk::DeviceSize size, vk::DeviceSize alignment, const RecordCallback& record)
+{
+	if (size == 0)
+		return;
+	scoped_lock lock(m_Lock);
+	Slot& slot = _AcquireSlot();
+
+	// Large uploads borrow a block from the staging pool instead of growing (or cycling) the ring
+	if (size > slot.Capacity / 4)
+	{
+		StagingBlock block = m_Ctx->StagingBlocks->Acquire(size);
+		memcpy(block.Mapped, pData, size);
+		vmaFlushAllocation(m_Ctx->Allocator, block.Allocation, 0, size);
+		slot.Borrowed.push_back(block);
+		record(_BeginRecording(slot), block.Buffer, 0);
+		return;
+	}
+
+	vk::DeviceSize offset = AlignUp(slot.Head, alignment);
+	if (offset + size > slot.Capacity)
+	{
+		_Recycle(slot);
+		offset = 0;
+	}
+
+	memcpy(slot.Mapped + offset, pData, size);
+	vmaFlushAllocation(m_Ctx->Allocator, slot.Allocation, offset, size);
+	slot.Head = offset + size;
+
+	record(_BeginRecording(slot), slot.Buffer, offset);
+}
+
+void egx::StagingRing::Record(const std::function<void(vk::CommandBuffer cmd)>& record)
+{
+	scoped_lock lock(m_Lock);
+	record(_BeginRecording(_AcquireSlot()));
+}
+
+void egx::StagingRing::FlushUploads()
+{
+	scoped_lock lock(m_Lock);
+	if (m_ActiveSlot == UINT32_MAX)
+		return;
+	Slot& slot = m_Slots[m_ActiveSlot];
+	if (slot.Recording)
+		_Submit(slot);
+}
+
+bool egx::StagingRing::HasPendingUploads() const
+{
+	scoped_lock lock(m_Lock);
+	return m_ActiveSlot != UINT32_MAX && m_Slots[m_ActiveSlot].Recording;
+}
+
+StagingRing::Slot& egx::StagingRing::_AcquireSlot()
+{
+	uint32_t frame = m_Ctx->CurrentFrame;
+	if (m_Ctx->FrameCount == m_ActiveFrameCount)
+		return m_Slots[frame];
+
+	// Uploads recorded during the previous frame must reach the queue before we move on
+	if (m_ActiveSlot != UINT32_MAX && m_Slots[m_ActiveSlot].Recording)
+		_Submit(m_Slots[m_ActiveSlot]);
+
+	m_ActiveSlot = frame;
+	m_ActiveFrameCount = m_Ctx->FrameCount;
+	Slot& slot = m_Slots[frame];
+	_Recycle(slot);
+	return slot;
+}
+
+void egx::StagingRing::_Recycle(Slot& slot)
+{
+	if (slot.Recording)
+		_Submit(slot);
+	if (slot.SubmittedCount > 0)
+	{
+		vector<vk::Fence> fences;
+		for (uint32_t i = 0; i < slot.SubmittedCount; i++)
+			fences.push_back(slot.Submissions[i].Fence);
+		// In steady state these fences retired FramesInFlight frames ago, so this does not block.
+		m_Ctx->Submitter->WaitForFences(fences);
+		m_Ctx->Device.resetFences(fences);
+		m_Ctx->Device.resetCommandPool(slot.Pool);
+	}
+	for (auto& block : slot.Borrowed)
+		m_Ctx->StagingBlocks->Release(block);
+	slot.Borrowed.clear();
+	slot.SubmittedCount = 0;
+	slot.Head = 0;
+}
+
+void egx::StagingRing::_Submit(Slot& slot)
+{
+	vk::CommandBuffer cmd = slot.Recording;
+	// Make the transfer writes visible to everything submitted after this batch on the same queue.
+	vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+	cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, {}, barrier, {}, {});
+	cmd.end();
+	// Enqueued so the uploads stay ordered before the work enqueued after them
+	m_Ctx->Submitter->Enqueue(QueueType::Graphics, { cmd }, {}, {}, slot.Submissions[slot.SubmittedCount].Fence);
+	slot.SubmittedCount++;
+	slot.Recording = nullptr;
+}
+
+vk::CommandBuffer egx::StagingRing::_BeginRecording(Slot& slot)
+{
+	if (slot.Recording)
+		return slot.Recording;
+	if (slot.SubmittedCount == slot.Submissions.size())
+	{
+		Submission submission;
+		submission.Cmd = m_Ctx->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(slot.Pool, vk::CommandBufferLevel::ePrimary, 1))[0];
+		submission.Fence = m_Ctx->Device.createFence({});
+		slot.Submissions.push_back(submission);
+	}
+	slot.Recording = slot.Submissions[slot.SubmittedCount].Cmd;
+	slot.Recording.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+	return slot.Recording;
+}
+
+void egx::StagingRing::_CreateBlock(Slot& slot, vk::DeviceSize capacity)
+{
+	VkBufferCreateInfo createInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	createInfo.size = capacity;
+	createInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VmaAllocationCreateInfo allocCreateInfo{};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+	allocCreateInfo.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	VmaAllocationInfo allocationInfo{};
+	VkResult result = vmaCreateBuffer(m_Ctx->Allocator, &createInfo, &allocCreateInfo, &slot.Buffer, &slot.Allocation, &allocationInfo);
+	if (result != VK_SUCCESS)
+	{
+		throw runtime_error(cpp::Format("Could not create staging ring block with {} bytes, error code {}", capacity, vk::to_string(vk::Result(result))));
+	}
+	slot.Mapped = (uint8_t*)allocationInfo.pMappedData;
+	slot.Capacity = capacity;
+	slot.Head = 0;
+	m_Ctx->Telemetry->Register(&slot, MemoryCategory::Staging, capacity);
+}
+
+void egx::StagingRing::_DestroyBlock(Slot& slot)
+{
+	if (slot.Buffer)
+	{
+		m_Ctx->Telemetry->Unregister(&slot);
+		vmaDestroyBuffer(m_Ctx->Allocator, slot.Buffer, slot.Allocation);
+	}
+	slot.Buffer = nullptr, slot.Allocation = nullptr, slot.Mapped = nullptr;
+	slot.Capacity = 0;
+}
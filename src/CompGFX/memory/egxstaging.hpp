@@ -0,0 +1,87 @@
+#pragma once
+#include <core/egx.hpp>
+#include "egxstagingpool.hpp"
+#include <functional>
+#include <mutex>
+
+namespace egx
+{
+
+	/// <summary>
+	/// Device owned upload ring, one host visible block per frame in flight.
+	/// Uploads are sub-allocated from the current frame's block and their copies
+	/// are recorded into a shared transfer command buffer which is submitted once
+	/// by FlushUploads() (DeviceContext flushes before engine submits and on NextFrame()).
+	/// A frame's block is only recycled after the fences of its previous submits retire.
+	/// Uploads larger than a quarter of a block are staged in a StagingPool block held until the slot recycles.
+	/// </summary>
+	class StagingRing
+	{
+	public:
+		using RecordCallback = std::function<void(vk::CommandBuffer cmd, vk::Buffer stagingBuffer, vk::DeviceSize stagingOffset)>;
+
+		static constexpr vk::DeviceSize DefaultCapacity = 16ull * 1024ull * 1024ull;
+
+		StagingRing(DeviceContext* pCtx, vk::DeviceSize capacityPerFrame = DefaultCapacity);
+		StagingRing(StagingRing&) = delete;
+		~StagingRing();
+
+		/// <summary>
+		/// Copies pData into the ring and records a copy into dst.
+		/// The data is visible to any work submitted after the next FlushUploads().
+		/// </summary>
+		void Upload(vk::Buffer dst, vk::DeviceSize dstOffset, const void* pData, vk::DeviceSize size);
+
+		/// <summary>
+		/// Copies pData into the ring and lets the caller record the transfer commands
+		/// that consume it (e.g. buffer to image copies with layout transitions).
+		/// </summary>
+		void Stage(const void* pData, vk::DeviceSize size, vk::DeviceSize alignment, const RecordCallback& record);
+
+		/// <summary>
+		/// Records GPU only work (e.g. buffer to buffer copies) into the frame's upload batch.
+		/// </summary>
+		void Record(const std::function<void(vk::CommandBuffer cmd)>& record);
+
+		void FlushUploads();
+		bool HasPendingUploads() const;
+
+	private:
+		struct Submission
+		{
+			vk::CommandBuffer Cmd;
+			vk::Fence Fence;
+		};
+
+		struct Slot
+		{
+			VkBuffer Buffer = nullptr;
+			VmaAllocation Allocation = nullptr;
+			uint8_t* Mapped = nullptr;
+			vk::DeviceSize Capacity = 0;
+			vk::DeviceSize Head = 0;
+			vk::CommandPool Pool;
+			std::vector<Submission> Submissions;
+			// Number of entries in Submissions that were submitted since the slot was recycled
+			uint32_t SubmittedCount = 0;
+			vk::CommandBuffer Recording = nullptr;
+			// Staging pool blocks used by uploads larger than a quarter of the slot
+			std::vector<StagingBlock> Borrowed;
+		};
+
+		Slot& _AcquireSlot();
+		void _Recycle(Slot& slot);
+		void _Submit(Slot& slot);
+		vk::CommandBuffer _BeginRecording(Slot& slot);
+		void _CreateBlock(Slot& slot, vk::DeviceSize capacity);
+		void _DestroyBlock(Slot& slot);
+
+	private:
+		DeviceContext* m_Ctx;
+		std::vector<Slot> m_Slots;
+		uint32_t m_ActiveSlot = UINT32_MAX;
+		uint64_t m_ActiveFrameCount = UINT64_MAX;
+		mutable std::mutex m_Lock;
+	};
+
+}
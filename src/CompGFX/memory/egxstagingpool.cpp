@@ -0,0 +1,107 @@
+#include "egxstagingpool.hpp"
+#include "egxmemorystats.hpp"
+
+using namespace egx;
+using namespace std;
+
+egx::StagingPool::StagingPool(DeviceContext* pCtx) : m_Ctx(pCtx)
+{
+}
+
+egx::StagingPool::~StagingPool()
+{
+	for (auto& [sizeClass, blocks] : m_FreeBlocks)
+	{
+		for (auto& free : blocks)
+			_DestroyBlock(free.Block);
+	}
+}
+
+StagingBlock egx::StagingPool::Acquire(vk::DeviceSize size, bool readback)
+{
+	vk::DeviceSize sizeClass = MinBlockSize;
+	while (sizeClass < size)
+		sizeClass *= 2;
+
+	{
+		scoped_lock lock(m_Lock);
+		auto& blocks = m_FreeBlocks[{ readback, sizeClass }];
+		if (blocks.size() > 0)
+		{
+			StagingBlock block = blocks.back().Block;
+			blocks.pop_back();
+			return block;
+		}
+	}
+	return _CreateBlock(sizeClass, readback);
+}
+
+void egx::StagingPool::Release(const StagingBlock& block)
+{
+	if (!block.Buffer)
+		return;
+	scoped_lock lock(m_Lock);
+	m_FreeBlocks[{ block.Readback, block.Size }].push_back({ block, m_Ctx->FrameCount });
+}
+
+void egx::StagingPool::Collect()
+{
+	scoped_lock lock(m_Lock);
+	for (auto& [sizeClass, blocks] : m_FreeBlocks)
+	{
+		erase_if(blocks, [&](const FreeBlock& free) {
+			if (m_Ctx->FrameCount - free.LastUsedFrame < IdleFrameLimit)
+				return false;
+			_DestroyBlock(free.Block);
+			return true;
+		});
+	}
+}
+
+vk::DeviceSize egx::StagingPool::CachedBytes() const
+{
+	scoped_lock lock(m_Lock);
+	vk::DeviceSize bytes = 0;
+	for (auto& [sizeClass, blocks] : m_FreeBlocks)
+		bytes += sizeClass.second * blocks.size();
+	return bytes;
+}
+
+StagingBlock egx::StagingPool::_CreateBlock(vk::DeviceSize size, bool readback)
+{
+	VkBufferCreateInfo createInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	createInfo.size = size;
+	createInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VmaAllocationCreateInfo allocCreateInfo{};
+	allocCreateInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+	allocCreateInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	if (readback)
+	{
+		allocCreateInfo.flags |= VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
+		allocCreateInfo.preferredFlags = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+	}
+	else
+	{
+		allocCreateInfo.flags |= VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+	}
+
+	StagingBlock block;
+	VmaAllocationInfo allocationInfo{};
+	VkResult result = vmaCreateBuffer(m_Ctx->Allocator, &createInfo, &allocCreateInfo, &block.Buffer, &block.Allocation, &allocationInfo);
+	if (result != VK_SUCCESS)
+	{
+		throw runtime_error(cpp::Format("Could not create staging block with {} bytes, error code {}", size, vk::to_string(vk::Result(result))));
+	}
+	block.Mapped = (uint8_t*)allocationInfo.pMappedData;
+	block.Size = size;
+	block.Readback = readback;
+	m_Ctx->Telemetry->Register(block.Allocation, MemoryCategory::Staging, size);
+	return block;
+}
+
+void egx::StagingPool::_DestroyBlock(const StagingBlock& block)
+{
+	m_Ctx->Telemetry->Unregister(block.Allocation);
+	vmaDestroyBuffer(m_Ctx->Allocator, block.Buffer, block.Allocation);
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <core/egx.hpp>
+#include <map>
+#include <mutex>
+
+namespace egx
+{
+
+	struct StagingBlock
+	{
+		VkBuffer Buffer = nullptr;
+		VmaAllocation Allocation = nullptr;
+		uint8_t* Mapped = nullptr;
+		vk::DeviceSize Size = 0;
+		bool Readback = false;
+	};
+
+	/// <summary>
+	/// Device owned pool of persistently mapped host buffers for transfers that do not fit the staging ring
+	/// (large image uploads) and for readbacks. Blocks are size classed (powers of two) and only held
+	/// while a transfer is in flight, released blocks are reused by later transfers of the same class
+	/// and destroyed by Collect() after IdleFrameLimit frames without use.
+	/// </summary>
+	class StagingPool
+	{
+	public:
+		static constexpr vk::DeviceSize MinBlockSize = 64ull * 1024ull;
+		static constexpr uint64_t IdleFrameLimit = 120;
+
+		StagingPool(DeviceContext* pCtx);
+		StagingPool(StagingPool&) = delete;
+		~StagingPool();
+
+		/// <summary>
+		/// Returns a block of at least size bytes, readback blocks are host cached for CPU reads.
+		/// </summary>
+		StagingBlock Acquire(vk::DeviceSize size, bool readback = false);
+		/// <summary>
+		/// Returns the block to the pool, the GPU must be done with it.
+		/// </summary>
+		void Release(const StagingBlock& block);
+		/// <summary>
+		/// Destroys the blocks that were not used for IdleFrameLimit frames, called from DeviceContext::NextFrame().
+		/// </summary>
+		void Collect();
+
+		vk::DeviceSize CachedBytes() const;
+
+	private:
+		StagingBlock _CreateBlock(vk::DeviceSize size, bool readback);
+		void _DestroyBlock(const StagingBlock& block);
+
+	private:
+		struct FreeBlock
+		{
+			StagingBlock Block;
+			uint64_t LastUsedFrame = 0;
+		};
+
+		DeviceContext* m_Ctx;
+		// [(readback, size class), free blocks]
+		std::map<std::pair<bool, vk::DeviceSize>, std::vector<FreeBlock>> m_FreeBlocks;
+		mutable std::mutex m_Lock;
+	};
+
+}
@@ -4,6 +4,7 @@
 #include <assimp/scene.h>
 #include <stdexcept>
 #include <Utility/CppUtility.hpp>
+#include <ext/ZoneProfiler.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 using namespace egx;
@@ -12,6 +13,7 @@ using namespace glm;
 
 MeshContainer& egx::MeshContainer::Load(const std::string& file, IndicesType type, const std::vector<VertexDataOrder>& vertexDataOrder)
 {
+	EGX_ZONE("MeshContainer::Load");
 	Assimp::Importer importer;
 	auto scene = importer.ReadFile(file, aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_CalcTangentSpace);
 	if (!scene) {
@@ -167,6 +169,8 @@ MeshContainer& egx::BufferedMeshContainer::Load(const std::string& file, Indices
 			m_Data->m_IndexBuffers.push_back(indexBuffer);
 		}
 	}
+	// Every mesh of the model goes to the GPU in a single submit
+	m_Data->m_Ctx->FlushUploads();
 
 	return *this;
 }
@@ -2,6 +2,8 @@
 #include <backends/imgui_impl_glfw.h>
 #include <backends/imgui_impl_vulkan.h>
 #include <core/CommandBuffer.hpp>
+#include <core/DeletionQueue.hpp>
+#include "PersistentPipelineCache.hpp"
 
 using namespace std;
 using namespace egx;
@@ -25,7 +27,7 @@ egx::DearImGuiController::DearImGuiController(const DeviceCtx& ctx, GLFWwindow*
 	init_info.Device = ctx->Device;
 	init_info.QueueFamily = ctx->GraphicsQueueFamilyIndex;
 	init_info.Queue = ctx->Queue;
-	init_info.PipelineCache = NULL;
+	init_info.PipelineCache = ctx->PipelineCache->GetHandle();
 	init_info.DescriptorPool = m_Data->m_Pool;
 	init_info.Allocator = NULL;
 	init_info.MinImageCount = ctx->FramesInFlight;
@@ -93,6 +95,7 @@ DearImGuiController::DataWrapper::~DataWrapper()
 		ImGui_ImplVulkan_Shutdown();
 		ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext(m_ImGuiContext);
-		m_Ctx->Device.destroyDescriptorPool(m_Pool);
+		// The last frames drawn may still use descriptor sets from the pool
+		m_Ctx->Deletion->Push([device = m_Ctx->Device, pool = m_Pool] { device.destroyDescriptorPool(pool); });
 	}
 }
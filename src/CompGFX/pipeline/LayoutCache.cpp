@@ -0,0 +1,109 @@
+#include "LayoutCache.hpp"
+#include <core/DeletionQueue.hpp>
+#include <algorithm>
+
+using namespace egx;
+using namespace std;
+
+template <typename T>
+static void AppendKey(string& key, const T& value)
+{
+	key.append((const char*)&value, sizeof(T));
+}
+
+egx::LayoutCache::LayoutCache(DeviceContext* pCtx) : m_Ctx(pCtx)
+{
+}
+
+SharedDescriptorSetLayout egx::LayoutCache::GetDescriptorSetLayout(const vector<vk::DescriptorSetLayoutBinding>& bindings)
+{
+	auto sortedBindings = bindings;
+	sort(sortedBindings.begin(), sortedBindings.end(), [](auto& a, auto& b) { return a.binding < b.binding; });
+	// Immutable samplers are not used by the engine and are not part of the key
+	string key;
+	for (auto& binding : sortedBindings)
+	{
+		AppendKey(key, binding.binding);
+		AppendKey(key, binding.descriptorType);
+		AppendKey(key, binding.descriptorCount);
+		AppendKey(key, VkShaderStageFlags(binding.stageFlags));
+	}
+
+	scoped_lock lock(m_Lock);
+	if (auto setLayout = m_SetLayouts[key].lock())
+		return setLayout;
+
+	vk::DescriptorSetLayoutCreateInfo createInfo;
+	createInfo.setBindings(sortedBindings);
+	auto handle = m_Ctx->Device.createDescriptorSetLayout(createInfo);
+	SharedDescriptorSetLayout setLayout(new vk::DescriptorSetLayout(handle), [this, key](const vk::DescriptorSetLayout* setLayout) {
+		_Release(m_SetLayouts, key);
+		// Frames in flight may still allocate or bind with it
+		m_Ctx->Deletion->Push([device = m_Ctx->Device, handle = *setLayout] { device.destroyDescriptorSetLayout(handle); });
+		delete setLayout;
+	});
+	m_SetLayouts[key] = setLayout;
+	return setLayout;
+}
+
+SharedPipelineLayout egx::LayoutCache::GetPipelineLayout(const map<uint32_t, SharedDescriptorSetLayout>& setLayouts,
+	const vector<vk::PushConstantRange>& pushConstants)
+{
+	// Set layouts are deduplicated, equal handles mean equal layouts
+	string key;
+	for (auto& [setId, setLayout] : setLayouts)
+	{
+		AppendKey(key, setId);
+		AppendKey(key, VkDescriptorSetLayout(*setLayout));
+	}
+	AppendKey(key, uint32_t(pushConstants.size()));
+	for (auto& range : pushConstants)
+	{
+		AppendKey(key, VkShaderStageFlags(range.stageFlags));
+		AppendKey(key, range.offset);
+		AppendKey(key, range.size);
+	}
+
+	scoped_lock lock(m_Lock);
+	if (auto pipelineLayout = m_PipelineLayouts[key].lock())
+		return pipelineLayout;
+
+	auto data = make_unique<SharedPipelineLayoutData>();
+	data->SetLayouts = setLayouts;
+	vector<vk::DescriptorSetLayout> scalarSetLayouts;
+	for (auto& [setId, setLayout] : setLayouts)
+		scalarSetLayouts.push_back(*setLayout);
+	vk::PipelineLayoutCreateInfo createInfo;
+	createInfo.setSetLayouts(scalarSetLayouts).setPushConstantRanges(pushConstants);
+	data->Layout = m_Ctx->Device.createPipelineLayout(createInfo);
+
+	SharedPipelineLayout pipelineLayout(data.release(), [this, key](const SharedPipelineLayoutData* data) {
+		_Release(m_PipelineLayouts, key);
+		m_Ctx->Deletion->Push([device = m_Ctx->Device, handle = data->Layout] { device.destroyPipelineLayout(handle); });
+		// Releases the set layouts, must not hold m_Lock
+		delete data;
+	});
+	m_PipelineLayouts[key] = pipelineLayout;
+	return pipelineLayout;
+}
+
+size_t egx::LayoutCache::DescriptorSetLayoutCount() const
+{
+	scoped_lock lock(m_Lock);
+	return count_if(m_SetLayouts.begin(), m_SetLayouts.end(), [](auto& entry) { return !entry.second.expired(); });
+}
+
+size_t egx::LayoutCache::PipelineLayoutCount() const
+{
+	scoped_lock lock(m_Lock);
+	return count_if(m_PipelineLayouts.begin(), m_PipelineLayouts.end(), [](auto& entry) { return !entry.second.expired(); });
+}
+
+template <typename T>
+void egx::LayoutCache::_Release(unordered_map<string, weak_ptr<T>>& entries, const string& key)
+{
+	scoped_lock lock(m_Lock);
+	auto entry = entries.find(key);
+	if (entry != entries.end() && entry->second.expired())
+		entries.erase(entry);
+}
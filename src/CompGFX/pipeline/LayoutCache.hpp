@@ -0,0 +1,61 @@
+#pragma once
+#include <core/egx.hpp>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+namespace egx
+{
+
+	using SharedDescriptorSetLayout = std::shared_ptr<const vk::DescriptorSetLayout>;
+
+	struct SharedPipelineLayoutData
+	{
+		vk::PipelineLayout Layout;
+		// <SetId, DescriptorSetLayout>, kept alive by the pipeline layout
+		std::map<uint32_t, SharedDescriptorSetLayout> SetLayouts;
+
+		std::map<uint32_t, vk::DescriptorSetLayout> GetSetLayouts() const
+		{
+			std::map<uint32_t, vk::DescriptorSetLayout> setLayouts;
+			for (auto& [setId, setLayout] : SetLayouts)
+				setLayouts[setId] = *setLayout;
+			return setLayouts;
+		}
+	};
+
+	using SharedPipelineLayout = std::shared_ptr<const SharedPipelineLayoutData>;
+
+	/// <summary>
+	/// Device wide cache of descriptor set layouts and pipeline layouts (DeviceContext::Layouts). Identical binding
+	/// descriptions return the same vk::DescriptorSetLayout, identical set layouts and push constant ranges the same
+	/// vk::PipelineLayout, so pipelines built from matching shaders are layout compatible and descriptor sets bound
+	/// for one stay valid after binding the other. Layouts are reference counted and destroyed through the
+	/// DeletionQueue once the last pipeline using them is gone. Thread safe.
+	/// </summary>
+	class LayoutCache
+	{
+	public:
+		LayoutCache(DeviceContext* pCtx);
+		LayoutCache(LayoutCache&) = delete;
+
+		SharedDescriptorSetLayout GetDescriptorSetLayout(const std::vector<vk::DescriptorSetLayoutBinding>& bindings);
+		SharedPipelineLayout GetPipelineLayout(const std::map<uint32_t, SharedDescriptorSetLayout>& setLayouts,
+			const std::vector<vk::PushConstantRange>& pushConstants);
+
+		size_t DescriptorSetLayoutCount() const;
+		size_t PipelineLayoutCount() const;
+
+	private:
+		// Removes the entry unless it was already replaced by a new layout with the same key
+		template <typename T>
+		void _Release(std::unordered_map<std::string, std::weak_ptr<T>>& entries, const std::string& key);
+
+	private:
+		DeviceContext* m_Ctx;
+		std::unordered_map<std::string, std::weak_ptr<const vk::DescriptorSetLayout>> m_SetLayouts;
+		std::unordered_map<std::string, std::weak_ptr<const SharedPipelineLayoutData>> m_PipelineLayouts;
+		mutable std::mutex m_Lock;
+	};
+
+}
@@ -0,0 +1,134 @@
+#include "PersistentPipelineCache.hpp"
+#include <filesystem>
+#include <fstream>
+
+using namespace egx;
+using namespace std;
+
+string PersistentPipelineCache::m_CachingDirectory = "";
+
+void egx::PersistentPipelineCache::SetGlobalCacheDirectory(const string& directory)
+{
+	if (directory.length() > 0 && !filesystem::exists(directory)) {
+		if (!filesystem::create_directories(directory)) {
+			LOG(ERR, "Could not create directory {} for the pipeline cache.", directory);
+			return;
+		}
+	}
+	m_CachingDirectory = directory;
+}
+
+egx::PersistentPipelineCache::PersistentPipelineCache(DeviceContext* pCtx) : m_Ctx(pCtx)
+{
+	m_Properties = pCtx->PhysicalDeviceQuery.PhysicalDevice.getProperties();
+
+	vector<uint8_t> data;
+	if (m_CachingDirectory.length() > 0)
+	{
+		ifstream file(GetFilePath(), ios::binary);
+		if (file)
+			data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+		if (data.size() > 0 && !_IsCompatible(data))
+		{
+			LOG(INFO, "Pipeline cache {} belongs to another device or driver, starting with an empty cache.", GetFilePath());
+			data.clear();
+		}
+	}
+
+	auto result = pCtx->Device.createPipelineCache(vk::PipelineCacheCreateInfo({}, data.size(), data.data()), nullptr, &m_Cache);
+	if (result != vk::Result::eSuccess && data.size() > 0)
+	{
+		// The driver may still reject data it wrote itself
+		LOG(WARNING, "Could not create the pipeline cache from {}, Result={}", GetFilePath(), vk::to_string(result));
+		data.clear();
+		result = pCtx->Device.createPipelineCache(vk::PipelineCacheCreateInfo(), nullptr, &m_Cache);
+	}
+	if (result != vk::Result::eSuccess)
+	{
+		throw runtime_error(cpp::Format("Could not create the pipeline cache, Result={}", vk::to_string(result)));
+	}
+	m_Loaded = data.size() > 0;
+	m_SavedHash = _Hash(data);
+	m_LastSaveFrame = pCtx->FrameCount;
+}
+
+egx::PersistentPipelineCache::~PersistentPipelineCache()
+{
+	Save();
+	m_Ctx->Device.destroyPipelineCache(m_Cache);
+}
+
+string egx::PersistentPipelineCache::GetFilePath() const
+{
+	auto name = cpp::Format("{}-{}.pipeline-cache.bin", m_Properties.vendorID, m_Properties.deviceID);
+	return (filesystem::path(m_CachingDirectory) / name).string();
+}
+
+bool egx::PersistentPipelineCache::Save()
+{
+	if (m_CachingDirectory.length() == 0)
+		return true;
+	scoped_lock lock(m_Lock);
+	auto data = m_Ctx->Device.getPipelineCacheData(m_Cache);
+	auto hash = _Hash(data);
+	if (hash == m_SavedHash)
+		return true;
+
+	// Written next to the cache and renamed, a crash while saving leaves the previous file intact
+	string filePath = GetFilePath();
+	string temporaryPath = filePath + ".tmp";
+	{
+		ofstream file(temporaryPath, ios::binary | ios::trunc);
+		if (!file || !file.write((const char*)data.data(), data.size()))
+		{
+			LOG(WARNING, "Could not write the pipeline cache to {}.", temporaryPath);
+			return false;
+		}
+	}
+	error_code error;
+	filesystem::rename(temporaryPath, filePath, error);
+	if (error)
+	{
+		LOG(WARNING, "Could not replace the pipeline cache {}, {}", filePath, error.message());
+		return false;
+	}
+	m_SavedHash = hash;
+	return true;
+}
+
+void egx::PersistentPipelineCache::Tick()
+{
+	if (m_Ctx->FrameCount - m_LastSaveFrame < AutosaveFrames)
+		return;
+	m_LastSaveFrame = m_Ctx->FrameCount;
+	Save();
+}
+
+bool egx::PersistentPipelineCache::_IsCompatible(const vector<uint8_t>& data) const
+{
+	// VkPipelineCacheHeaderVersionOne
+	struct Header
+	{
+		uint32_t HeaderSize;
+		uint32_t HeaderVersion;
+		uint32_t VendorID;
+		uint32_t DeviceID;
+		uint8_t PipelineCacheUUID[VK_UUID_SIZE];
+	};
+	if (data.size() < sizeof(Header))
+		return false;
+	Header header;
+	memcpy(&header, data.data(), sizeof(Header));
+	return header.HeaderSize >= sizeof(Header) &&
+		header.HeaderVersion == uint32_t(vk::PipelineCacheHeaderVersion::eOne) &&
+		header.VendorID == m_Properties.vendorID &&
+		header.DeviceID == m_Properties.deviceID &&
+		memcmp(header.PipelineCacheUUID, m_Properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+}
+
+Sha256::Digest egx::PersistentPipelineCache::_Hash(const vector<uint8_t>& data)
+{
+	Sha256 sha;
+	sha.Update(data.data(), data.size());
+	return sha.Finalize();
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include <core/egx.hpp>
+#include <ext/Sha256.hpp>
+#include <mutex>
+
+namespace egx
+{
+
+	/// <summary>
+	/// Device wide vk::PipelineCache used by every pipeline creation path (DeviceContext::PipelineCache).
+	/// Loaded by VulkanICDState::CreateDevice() from {cache directory}/{vendorID}-{deviceID}.pipeline-cache.bin,
+	/// the file is only used when the header's vendorID, deviceID and pipelineCacheUUID match the device (the UUID
+	/// changes with the driver), otherwise the cache starts empty and the file is overwritten on the next save.
+	/// Saved when the DeviceContext is destroyed and by Tick() (DeviceContext::NextFrame()) every AutosaveFrames
+	/// frames when the cache data changed. Without a cache directory the cache only lives in memory.
+	/// </summary>
+	class PersistentPipelineCache
+	{
+	public:
+		static constexpr uint64_t AutosaveFrames = 3600;
+
+		/// <summary>
+		/// Must be set before the device is created, an empty directory disables persistence.
+		/// </summary>
+		static void SetGlobalCacheDirectory(const std::string& directory);
+		static const std::string& GetGlobalCacheDirectory() { return m_CachingDirectory; }
+
+		PersistentPipelineCache(DeviceContext* pCtx);
+		PersistentPipelineCache(PersistentPipelineCache&) = delete;
+		~PersistentPipelineCache();
+
+		vk::PipelineCache GetHandle() const { return m_Cache; }
+		/// <summary>
+		/// True when the cache was created from a valid file (warm start).
+		/// </summary>
+		bool WasLoaded() const { return m_Loaded; }
+		std::string GetFilePath() const;
+
+		/// <summary>
+		/// Writes the cache data when it changed since the last save, returns false when writing failed. Thread safe.
+		/// </summary>
+		bool Save();
+		void Tick();
+
+	private:
+		bool _IsCompatible(const std::vector<uint8_t>& data) const;
+		static Sha256::Digest _Hash(const std::vector<uint8_t>& data);
+
+	private:
+		static std::string m_CachingDirectory;
+
+		DeviceContext* m_Ctx;
+		vk::PipelineCache m_Cache;
+		vk::PhysicalDeviceProperties m_Properties;
+		bool m_Loaded = false;
+		// Hash of the data last loaded or written, the size alone misses entries replaced in place
+		Sha256::Digest m_SavedHash{};
+		uint64_t m_LastSaveFrame = 0;
+		std::mutex m_Lock;
+	};
+
+}
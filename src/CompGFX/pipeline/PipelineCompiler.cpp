@@ -0,0 +1,107 @@
+#include "PipelineCompiler.hpp"
+#include <ext/ZoneProfiler.hpp>
+
+using namespace egx;
+using namespace std;
+
+// Set on a worker that released the last device reference and so ran ~PipelineCompiler itself
+static thread_local const PipelineCompiler* s_DestroyedOnWorker = nullptr;
+
+egx::PipelineCompiler::PipelineCompiler(DeviceContext* pCtx, uint32_t threadCount) : m_Ctx(pCtx)
+{
+	if (threadCount == 0)
+		threadCount = std::max(thread::hardware_concurrency(), 2u) - 1u;
+	for (uint32_t i = 0; i < threadCount; i++)
+		m_Workers.emplace_back([this] { _WorkerLoop(); });
+}
+
+egx::PipelineCompiler::~PipelineCompiler()
+{
+	{
+		scoped_lock lock(m_Lock);
+		// Builds that did not start yet are dropped
+		m_Jobs.clear();
+		m_Exit = true;
+	}
+	m_WorkReady.notify_all();
+	for (auto& worker : m_Workers)
+	{
+		if (worker.get_id() == this_thread::get_id())
+		{
+			// The worker must not touch the compiler anymore, see _WorkerLoop()
+			s_DestroyedOnWorker = this;
+			worker.detach();
+		}
+		else
+			worker.join();
+	}
+}
+
+void egx::PipelineCompiler::Commit()
+{
+	vector<function<void()>> commits;
+	{
+		scoped_lock lock(m_Lock);
+		commits.swap(m_Commits);
+	}
+	for (auto& commit : commits)
+		commit();
+}
+
+void egx::PipelineCompiler::WaitIdle()
+{
+	unique_lock lock(m_Lock);
+	m_Idle.wait(lock, [this] { return m_Jobs.empty() && m_Active == 0; });
+}
+
+size_t egx::PipelineCompiler::QueuedCount() const
+{
+	scoped_lock lock(m_Lock);
+	return m_Jobs.size() + m_Active;
+}
+
+void egx::PipelineCompiler::_Enqueue(function<void()> job)
+{
+	{
+		scoped_lock lock(m_Lock);
+		m_Jobs.push_back(std::move(job));
+	}
+	m_WorkReady.notify_one();
+}
+
+void egx::PipelineCompiler::_AddCommit(function<void()> commit)
+{
+	scoped_lock lock(m_Lock);
+	m_Commits.push_back(std::move(commit));
+}
+
+void egx::PipelineCompiler::_WorkerLoop()
+{
+	ZoneProfiler::Get().SetThreadName("Pipeline compiler");
+	while (true)
+	{
+		function<void()> job;
+		{
+			unique_lock lock(m_Lock);
+			m_WorkReady.wait(lock, [this] { return m_Exit || !m_Jobs.empty(); });
+			if (m_Exit)
+				return;
+			job = std::move(m_Jobs.front());
+			m_Jobs.pop_front();
+			m_Active++;
+		}
+		{
+			EGX_ZONE("PipelineCompiler build");
+			job();
+		}
+		// The build may hold the last reference to the device, releasing it then destroys the compiler
+		job = nullptr;
+		if (s_DestroyedOnWorker == this)
+			return;
+		{
+			scoped_lock lock(m_Lock);
+			m_Active--;
+		}
+		m_Idle.notify_all();
+	}
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <core/egx.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <optional>
+#include <deque>
+
+namespace egx
+{
+
+	/// <summary>
+	/// Pipeline handle returned by PipelineCompiler. Get() returns the current pipeline, which keeps being used
+	/// while a newer build is pending and is replaced by the build once PipelineCompiler::Commit() runs
+	/// (DeviceContext::NextFrame()). The replaced pipeline is destroyed through the DeletionQueue.
+	/// Get() must be called from the thread calling NextFrame(), the reference is valid until the next frame.
+	/// </summary>
+	template <typename T>
+	class PendingPipeline
+	{
+	public:
+		PendingPipeline() : m_State(std::make_shared<State>()) {}
+		PendingPipeline(const T& pipeline) : PendingPipeline() { m_State->Current = pipeline, m_State->Valid = true; }
+
+		/// <summary>
+		/// A pipeline was committed, Get() must not be used before.
+		/// </summary>
+		bool IsValid() const { return m_State->Valid; }
+		/// <summary>
+		/// A build is queued, running or waiting for Commit().
+		/// </summary>
+		bool IsPending() const { return m_State->Pending.load() > 0; }
+		std::string GetError() const { std::scoped_lock lock(m_State->Lock); return m_State->Error; }
+
+		const T& Get() const { return m_State->Current; }
+		const T* operator->() const { return &m_State->Current; }
+
+	private:
+		friend class PipelineCompiler;
+
+		struct State
+		{
+			T Current;
+			bool Valid = false;
+			std::atomic<uint32_t> Pending = 0;
+			mutable std::mutex Lock;
+			// The newest finished build waiting for Commit()
+			std::optional<T> Ready;
+			uint64_t Requested = 0;
+			uint64_t ReadyGeneration = 0;
+			std::string Error;
+		};
+
+		std::shared_ptr<State> m_State;
+	};
+
+	/// <summary>
+	/// Builds pipelines (shader compilation included) on a set of worker threads, one per core by default.
+	/// Compile() queues a build callback and returns at once, the callback runs on a worker and must only create
+	/// objects (shaders, pipelines), it must not record or submit work. Finished builds are swapped in by Commit(),
+	/// called from DeviceContext::NextFrame(), so the previous pipeline stays bound for the rest of the frame.
+	/// A build that throws is logged and leaves the previous pipeline in place, see PendingPipeline::GetError().
+	/// Requesting many pipelines at startup followed by WaitIdle() and Commit() builds them in parallel.
+	/// </summary>
+	class PipelineCompiler
+	{
+	public:
+		PipelineCompiler(DeviceContext* pCtx, uint32_t threadCount = 0);
+		PipelineCompiler(PipelineCompiler&) = delete;
+		~PipelineCompiler();
+
+		template <typename T>
+		PendingPipeline<T> Compile(std::function<T()> build)
+		{
+			PendingPipeline<T> pipeline;
+			Recompile(pipeline, std::move(build));
+			return pipeline;
+		}
+
+		/// <summary>
+		/// Queues a new build of the pipeline, a build requested later replaces the result of an earlier one.
+		/// </summary>
+		template <typename T>
+		void Recompile(PendingPipeline<T>& pipeline, std::function<T()> build)
+		{
+			auto state = pipeline.m_State;
+			uint64_t generation;
+			{
+				std::scoped_lock lock(state->Lock);
+				generation = ++state->Requested;
+			}
+			state->Pending++;
+			_Enqueue([this, state, generation, build = std::move(build)] {
+				try {
+					T result = build();
+					std::scoped_lock lock(state->Lock);
+					if (generation > state->ReadyGeneration)
+						state->Ready = std::move(result), state->ReadyGeneration = generation, state->Error.clear();
+				}
+				catch (std::exception& e) {
+					LOG(ERR, "Pipeline build failed, the previous pipeline stays in use. {}", e.what());
+					std::scoped_lock lock(state->Lock);
+					state->Error = e.what();
+				}
+				// Holds a weak reference, a handle dropped before the commit is not kept alive by the compiler
+				_AddCommit([weakState = std::weak_ptr<typename PendingPipeline<T>::State>(state)] {
+					auto state = weakState.lock();
+					if (!state)
+						return;
+					std::optional<T> ready;
+					{
+						std::scoped_lock lock(state->Lock);
+						ready.swap(state->Ready);
+					}
+					if (ready)
+						state->Current = std::move(*ready), state->Valid = true;
+					state->Pending--;
+				});
+			});
+		}
+
+		/// <summary>
+		/// Swaps the finished builds into their handles, called from DeviceContext::NextFrame().
+		/// </summary>
+		void Commit();
+		/// <summary>
+		/// Blocks until every queued build finished, Commit() then swaps them in.
+		/// </summary>
+		void WaitIdle();
+
+		uint32_t ThreadCount() const { return uint32_t(m_Workers.size()); }
+		size_t QueuedCount() const;
+
+	private:
+		void _Enqueue(std::function<void()> job);
+		void _AddCommit(std::function<void()> commit);
+		void _WorkerLoop();
+
+	private:
+		DeviceContext* m_Ctx;
+		std::vector<std::thread> m_Workers;
+		std::deque<std::function<void()>> m_Jobs;
+		std::vector<std::function<void()>> m_Commits;
+		uint32_t m_Active = 0;
+		bool m_Exit = false;
+		mutable std::mutex m_Lock;
+		std::condition_variable m_WorkReady;
+		std::condition_variable m_Idle;
+	};
+
+}
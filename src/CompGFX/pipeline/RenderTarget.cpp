@@ -1,6 +1,8 @@
 #include "RenderTarget.hpp"
 #include <memory/formatsize.hpp>
 #include <core/CommandBuffer.hpp>
+#include <core/GpuProfiler.hpp>
+#include <core/DeletionQueue.hpp>
 
 using namespace std;
 using namespace egx;
@@ -270,7 +272,7 @@ vk::AttachmentDescription2 egx::IRenderTarget::GetAttachmentDescription(int32_t
 	return m_Data->m_ColorAttachments.at(id).Description;
 }
 
-void IRenderTarget::Begin(vk::CommandBuffer cmd)
+void IRenderTarget::Begin(vk::CommandBuffer cmd, vk::SubpassContents contents)
 {
 	vk::RenderPassBeginInfo beginInfo;
 	vector<vk::ClearValue> clearValues;
@@ -302,14 +304,30 @@ void IRenderTarget::Begin(vk::CommandBuffer cmd)
 		beginInfo.setFramebuffer(m_Data->m_Framebuffer);
 	}
 	vk::SubpassBeginInfo subpassBegin;
-	subpassBegin.setContents(vk::SubpassContents::eInline);
+	subpassBegin.setContents(contents);
+	m_Data->m_ProfilerZone = m_Data->m_Ctx->Profiler->Begin(cmd, "RenderTarget");
 	cmd.beginRenderPass2(beginInfo, subpassBegin);
 }
 
+vk::CommandBufferInheritanceInfo egx::IRenderTarget::GetInheritanceInfo() const
+{
+	vk::CommandBufferInheritanceInfo inheritance;
+	inheritance.setRenderPass(m_Data->m_RenderPass).setSubpass(0);
+	if (m_Data->m_SwapchainFlag) {
+		inheritance.setFramebuffer(m_Data->m_SwapchainFramebuffers[m_Data->m_Ctx->CurrentFrame]);
+	}
+	else {
+		inheritance.setFramebuffer(m_Data->m_Framebuffer);
+	}
+	return inheritance;
+}
+
 void IRenderTarget::End(vk::CommandBuffer cmd)
 {
 	vk::SubpassEndInfo endInfo;
 	cmd.endRenderPass2(endInfo);
+	m_Data->m_Ctx->Profiler->End(cmd, m_Data->m_ProfilerZone);
+	m_Data->m_ProfilerZone = GpuProfiler::InvalidZone;
 }
 
 void egx::IRenderTarget::BeginDearImGuiFrame()
@@ -334,10 +352,13 @@ IRenderTarget::DataWrapper::~DataWrapper()
 void IRenderTarget::DataWrapper::Reinvalidate() {
 	if (m_Ctx && m_RenderPass)
 	{
-		m_Ctx->Device.destroyRenderPass(m_RenderPass);
-		for (vk::Framebuffer framebuffer : m_SwapchainFramebuffers)
-			m_Ctx->Device.destroyFramebuffer(framebuffer);
-		m_Ctx->Device.destroyFramebuffer(m_Framebuffer);
+		// Frames in flight may still render into the framebuffers
+		m_Ctx->Deletion->Push([device = m_Ctx->Device, renderPass = m_RenderPass, framebuffer = m_Framebuffer, swapchainFramebuffers = m_SwapchainFramebuffers] {
+			device.destroyRenderPass(renderPass);
+			for (vk::Framebuffer swapchainFramebuffer : swapchainFramebuffers)
+				device.destroyFramebuffer(swapchainFramebuffer);
+			device.destroyFramebuffer(framebuffer);
+		});
 		m_RenderPass = nullptr, m_Framebuffer = nullptr;
 		m_SwapchainFramebuffers.clear();
 	}
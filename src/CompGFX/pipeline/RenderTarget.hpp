@@ -50,7 +50,11 @@ namespace egx
         virtual ImGuiContext* GetImGuiContext();
 
         virtual void Invalidate();
-        virtual void Begin(vk::CommandBuffer cmd);
+        /// <summary>
+        /// Pass eSecondaryCommandBuffers when the subpass is recorded into secondary command buffers
+        /// (see GetInheritanceInfo()), the primary buffer may then only execute them.
+        /// </summary>
+        virtual void Begin(vk::CommandBuffer cmd, vk::SubpassContents contents = vk::SubpassContents::eInline);
         virtual void End(vk::CommandBuffer cmd);
 
         virtual void BeginDearImGuiFrame();
@@ -62,6 +66,11 @@ namespace egx
         /// <param name="cmd"></param>
         virtual void EndDearImGuiFrame(vk::CommandBuffer cmd);
 
+        /// <summary>
+        /// Inheritance for secondary command buffers that continue the render pass of the current frame.
+        /// </summary>
+        virtual vk::CommandBufferInheritanceInfo GetInheritanceInfo() const;
+
         virtual Image2D GetAttachment(int32_t id);
         virtual vk::AttachmentDescription2 GetAttachmentDescription(int32_t id);
         virtual bool ContainsAttachment(int32_t id) const { return m_Data->m_ColorAttachments.contains(id); }
@@ -97,6 +106,8 @@ namespace egx
             bool m_DearImGuiFlag = false;
             GLFWwindow* m_WindowPtr = nullptr;
             ISwapchainController m_Swapchain;
+            // GPU profiler zone from Begin() to End()
+            uint32_t m_ProfilerZone = UINT32_MAX;
 
             struct {
                 vk::ImageLayout initialLayout;
@@ -1,4 +1,5 @@
 #include "Sampler.hpp"
+#include <core/DeletionQueue.hpp>
 using namespace std;
 using namespace egx;
 using namespace vk;
@@ -34,7 +35,7 @@ void egx::ISamplerBuilder::Invalidate()
 void egx::ISamplerBuilder::DataWrapper::Reinvalidate()
 {
     if(m_Ctx && m_Sampler) {
-        m_Ctx->Device.destroySampler(m_Sampler);
+        m_Ctx->Deletion->Push([device = m_Ctx->Device, sampler = m_Sampler] { device.destroySampler(sampler); });
         m_Sampler = nullptr;
     }
 }
@@ -1,9 +1,41 @@
 #include "ShaderBinding.hpp"
+#include <core/QueueSubmitter.hpp>
+#include <core/GpuProfiler.hpp>
+#include <core/DeletionQueue.hpp>
+#include <algorithm>
 
 using namespace std;
 using namespace egx;
 using namespace cpp;
 
+static vk::PipelineStageFlags2 ShaderStagesToPipelineStages(VkShaderStageFlags shaderStages)
+{
+	vk::PipelineStageFlags2 stages;
+	if (shaderStages & VK_SHADER_STAGE_VERTEX_BIT)
+		stages |= vk::PipelineStageFlagBits2::eVertexShader;
+	if (shaderStages & VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT)
+		stages |= vk::PipelineStageFlagBits2::eTessellationControlShader;
+	if (shaderStages & VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT)
+		stages |= vk::PipelineStageFlagBits2::eTessellationEvaluationShader;
+	if (shaderStages & VK_SHADER_STAGE_GEOMETRY_BIT)
+		stages |= vk::PipelineStageFlagBits2::eGeometryShader;
+	if (shaderStages & VK_SHADER_STAGE_FRAGMENT_BIT)
+		stages |= vk::PipelineStageFlagBits2::eFragmentShader;
+	if (shaderStages & VK_SHADER_STAGE_COMPUTE_BIT)
+		stages |= vk::PipelineStageFlagBits2::eComputeShader;
+	return stages ? stages : vk::PipelineStageFlagBits2::eAllCommands;
+}
+
+static const vk::AccessFlags2 WriteAccessMask =
+	vk::AccessFlagBits2::eShaderWrite | vk::AccessFlagBits2::eShaderStorageWrite |
+	vk::AccessFlagBits2::eColorAttachmentWrite | vk::AccessFlagBits2::eDepthStencilAttachmentWrite |
+	vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eHostWrite | vk::AccessFlagBits2::eMemoryWrite;
+
+static uint64_t ResourceKey(const ResourceAccess& access)
+{
+	return access.BufferResource ? uint64_t(VkBuffer(access.BufferResource->GetHandle())) : uint64_t(VkImage(access.ImageResource->GetHandle()));
+}
+
 ResourceDescriptor::ResourceDescriptor(const DeviceCtx& pCtx, const ResourceDescriptorPool& pool, const PipelineType& pipeline)
 {
 	m_Data = make_shared<ResourceDescriptor::DataWrapper>();
@@ -12,41 +44,7 @@ ResourceDescriptor::ResourceDescriptor(const DeviceCtx& pCtx, const ResourceDesc
 	m_Data->m_vkPool = pool.GetPool();
 	m_Data->m_Pipeline = unique_ptr<PipelineType>(static_cast<PipelineType*>(pipeline.MakeHandle().release()));
 	m_Reflection = pipeline.Reflection();
-	auto setLayouts = pipeline.GetDescriptorSetLayouts();
-
-	if (setLayouts.size() == 0)
-	{
-		throw std::runtime_error("Cannot create a resource descriptor with 0 descriptor set layouts.");
-	}
-
-	vector<vk::DescriptorSetLayout> layouts;
-	for (auto& [_, setLayout] : setLayouts)
-		layouts.push_back(setLayout);
-
-	vk::DescriptorSetAllocateInfo allocateInfo;
-	allocateInfo.descriptorPool = pool.GetPool();
-	allocateInfo.descriptorSetCount = (uint32_t)layouts.size();
-	allocateInfo.pSetLayouts = layouts.data();
-	auto sets = pCtx->Device.allocateDescriptorSets(allocateInfo);
-	// Map vk::DescriptorSet with setId in std::map<uint32_t(setId), vk::DescriptorSet>
-	for (uint32_t frame = 0; frame < pCtx->FramesInFlight; frame++) {
-		int i = 0;
-		for (auto& [setId, _] : setLayouts)
-		{
-			m_Data->m_Sets[frame][setId] = sets[i++];
-		}
-	}
-
-	for (auto& [setId, bindings] : m_Reflection.SetToManyBindings)
-	{
-		for (auto& [bindingId, info] : bindings)
-		{
-			if (info.IsDynamic && info.IsBuffer)
-			{
-				m_Data->m_Offsets.resize(m_Data->m_Offsets.size() + 1);
-			}
-		}
-	}
+	_AllocateSets(pool.GetPool(), pipeline);
 }
 
 egx::ResourceDescriptor::ResourceDescriptor(const DeviceCtx& pCtx, vk::DescriptorPool pool, const PipelineType& pipeline)
@@ -56,6 +54,11 @@ egx::ResourceDescriptor::ResourceDescriptor(const DeviceCtx& pCtx, vk::Descripto
 	m_Data->m_vkPool = pool;
 	m_Data->m_Pipeline = unique_ptr<PipelineType>(static_cast<PipelineType*>(pipeline.MakeHandle().release()));
 	m_Reflection = pipeline.Reflection();
+	_AllocateSets(pool, pipeline);
+}
+
+void egx::ResourceDescriptor::_AllocateSets(vk::DescriptorPool pool, const PipelineType& pipeline)
+{
 	auto setLayouts = pipeline.GetDescriptorSetLayouts();
 
 	if (setLayouts.size() == 0)
@@ -71,9 +74,10 @@ egx::ResourceDescriptor::ResourceDescriptor(const DeviceCtx& pCtx, vk::Descripto
 	allocateInfo.descriptorPool = pool;
 	allocateInfo.descriptorSetCount = (uint32_t)layouts.size();
 	allocateInfo.pSetLayouts = layouts.data();
-	auto sets = pCtx->Device.allocateDescriptorSets(allocateInfo);
 	// Map vk::DescriptorSet with setId in std::map<uint32_t(setId), vk::DescriptorSet>
-	for (uint32_t frame = 0; frame < pCtx->FramesInFlight; frame++) {
+	// Each frame gets its own sets, otherwise updating a set would race with frames in flight
+	for (uint32_t frame = 0; frame < m_Data->m_Ctx->FramesInFlight; frame++) {
+		auto sets = m_Data->m_Ctx->Device.allocateDescriptorSets(allocateInfo);
 		int i = 0;
 		for (auto& [setId, _] : setLayouts)
 		{
@@ -95,35 +99,94 @@ egx::ResourceDescriptor::ResourceDescriptor(const DeviceCtx& pCtx, vk::Descripto
 
 ResourceDescriptor& egx::ResourceDescriptor::SetInput(int setId, int bindingId, const Buffer& particle_buffer)
 {
-	uint32_t frame = m_Data->m_Ctx->CurrentFrame;
-	vk::WriteDescriptorSet write;
-	write.dstBinding = bindingId;
-	write.dstSet = m_Data->m_Sets.at(frame).at(setId);
-	write.descriptorCount = 1;
-	write.descriptorType = vk::DescriptorType(m_Reflection.SetToManyBindings.at(setId).at(bindingId).Type);
-	const vk::DescriptorBufferInfo info = vk::DescriptorBufferInfo().setBuffer(particle_buffer.GetHandle()).setRange(particle_buffer.Size());
-	write.setBufferInfo(info);
-	m_Data->m_Ctx->Device.updateDescriptorSets(write, {});
-	return *this;
+	BoundResource resource;
+	resource.BufferResource = particle_buffer;
+	resource.Range = particle_buffer.Size();
+	return _SetInput(setId, bindingId, resource);
 }
 
 ResourceDescriptor& egx::ResourceDescriptor::SetInput(int setId, int bindingId, vk::ImageLayout layout, int viewId, const Image2D& image, vk::Sampler sampler)
 {
-	uint32_t frame = m_Data->m_Ctx->CurrentFrame;
-	vk::WriteDescriptorSet write;
-	write.dstBinding = bindingId;
-	write.dstSet = m_Data->m_Sets.at(frame).at(setId);
-	write.descriptorCount = 1;
-	write.descriptorType = vk::DescriptorType(m_Reflection.SetToManyBindings.at(setId).at(bindingId).Type);
-	const auto info = vk::DescriptorImageInfo()
-		.setImageLayout(layout)
-		.setImageView(image.GetView(viewId))
-		.setSampler(sampler);
-	write.setImageInfo(info);
-	m_Data->m_Ctx->Device.updateDescriptorSets(write, {});
+	BoundResource resource;
+	resource.ImageResource = image;
+	resource.Layout = layout;
+	resource.ViewId = viewId;
+	resource.Sampler = sampler;
+	return _SetInput(setId, bindingId, resource);
+}
+
+ResourceDescriptor& egx::ResourceDescriptor::SetInput(int setId, int bindingId, const FrameArena& arena, vk::DeviceSize range)
+{
+	auto& info = m_Reflection.SetToManyBindings.at(setId).at(bindingId);
+	if (!info.IsDynamic)
+	{
+		LOG(WARNING, "Binding {} of set {} ({}) is not dynamic, every draw will read the start of the frame arena.", bindingId, setId, info.Name);
+	}
+	BoundResource resource;
+	resource.ArenaResource = arena;
+	resource.Range = range == 0 ? info.Size : range;
+	return _SetInput(setId, bindingId, resource);
+}
+
+ResourceDescriptor& egx::ResourceDescriptor::_SetInput(int setId, int bindingId, BoundResource resource)
+{
+	resource.Type = vk::DescriptorType(m_Reflection.SetToManyBindings.at(setId).at(bindingId).Type);
+	resource.WrittenHandles.assign(m_Data->m_Ctx->FramesInFlight, 0);
+	m_Data->m_Bindings[setId][bindingId] = std::move(resource);
 	return *this;
 }
 
+void egx::ResourceDescriptor::_UpdateSets(uint32_t frame)
+{
+	vector<vk::WriteDescriptorSet> writes;
+	// Reserved so the pointers of the writes stay valid
+	vector<vk::DescriptorBufferInfo> bufferInfos;
+	vector<vk::DescriptorImageInfo> imageInfos;
+	size_t count = 0;
+	for (auto& [setId, bindings] : m_Data->m_Bindings)
+		count += bindings.size();
+	bufferInfos.reserve(count), imageInfos.reserve(count);
+
+	for (auto& [setId, bindings] : m_Data->m_Bindings)
+	{
+		for (auto& [bindingId, resource] : bindings)
+		{
+			vk::Buffer buffer;
+			vk::ImageView view;
+			if (resource.ImageResource)
+				view = resource.ImageResource->GetView(resource.ViewId);
+			else
+				buffer = resource.ArenaResource ? resource.ArenaResource->GetHandle(frame) : resource.BufferResource->GetHandle(frame);
+			uint64_t handle = resource.ImageResource ? uint64_t(VkImageView(view)) : uint64_t(VkBuffer(buffer));
+			if (resource.WrittenHandles[frame] == handle)
+				continue;
+			resource.WrittenHandles[frame] = handle;
+
+			vk::WriteDescriptorSet write;
+			write.dstBinding = bindingId;
+			write.dstSet = m_Data->m_Sets.at(frame).at(setId);
+			write.descriptorCount = 1;
+			write.descriptorType = resource.Type;
+			if (resource.ImageResource)
+			{
+				imageInfos.push_back(vk::DescriptorImageInfo()
+					.setImageLayout(resource.Layout)
+					.setImageView(view)
+					.setSampler(resource.Sampler));
+				write.pImageInfo = &imageInfos.back();
+			}
+			else
+			{
+				bufferInfos.push_back(vk::DescriptorBufferInfo().setBuffer(buffer).setRange(resource.Range));
+				write.pBufferInfo = &bufferInfos.back();
+			}
+			writes.push_back(write);
+		}
+	}
+	if (writes.size() > 0)
+		m_Data->m_Ctx->Device.updateDescriptorSets(writes, {});
+}
+
 void egx::ResourceDescriptor::SetBufferOffset(int setId, int bindingId, uint32_t offset)
 {
 	m_Data->m_OffsetMapping[setId][bindingId] = offset;
@@ -132,13 +195,22 @@ void egx::ResourceDescriptor::SetBufferOffset(int setId, int bindingId, uint32_t
 void egx::ResourceDescriptor::Bind(vk::CommandBuffer cmd)
 {
 	uint32_t frame = m_Data->m_Ctx->CurrentFrame;
+	_UpdateSets(frame);
+	// Dynamic offsets are consumed in set/binding order, bindings without an offset use 0
 	int offsetIndex = 0;
-	for (auto& [setId, bindingOffsets] : m_Data->m_OffsetMapping)
+	for (auto& [setId, bindings] : m_Reflection.SetToManyBindings)
 	{
-		for (auto& [bindingId, offset] : bindingOffsets)
+		for (auto& [bindingId, info] : bindings)
 		{
-			m_Data->m_Offsets[offsetIndex] = offset;
-			offsetIndex++;
+			if (!info.IsDynamic || !info.IsBuffer)
+				continue;
+			uint32_t offset = 0;
+			if (auto set = m_Data->m_OffsetMapping.find(setId); set != m_Data->m_OffsetMapping.end())
+			{
+				if (auto binding = set->second.find(bindingId); binding != set->second.end())
+					offset = binding->second;
+			}
+			m_Data->m_Offsets[offsetIndex++] = offset;
 		}
 	}
 	// The maximum descriptor sets on the best nvidia gpus is 8
@@ -155,6 +227,48 @@ void egx::ResourceDescriptor::Bind(vk::CommandBuffer cmd)
 	cmd.bindDescriptorSets(m_Data->m_Pipeline->BindPoint(), m_Data->m_Pipeline->Layout(), firstSet, setCount, sets.data(), (uint32_t)m_Data->m_Offsets.size(), m_Data->m_Offsets.data());
 }
 
+std::vector<ResourceAccess> egx::ResourceDescriptor::EnumerateAccesses() const
+{
+	vector<ResourceAccess> accesses;
+	vk::PipelineStageFlags2 stages = ShaderStagesToPipelineStages(m_Reflection.ShaderStage);
+	for (auto& [setId, bindings] : m_Data->m_Bindings)
+	{
+		for (auto& [bindingId, resource] : bindings)
+		{
+			if (!resource.BufferResource && !resource.ImageResource)
+				continue;
+			const auto& info = m_Reflection.SetToManyBindings.at(setId).at(bindingId);
+			ResourceAccess access;
+			access.BufferResource = resource.BufferResource;
+			access.ImageResource = resource.ImageResource;
+			access.Stages = stages;
+			access.Write = !info.IsReadOnly;
+			switch (resource.Type)
+			{
+			case vk::DescriptorType::eUniformBuffer:
+			case vk::DescriptorType::eUniformBufferDynamic:
+				access.Access = vk::AccessFlagBits2::eUniformRead;
+				break;
+			case vk::DescriptorType::eStorageBuffer:
+			case vk::DescriptorType::eStorageBufferDynamic:
+			case vk::DescriptorType::eStorageImage:
+				access.Access = vk::AccessFlagBits2::eShaderStorageRead;
+				if (access.Write)
+					access.Access |= vk::AccessFlagBits2::eShaderStorageWrite;
+				break;
+			case vk::DescriptorType::eInputAttachment:
+				access.Access = vk::AccessFlagBits2::eInputAttachmentRead;
+				break;
+			default:
+				access.Access = vk::AccessFlagBits2::eShaderSampledRead;
+				break;
+			}
+			accesses.push_back(access);
+		}
+	}
+	return accesses;
+}
+
 egx::ResourceDescriptorPool::ResourceDescriptorPool(const DeviceCtx& pCtx) : m_Ctx(pCtx)
 {
 	vk::DescriptorPoolSize poolSizes[] = {
@@ -178,14 +292,22 @@ egx::ResourceDescriptorPool::ResourceDescriptorPool(const DeviceCtx& pCtx) : m_C
 egx::ResourceDescriptorPool::~ResourceDescriptorPool()
 {
 	if (m_Pool.use_count() == 1) {
-		m_Ctx->Device.destroyDescriptorPool(*m_Pool);
+		// Sets of the pool may still be bound by frames in flight
+		m_Ctx->Deletion->Push([device = m_Ctx->Device, pool = *m_Pool] { device.destroyDescriptorPool(pool); });
 	}
 }
 
 
 ResourceDescriptor::DataWrapper::~DataWrapper()
 {
-	LOG(WARNING, "(TODO) Free descriptor set.");
+	if (!m_Ctx || m_Sets.empty())
+		return;
+	vector<vk::DescriptorSet> sets;
+	for (auto& [frame, frameSets] : m_Sets)
+		for (auto& [setId, set] : frameSets)
+			sets.push_back(set);
+	// Frames in flight may still bind the sets, pushed before m_Pool releases the pool (both pools allow eFreeDescriptorSet)
+	m_Ctx->Deletion->Push([device = m_Ctx->Device, pool = m_vkPool, sets = std::move(sets)] { device.freeDescriptorSets(pool, sets); });
 }
 
 #if 1
@@ -195,9 +317,10 @@ egx::RenderGraph::RenderGraph(const DeviceCtx& ctx)
 	m_Data->m_Ctx = ctx;
 	for (auto i = 0u; i < ctx->FramesInFlight; i++)
 	{
-		auto cmdPool = ctx->Device.createCommandPool({});
-		auto cmd = ctx->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(cmdPool).setCommandBufferCount(1));
-		m_Data->m_Cmds.push_back({ cmdPool, cmd[0], ctx->Device.createFence(vk::FenceCreateInfo().setFlags(vk::FenceCreateFlagBits::eSignaled)) });
+		DataWrapper::FrameCommands frame;
+		frame.Pools[uint32_t(QueueType::Graphics)] = ctx->Device.createCommandPool(vk::CommandPoolCreateInfo({}, ctx->GraphicsQueueFamilyIndex));
+		frame.Fence = ctx->Device.createFence(vk::FenceCreateInfo().setFlags(vk::FenceCreateFlagBits::eSignaled));
+		m_Data->m_Cmds.push_back(frame);
 	}
 
 	vk::DescriptorPoolSize poolSizes[] = {
@@ -218,15 +341,282 @@ egx::RenderGraph::RenderGraph(const DeviceCtx& ctx)
 
 RenderGraph& egx::RenderGraph::Add(const PipelineType& pipeline, const function<void(vk::CommandBuffer)>& stageCallback, const GraphSynchronization& sync)
 {
-	m_Data->m_Stages.push_back(Stage{pipeline.MakeHandle(), stageCallback, sync});
+	return Add(pipeline, stageCallback, StageResources(), sync);
+}
+
+RenderGraph& egx::RenderGraph::Add(const PipelineType& pipeline, const function<void(vk::CommandBuffer)>& stageCallback, const StageResources& resources, const GraphSynchronization& sync)
+{
+	if (m_Data->m_Compiled && m_Data->m_Transients.size() > 0)
+	{
+		throw runtime_error("Cannot add stages to a RenderGraph after its transient resources were placed.");
+	}
+	m_Data->m_Compiled = false;
+	auto stages = ShaderStagesToPipelineStages(pipeline.Reflection().ShaderStage);
+	m_Data->m_Stages.push_back(Stage{pipeline.MakeHandle(), stageCallback, sync, resources, stages});
+	return *this;
+}
+
+RenderGraph& egx::RenderGraph::AddAsyncCompute(const ComputePipeline& pipeline, const function<void(vk::CommandBuffer)>& stageCallback, const StageResources& resources, const GraphSynchronization& sync)
+{
+	Add(pipeline, stageCallback, resources, sync);
+	if (!_AsyncComputeSupported())
+	{
+		LOG(INFO, "No dedicated compute queue with timeline semaphores, the async compute stage runs on the graphics queue.");
+		return *this;
+	}
+	m_Data->m_Stages.back().AsyncCompute = true;
+	const auto& ctx = m_Data->m_Ctx;
+	if (!m_Data->m_Timelines[0])
+	{
+		vk::SemaphoreTypeCreateInfo timelineInfo(vk::SemaphoreType::eTimeline, 0);
+		for (auto& timeline : m_Data->m_Timelines)
+			timeline = ctx->Device.createSemaphore(vk::SemaphoreCreateInfo().setPNext(&timelineInfo));
+	}
+	for (auto& frame : m_Data->m_Cmds)
+	{
+		auto& pool = frame.Pools[uint32_t(QueueType::Compute)];
+		if (!pool)
+			pool = ctx->Device.createCommandPool(vk::CommandPoolCreateInfo({}, ctx->ComputeQueueFamilyIndex));
+	}
+	return *this;
+}
+
+RenderGraph& egx::RenderGraph::MakeStatic()
+{
+	if (m_Data->m_Stages.empty())
+	{
+		throw runtime_error("MakeStatic() requires a stage, call it after Add().");
+	}
+	auto& stage = m_Data->m_Stages.back();
+	stage.Static = true;
+	stage.Baked.resize(m_Data->m_Ctx->FramesInFlight);
 	return *this;
 }
 
+void egx::RenderGraph::InvalidateStage(uint32_t stageIndex)
+{
+	if (stageIndex >= m_Data->m_Stages.size())
+	{
+		throw out_of_range(cpp::Format("Stage {} does not exist, the graph has {} stages.", stageIndex, m_Data->m_Stages.size()));
+	}
+	for (auto& baked : m_Data->m_Stages[stageIndex].Baked)
+		baked.Valid = false;
+}
+
+void egx::RenderGraph::Invalidate(const Buffer& buffer)
+{
+	vector<uint64_t> keys;
+	for (uint32_t i = 0; i < (buffer.IsFrameResource ? m_Data->m_Ctx->FramesInFlight : 1); i++)
+		keys.push_back(uint64_t(VkBuffer(buffer.GetHandle(i))));
+	for (auto& stage : m_Data->m_Stages)
+	{
+		for (auto& baked : stage.Baked)
+		{
+			if (any_of(keys.begin(), keys.end(), [&](uint64_t key) { return find(baked.Keys.begin(), baked.Keys.end(), key) != baked.Keys.end(); }))
+				baked.Valid = false;
+		}
+	}
+}
+
+void egx::RenderGraph::Invalidate(const Image2D& image)
+{
+	uint64_t key = uint64_t(VkImage(image.GetHandle()));
+	for (auto& stage : m_Data->m_Stages)
+	{
+		for (auto& baked : stage.Baked)
+		{
+			if (find(baked.Keys.begin(), baked.Keys.end(), key) != baked.Keys.end())
+				baked.Valid = false;
+		}
+	}
+}
+
+void egx::RenderGraph::Invalidate()
+{
+	for (auto& stage : m_Data->m_Stages)
+	{
+		for (auto& baked : stage.Baked)
+			baked.Valid = false;
+	}
+}
+
+bool egx::RenderGraph::_AsyncComputeSupported() const
+{
+	const auto& ctx = m_Data->m_Ctx;
+	// Sharing the graphics queue would make the final graphics submission wait on a later submission to the same queue
+	return ctx->TimelineSemaphoreEnabled && ctx->DedicatedCompute != ctx->Queue;
+}
+
+Buffer egx::RenderGraph::CreateTransientBuffer(size_t size, vk::BufferUsageFlags usage)
+{
+	const auto& ctx = m_Data->m_Ctx;
+	auto buffer = ctx->Device.createBuffer(vk::BufferCreateInfo({}, size, usage, vk::SharingMode::eExclusive));
+	_AddTransient(uint64_t(VkBuffer(buffer)), false, ctx->Device.getBufferMemoryRequirements(buffer));
+	return Buffer::CreateFromHandle(ctx, buffer, size, usage);
+}
+
+Image2D egx::RenderGraph::CreateTransientImage(int width, int height, vk::Format format, vk::ImageUsageFlags usage, vk::ImageLayout layout)
+{
+	const auto& ctx = m_Data->m_Ctx;
+	auto createInfo = vk::ImageCreateInfo()
+		.setImageType(vk::ImageType::e2D)
+		.setFormat(format)
+		.setExtent(vk::Extent3D(width, height, 1))
+		.setMipLevels(1)
+		.setArrayLayers(1)
+		.setSamples(vk::SampleCountFlagBits::e1)
+		.setTiling(vk::ImageTiling::eOptimal)
+		.setUsage(usage)
+		.setSharingMode(vk::SharingMode::eExclusive)
+		.setInitialLayout(vk::ImageLayout::eUndefined);
+	auto image = ctx->Device.createImage(createInfo);
+	_AddTransient(uint64_t(VkImage(image)), true, ctx->Device.getImageMemoryRequirements(image));
+	return Image2D::CreateFromHandle(ctx, image, width, height, format, 1, usage, layout);
+}
+
+void egx::RenderGraph::_AddTransient(uint64_t key, bool isImage, const vk::MemoryRequirements& requirements)
+{
+	if (m_Data->m_Compiled && m_Data->m_Transients.size() > 0)
+	{
+		throw runtime_error("Cannot create transient resources after the RenderGraph placed its transients.");
+	}
+	m_Data->m_Compiled = false;
+	m_Data->m_TransientIndices[key] = uint32_t(m_Data->m_Transients.size());
+	Transient transient{};
+	transient.Key = key;
+	transient.IsImage = isImage;
+	transient.Requirements = requirements;
+	transient.FirstStage = UINT32_MAX;
+	m_Data->m_Transients.push_back(transient);
+}
+
+void egx::RenderGraph::Compile()
+{
+	auto& data = *m_Data;
+	if (data.m_Compiled)
+		return;
+	data.m_Compiled = true;
+	if (data.m_Transients.empty())
+		return;
+
+	for (uint32_t i = 0; i < data.m_Stages.size(); i++)
+	{
+		for (auto& access : data.m_Stages[i].Resources.Accesses())
+		{
+			uint64_t key = ResourceKey(access);
+			auto index = data.m_TransientIndices.find(key);
+			if (index == data.m_TransientIndices.end())
+				continue;
+			auto& transient = data.m_Transients[index->second];
+			transient.FirstStage = std::min(transient.FirstStage, i);
+			transient.LastStage = std::max(transient.LastStage, i);
+		}
+	}
+	for (auto& transient : data.m_Transients)
+	{
+		if (transient.FirstStage != UINT32_MAX)
+			continue;
+		// Without a declared use the lifetime is unknown, it overlaps every other transient
+		LOG(WARNING, "Transient {} is not declared by any RenderGraph stage, it lives for the whole graph.", transient.IsImage ? "image" : "buffer");
+		transient.FirstStage = 0;
+		transient.LastStage = data.m_Stages.size() > 0 ? uint32_t(data.m_Stages.size() - 1) : 0;
+	}
+
+	// Largest first, each transient takes the lowest offset not used by a transient alive at the same time.
+	// Images and buffers are kept in separate blocks so bufferImageGranularity never applies.
+	vector<uint32_t> order(data.m_Transients.size());
+	for (uint32_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return data.m_Transients[a].Requirements.size > data.m_Transients[b].Requirements.size; });
+
+	struct HeapInfo
+	{
+		bool IsImage;
+		uint32_t MemoryTypeBits;
+		vk::DeviceSize Size = 0;
+		vk::DeviceSize Alignment = 1;
+		vector<uint32_t> Placed;
+	};
+	vector<HeapInfo> heaps;
+	for (uint32_t index : order)
+	{
+		auto& transient = data.m_Transients[index];
+		const auto& requirements = transient.Requirements;
+		auto heap = find_if(heaps.begin(), heaps.end(), [&](const HeapInfo& info) {
+			return info.IsImage == transient.IsImage && info.MemoryTypeBits == requirements.memoryTypeBits;
+		});
+		if (heap == heaps.end())
+		{
+			heaps.push_back(HeapInfo{ transient.IsImage, requirements.memoryTypeBits });
+			heap = heaps.end() - 1;
+		}
+
+		auto align = [&](vk::DeviceSize offset) { return (offset + requirements.alignment - 1) / requirements.alignment * requirements.alignment; };
+		vector<vk::DeviceSize> candidates = { 0 };
+		for (uint32_t other : heap->Placed)
+			candidates.push_back(align(data.m_Transients[other].Offset + data.m_Transients[other].Requirements.size));
+		sort(candidates.begin(), candidates.end());
+
+		vk::DeviceSize offset = candidates.back();
+		for (auto candidate : candidates)
+		{
+			bool available = none_of(heap->Placed.begin(), heap->Placed.end(), [&](uint32_t other) {
+				const auto& placed = data.m_Transients[other];
+				bool lifetimeOverlap = placed.FirstStage <= transient.LastStage && transient.FirstStage <= placed.LastStage;
+				bool memoryOverlap = placed.Offset < candidate + requirements.size && candidate < placed.Offset + placed.Requirements.size;
+				return lifetimeOverlap && memoryOverlap;
+			});
+			if (available)
+			{
+				offset = candidate;
+				break;
+			}
+		}
+		transient.Heap = uint32_t(heap - heaps.begin());
+		transient.Offset = offset;
+		heap->Size = std::max(heap->Size, offset + requirements.size);
+		heap->Alignment = std::max(heap->Alignment, requirements.alignment);
+		heap->Placed.push_back(index);
+	}
+
+	const auto& ctx = data.m_Ctx;
+	for (auto& heap : heaps)
+	{
+		VmaAllocationCreateInfo createInfo{};
+		createInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		VkMemoryRequirements requirements{ heap.Size, heap.Alignment, heap.MemoryTypeBits };
+		VmaAllocation allocation;
+		VkResult result = vmaAllocateMemory(ctx->Allocator, &requirements, &createInfo, &allocation, nullptr);
+		if (result != VK_SUCCESS)
+		{
+			throw runtime_error(cpp::Format("Could not allocate {} bytes for the RenderGraph transients, error code {}", heap.Size, vk::to_string(vk::Result(result))));
+		}
+		data.m_TransientHeaps.push_back(allocation);
+		data.m_TransientMemorySize += heap.Size;
+		ctx->Telemetry->Register(allocation, heap.IsImage ? MemoryCategory::RenderTarget : MemoryCategory::Other, heap.Size);
+	}
+	for (auto& transient : data.m_Transients)
+	{
+		VmaAllocation allocation = data.m_TransientHeaps[transient.Heap];
+		VkResult result = transient.IsImage ?
+			vmaBindImageMemory2(ctx->Allocator, allocation, transient.Offset, VkImage(transient.Key), nullptr) :
+			vmaBindBufferMemory2(ctx->Allocator, allocation, transient.Offset, VkBuffer(transient.Key), nullptr);
+		if (result != VK_SUCCESS)
+		{
+			throw runtime_error(cpp::Format("Could not bind transient memory at offset {}, error code {}", transient.Offset, vk::to_string(vk::Result(result))));
+		}
+	}
+}
+
+vk::DeviceSize egx::RenderGraph::TransientMemorySize() const
+{
+	return m_Data->m_TransientMemorySize;
+}
+
 void RenderGraph::Run()
 {
-	const auto device = m_Data->m_Ctx->Device;
 	const auto fence = RunAsync();
-	device.waitForFences(fence, true, numeric_limits<uint64_t>::max());
+	m_Data->m_Ctx->Submitter->WaitForFences({ fence });
 }
 
 RenderGraph& egx::RenderGraph::AddWaitSemaphore(vk::Semaphore semaphore, vk::PipelineStageFlags stageFlag)
@@ -243,43 +633,440 @@ RenderGraph& egx::RenderGraph::UseSignalSemaphore()
 
 vk::Fence egx::RenderGraph::RunAsync()
 {
-	const auto device = m_Data->m_Ctx->Device;
-	const auto queue = m_Data->m_Ctx->Queue;
-	const auto [cmdPool, cmd, fence] = m_Data->m_Cmds[m_Data->m_Ctx->CurrentFrame];
-	device.waitForFences(fence, true, numeric_limits<uint64_t>::max());
-	device.resetFences(fence);
-	device.resetCommandPool(cmdPool);
-	cmd.begin(vk::CommandBufferBeginInfo());
-	for (auto& stage : m_Data->m_Stages)
+	Compile();
+	const auto& ctx = m_Data->m_Ctx;
+	auto& frame = m_Data->m_Cmds[ctx->CurrentFrame];
+	ctx->Submitter->WaitForFences({ frame.Fence });
+	ctx->Device.resetFences(frame.Fence);
+	for (auto pool : frame.Pools)
+	{
+		if (pool)
+			ctx->Device.resetCommandPool(pool);
+	}
+
+	Recording recording;
+	for (uint32_t i = 0; i < m_Data->m_Stages.size(); i++)
 	{
-		if (stage.Pipeline) {
-			PipelineType* pipeline = (PipelineType*)stage.Pipeline.get();
-			cmd.bindPipeline(pipeline->BindPoint(), pipeline->Pipeline());
+		auto& stage = m_Data->m_Stages[i];
+		QueueType queue = stage.AsyncCompute ? QueueType::Compute : QueueType::Graphics;
+		if (recording.Segments.empty() || recording.Segments.back().Queue != queue)
+		{
+			if (recording.Segments.size() > 0)
+				_RecordBarriers(recording, nullptr, i);
+			else if (queue == QueueType::Compute)
+				// Releases of resources owned by the graphics queue are recorded here
+				_BeginSegment(recording, QueueType::Graphics);
+			_BeginSegment(recording, queue);
+		}
+
+		// Shares one pipelineBarrier2 with the previous stage's GraphSynchronization
+		_RecordBarriers(recording, &stage, i);
+		auto& segment = recording.Segments.back();
+		auto& profiler = *ctx->Profiler;
+		if (stage.Static)
+		{
+			// The baked commands are replayed, the timestamps go around them
+			uint32_t zone = profiler.IsEnabled() ? profiler.Begin(_OpenCmd(recording, segment), cpp::Format("RenderGraph stage {}", i), queue) : GpuProfiler::InvalidZone;
+			_CloseCmd(segment);
+			segment.Cmds.push_back(_BakeStage(stage, queue));
+			if (zone != GpuProfiler::InvalidZone)
+				profiler.End(_OpenCmd(recording, segment), zone);
+		}
+		else
+		{
+			auto cmd = _OpenCmd(recording, segment);
+			GpuProfiler::Scope zone(&profiler, cmd, cpp::Format("RenderGraph stage {}", i), queue);
+			if (stage.Pipeline) {
+				PipelineType* pipeline = (PipelineType*)stage.Pipeline.get();
+				cmd.bindPipeline(pipeline->BindPoint(), pipeline->Pipeline());
+			}
+			stage.Callback(cmd);
 		}
-		stage.Callback(cmd);
 		if (stage.Synchronization.BarrierCount()) {
 			const auto& dependencyInfo = stage.Synchronization.ReadDependencyInfo();
-			cmd.pipelineBarrier2(dependencyInfo);
+			recording.BufferBarriers.insert(recording.BufferBarriers.end(), dependencyInfo.pBufferMemoryBarriers, dependencyInfo.pBufferMemoryBarriers + dependencyInfo.bufferMemoryBarrierCount);
+			recording.ImageBarriers.insert(recording.ImageBarriers.end(), dependencyInfo.pImageMemoryBarriers, dependencyInfo.pImageMemoryBarriers + dependencyInfo.imageMemoryBarrierCount);
+		}
+	}
+	if (recording.Segments.empty())
+		_BeginSegment(recording, QueueType::Graphics);
+	_RecordBarriers(recording, nullptr, uint32_t(m_Data->m_Stages.size()));
+
+	bool asyncCompute = any_of(recording.Segments.begin(), recording.Segments.end(), [](const Segment& segment) { return segment.Queue == QueueType::Compute; });
+	if (asyncCompute)
+	{
+		// Everything goes back to the graphics queue, the next run (and the fence) starts after the compute work
+		int32_t lastCompute = -1;
+		for (int32_t i = 0; i < int32_t(recording.Segments.size()); i++)
+			lastCompute = recording.Segments[i].Queue == QueueType::Compute ? i : lastCompute;
+		_BeginSegment(recording, QueueType::Graphics);
+		recording.Segments.back().Waits[uint32_t(QueueType::Compute)] = recording.Segments[lastCompute].Value;
+		for (auto& [key, owner] : recording.Owners)
+		{
+			if (owner.Queue == QueueType::Graphics)
+				continue;
+			// Transient contents never outlive the graph, they are discarded at their first stage anyway
+			if (m_Data->m_TransientIndices.count(key) == 0)
+			{
+				_TransferOwnership(recording, key, owner.Access, owner, vk::PipelineStageFlagBits2::eAllCommands,
+					vk::AccessFlagBits2::eMemoryRead | vk::AccessFlagBits2::eMemoryWrite);
+			}
+			m_Data->m_ResourceStates[key] = ResourceState{};
+		}
+		_RecordBarriers(recording, nullptr, uint32_t(m_Data->m_Stages.size()));
+	}
+
+	for (auto& segment : recording.Segments)
+	{
+		if (segment.BufferReleases.size() > 0 || segment.ImageReleases.size() > 0)
+		{
+			vk::DependencyInfo dependency;
+			dependency.setBufferMemoryBarriers(segment.BufferReleases).setImageMemoryBarriers(segment.ImageReleases);
+			_OpenCmd(recording, segment).pipelineBarrier2(dependency);
+		}
+		_CloseCmd(segment);
+	}
+
+	vector<vk::SemaphoreSubmitInfo> externalWaits;
+	for (size_t i = 0; i < m_Data->m_WaitSemaphores.size(); i++) {
+		auto stage = vk::PipelineStageFlags2(VkPipelineStageFlags2(VkPipelineStageFlags(m_Data->m_WaitStages[i])));
+		externalWaits.push_back(vk::SemaphoreSubmitInfo(m_Data->m_WaitSemaphores[i], 0, stage));
+	}
+	m_Data->m_Ctx->FlushUploads();
+	for (size_t i = 0; i < recording.Segments.size(); i++)
+	{
+		const auto& segment = recording.Segments[i];
+		bool last = i + 1 == recording.Segments.size();
+		vector<vk::SemaphoreSubmitInfo> waits = i == 0 ? externalWaits : vector<vk::SemaphoreSubmitInfo>();
+		vector<vk::SemaphoreSubmitInfo> signals;
+		for (uint32_t queue = 0; queue < uint32_t(QueueType::Count); queue++)
+		{
+			if (segment.Waits[queue] > 0)
+				waits.push_back(vk::SemaphoreSubmitInfo(m_Data->m_Timelines[queue], segment.Waits[queue], vk::PipelineStageFlagBits2::eAllCommands));
+		}
+		if (asyncCompute)
+			signals.push_back(vk::SemaphoreSubmitInfo(m_Data->m_Timelines[uint32_t(segment.Queue)], segment.Value, vk::PipelineStageFlagBits2::eAllCommands));
+		if (last && VkSemaphore(m_Data->m_CompletionSemaphore)) {
+			signals.push_back(vk::SemaphoreSubmitInfo(m_Data->m_CompletionSemaphore, 0, vk::PipelineStageFlagBits2::eAllCommands));
+		}
+		// The last segment always runs on the graphics queue after everything else
+		m_Data->m_Ctx->Submitter->Enqueue(segment.Queue, segment.Cmds, waits, signals, last ? frame.Fence : vk::Fence());
+	}
+	return frame.Fence;
+}
+
+void egx::RenderGraph::_BeginSegment(Recording& recording, QueueType queue)
+{
+	if (recording.Segments.size() > 0)
+		_CloseCmd(recording.Segments.back());
+	Segment segment;
+	segment.Queue = queue;
+	if (m_Data->m_Timelines[0])
+		segment.Value = ++m_Data->m_TimelineValues[uint32_t(queue)];
+	recording.Segments.push_back(std::move(segment));
+}
+
+vk::CommandBuffer egx::RenderGraph::_OpenCmd(Recording& recording, Segment& segment)
+{
+	if (segment.Open)
+		return segment.Open;
+	const auto& ctx = m_Data->m_Ctx;
+	auto& frame = m_Data->m_Cmds[ctx->CurrentFrame];
+	auto& cmds = frame.Cmds[uint32_t(segment.Queue)];
+	uint32_t index = recording.CmdCount[uint32_t(segment.Queue)]++;
+	if (index >= cmds.size())
+	{
+		auto cmd = ctx->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(frame.Pools[uint32_t(segment.Queue)]).setCommandBufferCount(1));
+		cmds.push_back(cmd[0]);
+	}
+	segment.Open = cmds[index];
+	segment.Open.begin(vk::CommandBufferBeginInfo());
+	segment.Cmds.push_back(segment.Open);
+	return segment.Open;
+}
+
+void egx::RenderGraph::_CloseCmd(Segment& segment)
+{
+	if (!segment.Open)
+		return;
+	segment.Open.end();
+	segment.Open = nullptr;
+}
+
+vector<uint64_t> egx::RenderGraph::_StageKeys(const Stage& stage) const
+{
+	vector<uint64_t> keys;
+	if (stage.Pipeline)
+		keys.push_back(uint64_t(VkPipeline(((PipelineType*)stage.Pipeline.get())->Pipeline())));
+	for (auto& access : stage.Resources.Accesses())
+		keys.push_back(ResourceKey(access));
+	return keys;
+}
+
+vk::CommandBuffer egx::RenderGraph::_BakeStage(Stage& stage, QueueType queue)
+{
+	const auto& ctx = m_Data->m_Ctx;
+	auto& baked = stage.Baked[ctx->CurrentFrame];
+	auto keys = _StageKeys(stage);
+	if (baked.Valid && baked.Keys == keys)
+		return baked.Cmd;
+
+	// The frame slot's fence was waited on by RunAsync(), the previous recording is no longer in use
+	if (!baked.Cmd)
+	{
+		auto& pool = m_Data->m_Cmds[ctx->CurrentFrame].BakedPools[uint32_t(queue)];
+		if (!pool)
+		{
+			uint32_t family = queue == QueueType::Compute ? ctx->ComputeQueueFamilyIndex : ctx->GraphicsQueueFamilyIndex;
+			pool = ctx->Device.createCommandPool(vk::CommandPoolCreateInfo(vk::CommandPoolCreateFlagBits::eResetCommandBuffer, family));
+		}
+		baked.Cmd = ctx->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(pool).setCommandBufferCount(1))[0];
+	}
+	baked.Cmd.begin(vk::CommandBufferBeginInfo());
+	if (stage.Pipeline) {
+		PipelineType* pipeline = (PipelineType*)stage.Pipeline.get();
+		baked.Cmd.bindPipeline(pipeline->BindPoint(), pipeline->Pipeline());
+	}
+	stage.Callback(baked.Cmd);
+	baked.Cmd.end();
+	baked.Valid = true;
+	baked.Keys = std::move(keys);
+	return baked.Cmd;
+}
+
+int32_t egx::RenderGraph::_WaitForOwner(Recording& recording, const Ownership& owner)
+{
+	auto& current = recording.Segments.back();
+	int32_t segment = owner.Segment;
+	if (segment < 0)
+	{
+		// Used before the graph, the latest segment of the owning queue follows that work in queue order
+		for (int32_t i = int32_t(recording.Segments.size()) - 1; i >= 0; i--)
+		{
+			if (recording.Segments[i].Queue == owner.Queue)
+			{
+				segment = i;
+				break;
+			}
 		}
 	}
-	cmd.end();
-	auto submitInfo = vk::SubmitInfo();
-	submitInfo.setCommandBuffers(cmd);
-	if (VkSemaphore(m_Data->m_CompletionSemaphore)) {
-		submitInfo.setSignalSemaphores(m_Data->m_CompletionSemaphore);
+	if (owner.Queue != current.Queue && segment >= 0)
+	{
+		auto& wait = current.Waits[uint32_t(owner.Queue)];
+		wait = std::max(wait, recording.Segments[segment].Value);
+	}
+	return segment;
+}
+
+void egx::RenderGraph::_TransferOwnership(Recording& recording, uint64_t key, const ResourceAccess& access, const Ownership& owner,
+	vk::PipelineStageFlags2 dstStages, vk::AccessFlags2 dstAccess)
+{
+	const auto& ctx = m_Data->m_Ctx;
+	auto familyOf = [&](QueueType queue) { return uint32_t(queue == QueueType::Compute ? ctx->ComputeQueueFamilyIndex : ctx->GraphicsQueueFamilyIndex); };
+	int32_t segment = _WaitForOwner(recording, owner);
+	uint32_t srcFamily = familyOf(owner.Queue);
+	uint32_t dstFamily = familyOf(recording.Segments.back().Queue);
+	if (segment < 0 || srcFamily == dstFamily)
+		return;
+
+	// Release on the owning queue, acquire on this one, the semaphore wait orders them
+	auto& release = recording.Segments[segment];
+	const auto& state = m_Data->m_ResourceStates[key];
+	auto srcStages = state.WriteStages | state.ReadStages;
+	if (access.BufferResource)
+	{
+		auto buffer = access.BufferResource->GetHandle();
+		release.BufferReleases.push_back(vk::BufferMemoryBarrier2(srcStages, state.WriteAccess, {}, {}, srcFamily, dstFamily, buffer, 0, VK_WHOLE_SIZE));
+		recording.BufferBarriers.push_back(vk::BufferMemoryBarrier2({}, {}, dstStages, dstAccess, srcFamily, dstFamily, buffer, 0, VK_WHOLE_SIZE));
+	}
+	else
+	{
+		const auto& image = *access.ImageResource;
+		vk::ImageSubresourceRange range(GetFormatAspectFlags(image.Format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS);
+		release.ImageReleases.push_back(vk::ImageMemoryBarrier2(srcStages, state.WriteAccess, {}, {},
+			image.CurrentLayout, image.CurrentLayout, srcFamily, dstFamily, image.GetHandle(), range));
+		recording.ImageBarriers.push_back(vk::ImageMemoryBarrier2({}, {}, dstStages, dstAccess,
+			image.CurrentLayout, image.CurrentLayout, srcFamily, dstFamily, image.GetHandle(), range));
+	}
+}
+
+void egx::RenderGraph::_RecordBarriers(Recording& recording, const Stage* pStage, uint32_t stageIndex)
+{
+	auto& bufferBarriers = recording.BufferBarriers;
+	auto& imageBarriers = recording.ImageBarriers;
+	if (pStage)
+	{
+		const QueueType queue = recording.Segments.back().Queue;
+		const int32_t segment = int32_t(recording.Segments.size()) - 1;
+		// A resource used several ways by the stage gets a single barrier
+		vector<pair<uint64_t, ResourceAccess>> accesses;
+		for (auto& access : pStage->Resources.Accesses())
+		{
+			uint64_t key = ResourceKey(access);
+			auto stages = access.Stages ? access.Stages : pStage->ShaderStages;
+			auto merged = find_if(accesses.begin(), accesses.end(), [key](const auto& entry) { return entry.first == key; });
+			if (merged == accesses.end())
+			{
+				accesses.push_back({ key, access });
+				accesses.back().second.Stages = stages;
+				continue;
+			}
+			merged->second.Stages |= stages;
+			merged->second.Access |= access.Access;
+			merged->second.Write |= access.Write;
+		}
+
+		for (auto& [key, access] : accesses)
+		{
+			auto transient = m_Data->m_TransientIndices.find(key);
+			if (transient != m_Data->m_TransientIndices.end() && m_Data->m_Transients[transient->second].FirstStage == stageIndex)
+			{
+				// Aliasing barrier, waits for every transient sharing the memory (including this one from the previous run)
+				// and discards the contents
+				const auto& resource = m_Data->m_Transients[transient->second];
+				vk::PipelineStageFlags2 srcStages;
+				vk::AccessFlags2 srcAccess;
+				for (auto& other : m_Data->m_Transients)
+				{
+					bool memoryOverlap = other.Heap == resource.Heap && other.IsImage == resource.IsImage &&
+						other.Offset < resource.Offset + resource.Requirements.size && resource.Offset < other.Offset + other.Requirements.size;
+					auto otherState = m_Data->m_ResourceStates.find(other.Key);
+					if (!memoryOverlap || otherState == m_Data->m_ResourceStates.end())
+						continue;
+					auto otherOwner = recording.Owners.find(other.Key);
+					if (otherOwner != recording.Owners.end() ? otherOwner->second.Queue != queue : queue != QueueType::Graphics)
+					{
+						// Last used by the other queue, its semaphore orders the accesses
+						_WaitForOwner(recording, otherOwner != recording.Owners.end() ? otherOwner->second : Ownership());
+						continue;
+					}
+					srcStages |= otherState->second.WriteStages | otherState->second.ReadStages;
+					srcAccess |= otherState->second.WriteAccess;
+				}
+				m_Data->m_ResourceStates[key] = access.Write ? ResourceState{ access.Stages, access.Access & WriteAccessMask } : ResourceState{ {}, {}, access.Stages };
+				recording.Owners[key] = Ownership{ queue, segment, access };
+
+				if (access.BufferResource)
+				{
+					if (!srcStages)
+						continue;
+					bufferBarriers.push_back(vk::BufferMemoryBarrier2(srcStages, srcAccess, access.Stages, access.Access,
+						VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, access.BufferResource->GetHandle(), 0, VK_WHOLE_SIZE));
+				}
+				else
+				{
+					const auto& image = *access.ImageResource;
+					imageBarriers.push_back(vk::ImageMemoryBarrier2(srcStages, srcAccess, access.Stages, access.Access,
+						vk::ImageLayout::eUndefined, image.CurrentLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image.GetHandle(),
+						vk::ImageSubresourceRange(GetFormatAspectFlags(image.Format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS)));
+				}
+				continue;
+			}
+
+			auto& owner = recording.Owners[key];
+			if (owner.Queue != queue)
+			{
+				_TransferOwnership(recording, key, access, owner, access.Stages, access.Access);
+				m_Data->m_ResourceStates[key] = ResourceState{};
+			}
+			owner = Ownership{ queue, segment, access };
+
+			auto& state = m_Data->m_ResourceStates[key];
+			vk::PipelineStageFlags2 srcStages;
+			vk::AccessFlags2 srcAccess;
+			if (access.Write)
+			{
+				// Waits for the last write (WAW) and the reads since (WAR, execution dependency only)
+				srcStages = state.WriteStages | state.ReadStages;
+				srcAccess = state.WriteAccess;
+				state = ResourceState{ access.Stages, access.Access & WriteAccessMask };
+			}
+			else
+			{
+				bool visible = !(access.Stages & ~state.VisibleStages) && !(access.Access & ~state.VisibleAccess);
+				state.ReadStages |= access.Stages;
+				// Reads after reads, or the write is already visible to these stages
+				if (!state.WriteStages || visible)
+					continue;
+				srcStages = state.WriteStages;
+				srcAccess = state.WriteAccess;
+				state.VisibleStages |= access.Stages;
+				state.VisibleAccess |= access.Access;
+			}
+			if (!srcStages)
+				continue;
+
+			if (access.BufferResource)
+			{
+				bufferBarriers.push_back(vk::BufferMemoryBarrier2(srcStages, srcAccess, access.Stages, access.Access,
+					VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, access.BufferResource->GetHandle(), 0, VK_WHOLE_SIZE));
+			}
+			else
+			{
+				const auto& image = *access.ImageResource;
+				imageBarriers.push_back(vk::ImageMemoryBarrier2(srcStages, srcAccess, access.Stages, access.Access,
+					image.CurrentLayout, image.CurrentLayout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image.GetHandle(),
+					vk::ImageSubresourceRange(GetFormatAspectFlags(image.Format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS)));
+			}
+		}
 	}
-	queue.submit(submitInfo, fence);
-	return fence;
+
+	if (bufferBarriers.empty() && imageBarriers.empty())
+		return;
+	vk::DependencyInfo dependency;
+	dependency.setBufferMemoryBarriers(bufferBarriers).setImageMemoryBarriers(imageBarriers);
+	_OpenCmd(recording, recording.Segments.back()).pipelineBarrier2(dependency);
+	bufferBarriers.clear();
+	imageBarriers.clear();
 }
 
 RenderGraph::DataWrapper::~DataWrapper()
 {
-	m_Ctx->Device.destroyDescriptorPool(m_DescriptorPool);
-	for (auto& [pool, cmd, fence] : m_Cmds)
+	if (m_Transients.size() > 0)
 	{
-		m_Ctx->Device.destroyFence(fence);
-		m_Ctx->Device.destroyCommandPool(pool);
+		// The transients are not reference counted and share heaps, the last run must be done with them
+		vector<vk::Fence> fences;
+		for (auto& frame : m_Cmds)
+			fences.push_back(frame.Fence);
+		m_Ctx->Submitter->WaitForFences(fences);
+		for (auto& transient : m_Transients)
+		{
+			if (transient.IsImage)
+				m_Ctx->Device.destroyImage(vk::Image(VkImage(transient.Key)));
+			else
+				m_Ctx->Device.destroyBuffer(vk::Buffer(VkBuffer(transient.Key)));
+		}
+		for (auto allocation : m_TransientHeaps)
+		{
+			m_Ctx->Telemetry->Unregister(allocation);
+			vmaFreeMemory(m_Ctx->Allocator, allocation);
+		}
 	}
+	// The descriptors free their sets from the pool, they must be queued before the pool
+	m_Descriptors.clear();
+	// Recorded runs may still be in the submitter's batch or executing
+	m_Ctx->Deletion->Push([device = m_Ctx->Device, descriptorPool = m_DescriptorPool, cmds = m_Cmds, timelines = m_Timelines] {
+		device.destroyDescriptorPool(descriptorPool);
+		for (auto& frame : cmds)
+		{
+			device.destroyFence(frame.Fence);
+			for (auto pool : frame.Pools)
+			{
+				if (pool)
+					device.destroyCommandPool(pool);
+			}
+			for (auto pool : frame.BakedPools)
+			{
+				if (pool)
+					device.destroyCommandPool(pool);
+			}
+		}
+		for (auto timeline : timelines)
+		{
+			if (timeline)
+				device.destroySemaphore(timeline);
+		}
+	});
 }
 
 ResourceDescriptor egx::RenderGraph::CreateResourceDescriptor(const PipelineType& pipeline)
@@ -1,9 +1,14 @@
 #pragma once
 #include <core/egx.hpp>
+#include <core/FrameScheduler.hpp>
 #include <memory/egximage.hpp>
+#include <memory/egxframearena.hpp>
+#include <memory/formatsize.hpp>
 #include "pipeline.hpp"
 #include "shaders/shader.hpp"
 #include <functional>
+#include <optional>
+#include <unordered_map>
 
 namespace egx
 {
@@ -19,6 +24,19 @@ namespace egx
 		std::shared_ptr<vk::DescriptorPool> m_Pool;
 	};
 
+	/// <summary>
+	/// A buffer or image access of a RenderGraph stage.
+	/// </summary>
+	struct ResourceAccess
+	{
+		std::optional<Buffer> BufferResource;
+		std::optional<Image2D> ImageResource;
+		// eNone uses the shader stages of the stage's pipeline
+		vk::PipelineStageFlags2 Stages = vk::PipelineStageFlagBits2::eNone;
+		vk::AccessFlags2 Access;
+		bool Write = false;
+	};
+
 	class ResourceDescriptor
 	{
 	public:
@@ -29,7 +47,14 @@ namespace egx
 		ResourceDescriptor& SetInput(int setId, int bindingId, const Buffer& buffer);
 		ResourceDescriptor& SetInput(int setId, int bindingId, vk::ImageLayout layout, int viewId, const Image2D& image, vk::Sampler sampler = {});
 
+		/// <summary>
+		/// Binds every frame's arena buffer, range is the size visible through one dynamic offset
+		/// (0 uses the size from the shader reflection).
+		/// </summary>
+		ResourceDescriptor& SetInput(int setId, int bindingId, const FrameArena& arena, vk::DeviceSize range = 0);
+
 		ResourceDescriptor& SetInput(int bindingId, const Buffer& buffer) { return SetInput(0, bindingId, buffer); }
+		ResourceDescriptor& SetInput(int bindingId, const FrameArena& arena, vk::DeviceSize range = 0) { return SetInput(0, bindingId, arena, range); }
 		ResourceDescriptor& SetInput(int bindingId, vk::ImageLayout layout, int viewId, const Image2D& image, vk::Sampler sampler = {})
 		{
 			return SetInput(0, bindingId, layout, viewId, image, sampler);
@@ -37,10 +62,38 @@ namespace egx
 
 		void SetBufferOffset(int setId, int bindingId, uint32_t offset);
 		void SetBufferOffset(int bindingId, uint32_t offset) { SetBufferOffset(0, bindingId, offset); }
+		void SetBufferOffset(int setId, int bindingId, const FrameAllocation& allocation) { SetBufferOffset(setId, bindingId, (uint32_t)allocation.Offset); }
+		void SetBufferOffset(int bindingId, const FrameAllocation& allocation) { SetBufferOffset(0, bindingId, (uint32_t)allocation.Offset); }
 
 		void Bind(vk::CommandBuffer cmd);
 
+		/// <summary>
+		/// Accesses of the bound buffers and images inferred from the pipeline's reflection,
+		/// storage buffers/images not declared readonly are writes. Frame arenas are host written and not listed.
+		/// </summary>
+		std::vector<ResourceAccess> EnumerateAccesses() const;
+
 	private:
+		// Descriptor writes are deferred to Bind() of each frame so sets still used by frames in flight are never updated.
+		// A binding is rewritten whenever its handle changed (resize, defragmentation) since the frame's set was written.
+		struct BoundResource
+		{
+			vk::DescriptorType Type;
+			std::optional<Buffer> BufferResource;
+			std::optional<FrameArena> ArenaResource;
+			std::optional<Image2D> ImageResource;
+			vk::DeviceSize Range = 0;
+			vk::ImageLayout Layout = vk::ImageLayout::eUndefined;
+			int ViewId = 0;
+			vk::Sampler Sampler;
+			// Handle written into each frame's set, null until the first write
+			std::vector<uint64_t> WrittenHandles;
+		};
+
+		ResourceDescriptor& _SetInput(int setId, int bindingId, BoundResource resource);
+		void _AllocateSets(vk::DescriptorPool pool, const PipelineType& pipeline);
+		void _UpdateSets(uint32_t frame);
+
 		struct DataWrapper
 		{
 			DeviceCtx m_Ctx;
@@ -49,6 +102,8 @@ namespace egx
 			std::unique_ptr<PipelineType> m_Pipeline;
 			// [frame, [set id, set]]
 			std::map<uint32_t, std::map<uint32_t, vk::DescriptorSet>> m_Sets;
+			// [set id, [binding id, resource]]
+			std::map<uint32_t, std::map<uint32_t, BoundResource>> m_Bindings;
 			std::map<uint32_t, std::map<uint32_t, uint32_t>> m_OffsetMapping;
 			std::vector<uint32_t> m_Offsets;
 
@@ -64,7 +119,7 @@ namespace egx
 
 	/*
 		Features:
-		1) Allow for prebaked command buffers
+		1) Allow for prebaked command buffers (done, MakeStatic())
 			- Also allow the possability for seperate buffers to allow for static and dynamic buffers
 		2) Manage Dependencies between stages
 		3) Integrate RenderGraph with other graphs
@@ -98,9 +153,9 @@ namespace egx
 			barrier.setDstAccessMask(dstAccess)
 				.setSrcAccessMask(srcAccess)
 				.setSrcStageMask(srcStage)
-				.setDstStageMask(dstStage)
-				.setImage(image.GetHandle());
+				.setDstStageMask(dstStage);
 			m_ImageBarriers.push_back(barrier);
+			m_Images.push_back(image);
 			return *this;
 		}
 
@@ -110,6 +165,15 @@ namespace egx
 			{
 				m_BufferBarriers[i].setBuffer(m_Buffers[i].GetHandle());
 			}
+			// Handles are resolved late, resources may have been relocated since Add()
+			for (auto i = 0ull; i < m_ImageBarriers.size(); i++)
+			{
+				const auto& image = m_Images[i];
+				m_ImageBarriers[i].setImage(image.GetHandle())
+					.setOldLayout(image.CurrentLayout)
+					.setNewLayout(image.CurrentLayout)
+					.setSubresourceRange(vk::ImageSubresourceRange(GetFormatAspectFlags(image.Format), 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS));
+			}
 			m_Dependency.setBufferMemoryBarriers(m_BufferBarriers).setImageMemoryBarriers(m_ImageBarriers);
 			return m_Dependency;
 		}
@@ -118,11 +182,82 @@ namespace egx
 
 	private:
 		std::vector<Buffer> m_Buffers;
+		std::vector<Image2D> m_Images;
 		std::vector<vk::BufferMemoryBarrier2> m_BufferBarriers;
 		std::vector<vk::ImageMemoryBarrier2> m_ImageBarriers;
 		vk::DependencyInfo m_Dependency;
 	};
 
+	/// <summary>
+	/// Reads and writes of a RenderGraph stage, either declared or inferred from a ResourceDescriptor.
+	/// </summary>
+	class StageResources
+	{
+	public:
+		StageResources& Read(const Buffer& buffer, vk::AccessFlags2 access = vk::AccessFlagBits2::eShaderStorageRead,
+			vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eNone)
+		{
+			m_Accesses.push_back({ buffer, std::nullopt, stages, access, false });
+			return *this;
+		}
+
+		StageResources& Write(const Buffer& buffer, vk::AccessFlags2 access = vk::AccessFlagBits2::eShaderStorageWrite,
+			vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eNone)
+		{
+			m_Accesses.push_back({ buffer, std::nullopt, stages, access, true });
+			return *this;
+		}
+
+		/// <summary>
+		/// Images stay in their CurrentLayout, the graph only orders the memory accesses.
+		/// </summary>
+		StageResources& Read(const Image2D& image, vk::AccessFlags2 access = vk::AccessFlagBits2::eShaderSampledRead,
+			vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eNone)
+		{
+			m_Accesses.push_back({ std::nullopt, image, stages, access, false });
+			return *this;
+		}
+
+		StageResources& Write(const Image2D& image, vk::AccessFlags2 access = vk::AccessFlagBits2::eShaderStorageWrite,
+			vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eNone)
+		{
+			m_Accesses.push_back({ std::nullopt, image, stages, access, true });
+			return *this;
+		}
+
+		/// <summary>
+		/// Declares everything bound to the descriptor (see ResourceDescriptor::EnumerateAccesses()),
+		/// the bindings are read when the graph runs.
+		/// </summary>
+		StageResources& Use(const ResourceDescriptor& descriptor)
+		{
+			m_Descriptors.push_back(descriptor);
+			return *this;
+		}
+
+		std::vector<ResourceAccess> Accesses() const
+		{
+			std::vector<ResourceAccess> accesses = m_Accesses;
+			for (const auto& descriptor : m_Descriptors)
+			{
+				auto inferred = descriptor.EnumerateAccesses();
+				accesses.insert(accesses.end(), inferred.begin(), inferred.end());
+			}
+			return accesses;
+		}
+
+	private:
+		std::vector<ResourceAccess> m_Accesses;
+		std::vector<ResourceDescriptor> m_Descriptors;
+	};
+
+	/// <summary>
+	/// Stages run in the order they were added. Barriers between stages are inferred from the declared
+	/// StageResources: a stage only waits on earlier writes (and a write on earlier reads) of the resources
+	/// it uses, and all barriers needed before a stage are issued as one pipelineBarrier2. Resource states
+	/// carry over between runs so the first stage also synchronizes with the previous run.
+	/// GraphSynchronization barriers are still issued after their stage, merged with the next stage's barriers.
+	/// </summary>
 	class RenderGraph
 	{
 	public:
@@ -132,7 +267,65 @@ namespace egx
 			const std::function<void(vk::CommandBuffer)>& stageCallback,
 			const GraphSynchronization& synchronization = {});
 
+		RenderGraph& Add(const PipelineType& pipeline,
+			const std::function<void(vk::CommandBuffer)>& stageCallback,
+			const StageResources& resources,
+			const GraphSynchronization& synchronization = {});
+
+		/// <summary>
+		/// Records the stage on the dedicated compute queue, it overlaps the graphics stages it shares no declared resources with.
+		/// Consecutive async stages share one submission, the graph waits on the other queue's timeline and transfers queue
+		/// ownership only for resources used by both queues, so everything the stage touches must be declared in resources.
+		/// Resources return to the graphics queue at the end of the graph. Without a dedicated compute queue or timeline
+		/// semaphores the stage runs on the graphics queue.
+		/// </summary>
+		RenderGraph& AddAsyncCompute(const ComputePipeline& pipeline,
+			const std::function<void(vk::CommandBuffer)>& stageCallback,
+			const StageResources& resources,
+			const GraphSynchronization& synchronization = {});
+
+		/// <summary>
+		/// Marks the last added stage as static, its callback is recorded once per frame slot into its own command buffer
+		/// and replayed until the stage is invalidated. The barriers around it are still derived every run.
+		/// A stage is re-recorded by itself when its pipeline or the handle of a declared resource changed (e.g. Buffer::Resize()),
+		/// anything else the callback captures (descriptor contents, push constants, draw counts) needs an Invalidate() call.
+		/// </summary>
+		RenderGraph& MakeStatic();
+
+		/// <summary>
+		/// Re-records static stages the next time they run, stageIndex counts the Add() calls.
+		/// </summary>
+		void InvalidateStage(uint32_t stageIndex);
+		void Invalidate(const Buffer& buffer);
+		void Invalidate(const Image2D& image);
+		void Invalidate();
+
 		ResourceDescriptor CreateResourceDescriptor(const PipelineType& pipeline);
+
+		/// <summary>
+		/// Declares a device only buffer that lives only while the graph runs. Compile() binds its memory, which is shared
+		/// with transients whose lifetimes (first to last stage declaring them in StageResources) do not overlap.
+		/// The contents are undefined at the first stage using it.
+		/// </summary>
+		Buffer CreateTransientBuffer(size_t size, vk::BufferUsageFlags usage);
+
+		/// <summary>
+		/// See CreateTransientBuffer(), the image is transitioned from eUndefined to layout at its first stage and must
+		/// stay in that layout for the rest of the graph. Views can only be created after Compile().
+		/// </summary>
+		Image2D CreateTransientImage(int width, int height, vk::Format format, vk::ImageUsageFlags usage, vk::ImageLayout layout);
+
+		/// <summary>
+		/// Computes the transient lifetimes and places them into shared memory blocks, called by RunAsync() when needed.
+		/// Stages and transients cannot be added once transients were placed.
+		/// </summary>
+		void Compile();
+
+		/// <summary>
+		/// Bytes of device memory backing the transients, 0 before Compile().
+		/// </summary>
+		vk::DeviceSize TransientMemorySize() const;
+
 		vk::Fence RunAsync();
 		void Run();
 
@@ -154,19 +347,128 @@ namespace egx
 			std::unique_ptr<IUniqueHandle> Pipeline;
 			std::function<void(vk::CommandBuffer)> Callback;
 			GraphSynchronization Synchronization;
+			StageResources Resources;
+			// Pipeline stages of the pipeline's shaders, used by accesses that do not name their stages
+			vk::PipelineStageFlags2 ShaderStages;
+			bool AsyncCompute = false;
+			bool Static = false;
+
+			// Command buffer of a static stage for one frame slot
+			struct BakedCommands
+			{
+				vk::CommandBuffer Cmd;
+				bool Valid = false;
+				// Pipeline and resource handles the commands were recorded with
+				std::vector<uint64_t> Keys;
+			};
+			std::vector<BakedCommands> Baked;
+		};
+
+		// Outstanding hazards of a resource at the end of the recorded stages
+		struct ResourceState
+		{
+			vk::PipelineStageFlags2 WriteStages;
+			vk::AccessFlags2 WriteAccess;
+			// Reads since the last write, a following write must wait for them
+			vk::PipelineStageFlags2 ReadStages;
+			// Stages/accesses the last write was already made visible to
+			vk::PipelineStageFlags2 VisibleStages;
+			vk::AccessFlags2 VisibleAccess;
+		};
+
+		// Resource created by CreateTransientBuffer()/CreateTransientImage()
+		struct Transient
+		{
+			uint64_t Key;
+			bool IsImage;
+			vk::MemoryRequirements Requirements;
+			// Lifetime in stage indices, [FirstStage, LastStage]
+			uint32_t FirstStage = UINT32_MAX;
+			uint32_t LastStage = 0;
+			uint32_t Heap = 0;
+			vk::DeviceSize Offset = 0;
+		};
+
+		// Consecutive stages recorded for the same queue
+		struct Segment
+		{
+			QueueType Queue;
+			// Submitted in order, static stages add their baked command buffers between the graph's own
+			std::vector<vk::CommandBuffer> Cmds;
+			// Graph command buffer being recorded, null after a static stage until something is recorded again
+			vk::CommandBuffer Open;
+			// Value the segment signals on the graph's timeline of its queue
+			uint64_t Value = 0;
+			// Timeline values of the other queue the segment waits for
+			std::array<uint64_t, uint32_t(QueueType::Count)> Waits{};
+			// Queue ownership releases recorded at the end of the segment
+			std::vector<vk::BufferMemoryBarrier2> BufferReleases;
+			std::vector<vk::ImageMemoryBarrier2> ImageReleases;
 		};
 
+		// Queue (and segment, -1 before the graph) that last used a resource
+		struct Ownership
+		{
+			QueueType Queue = QueueType::Graphics;
+			int32_t Segment = -1;
+			ResourceAccess Access;
+		};
+
+		struct Recording
+		{
+			std::vector<Segment> Segments;
+			// [handle, owner]
+			std::unordered_map<uint64_t, Ownership> Owners;
+			std::vector<vk::BufferMemoryBarrier2> BufferBarriers;
+			std::vector<vk::ImageMemoryBarrier2> ImageBarriers;
+			// Graph command buffers used per queue
+			std::array<uint32_t, uint32_t(QueueType::Count)> CmdCount{};
+		};
+
+		void _BeginSegment(Recording& recording, QueueType queue);
+		vk::CommandBuffer _OpenCmd(Recording& recording, Segment& segment);
+		void _CloseCmd(Segment& segment);
+		vk::CommandBuffer _BakeStage(Stage& stage, QueueType queue);
+		std::vector<uint64_t> _StageKeys(const Stage& stage) const;
+		void _RecordBarriers(Recording& recording, const Stage* pStage, uint32_t stageIndex);
+		int32_t _WaitForOwner(Recording& recording, const Ownership& owner);
+		void _TransferOwnership(Recording& recording, uint64_t key, const ResourceAccess& access, const Ownership& owner,
+			vk::PipelineStageFlags2 dstStages, vk::AccessFlags2 dstAccess);
+		bool _AsyncComputeSupported() const;
+		void _AddTransient(uint64_t key, bool isImage, const vk::MemoryRequirements& requirements);
+
 		struct DataWrapper
 		{
 			DeviceCtx m_Ctx;
 			vk::DescriptorPool m_DescriptorPool;
 			std::map<uint32_t, ResourceDescriptor> m_Descriptors;
 			std::vector<Stage> m_Stages;
-			std::vector<std::tuple<vk::CommandPool, vk::CommandBuffer, vk::Fence>> m_Cmds;
+			struct FrameCommands
+			{
+				// The compute pool is only created for async compute stages
+				std::array<vk::CommandPool, uint32_t(QueueType::Count)> Pools;
+				// Never reset as a whole, static stages re-record their command buffers individually
+				std::array<vk::CommandPool, uint32_t(QueueType::Count)> BakedPools;
+				std::array<std::vector<vk::CommandBuffer>, uint32_t(QueueType::Count)> Cmds;
+				vk::Fence Fence;
+			};
+			std::vector<FrameCommands> m_Cmds;
+			// One timeline per queue, created by the first async compute stage
+			std::array<vk::Semaphore, uint32_t(QueueType::Count)> m_Timelines;
+			std::array<uint64_t, uint32_t(QueueType::Count)> m_TimelineValues{};
 			vk::Semaphore m_CompletionSemaphore;
 			// ASSERT(length(m_WaitSemaphores) == length(m_WaitStages))
 			std::vector<vk::Semaphore> m_WaitSemaphores;
 			std::vector<vk::PipelineStageFlags> m_WaitStages;
+			// [handle, state]
+			std::unordered_map<uint64_t, ResourceState> m_ResourceStates;
+			std::vector<Transient> m_Transients;
+			// [handle, index into m_Transients]
+			std::unordered_map<uint64_t, uint32_t> m_TransientIndices;
+			// Memory blocks shared by the transients, images and buffers never share a block
+			std::vector<VmaAllocation> m_TransientHeaps;
+			vk::DeviceSize m_TransientMemorySize = 0;
+			bool m_Compiled = false;
 
 			DataWrapper() = default;
 			DataWrapper(DataWrapper&) = delete;
@@ -1,24 +1,32 @@
 #include "pipeline.hpp"
 #include <vector>
 #include "pipeline.hpp"
+#include <core/DeletionQueue.hpp>
+#include "PersistentPipelineCache.hpp"
 
 using namespace std;
 using namespace egx;
 using namespace vk;
 
+// Frames in flight may still execute the pipeline, the layout is released (and destroyed when unused) afterwards
+static void DeferDestroyPipeline(const DeviceCtx& ctx, vk::Pipeline pipeline, const SharedPipelineLayout& layout)
+{
+	ctx->Deletion->Push([device = ctx->Device, pipeline, layout] {
+		device.destroyPipeline(pipeline);
+	});
+}
+
 egx::ComputePipeline::ComputePipeline(const DeviceCtx& pCtx, const Shader& computeShader)
 {
 	m_Data = make_shared<ComputePipeline::DataWrapper>();
 	m_Data->m_Ctx = pCtx;
-	m_Data->m_SetLayouts = Shader::CreateDescriptorSetLayouts({ computeShader });
 	m_Data->m_Reflection = computeShader.Reflection();
 	auto pushblock = Shader::GetPushconstants({ computeShader });
 	const vk::SpecializationInfo specialConstants = vk::SpecializationInfo(computeShader.GetSpecializationConstants());
-	auto scalarSetLayouts = Shader::GetDescriptorSetLayoutsAsScalar(m_Data->m_SetLayouts);
 
-	vk::PipelineLayoutCreateInfo createInfo;
-	createInfo.setSetLayouts(scalarSetLayouts).setPushConstantRanges(pushblock);
-	m_Data->m_Layout = pCtx->Device.createPipelineLayout(createInfo);
+	m_Data->m_SharedLayout = pCtx->Layouts->GetPipelineLayout(Shader::CreateDescriptorSetLayouts({ computeShader }), pushblock);
+	m_Data->m_SetLayouts = m_Data->m_SharedLayout->GetSetLayouts();
+	m_Data->m_Layout = m_Data->m_SharedLayout->Layout;
 
 	vk::ComputePipelineCreateInfo computeCreateInfo;
 	computeCreateInfo.stage.setStage(vk::ShaderStageFlagBits::eCompute)
@@ -26,17 +34,14 @@ egx::ComputePipeline::ComputePipeline(const DeviceCtx& pCtx, const Shader& compu
 		.setPSpecializationInfo(&specialConstants)
 		.setPName("main");
 	computeCreateInfo.setLayout(m_Data->m_Layout);
-	m_Data->m_Pipeline = pCtx->Device.createComputePipeline(nullptr, computeCreateInfo).value;
+	m_Data->m_Pipeline = pCtx->Device.createComputePipeline(pCtx->PipelineCache->GetHandle(), computeCreateInfo).value;
 }
 
 egx::ComputePipeline::DataWrapper::~DataWrapper()
 {
 	if (m_Ctx && m_Pipeline)
 	{
-		for (auto& [id, setLayout] : m_SetLayouts)
-			m_Ctx->Device.destroyDescriptorSetLayout(setLayout);
-		m_Ctx->Device.destroyPipelineLayout(m_Layout);
-		m_Ctx->Device.destroyPipeline(m_Pipeline);
+		DeferDestroyPipeline(m_Ctx, m_Pipeline, m_SharedLayout);
 	}
 }
 
@@ -58,23 +63,28 @@ egx::IGraphicsPipeline::IGraphicsPipeline(const DeviceCtx& pCtx, const Shader& v
 			continue;
 		m_Data->m_BlendStates[id] = DefaultBlendingPreset();
 	}
-	if (rt.GetSwapChain().IsValid())
-		rt.GetSwapChain().AddResizeCallback(reinterpret_cast<IUniqueWithCallback*>(this), nullptr);
+	if (rt.GetSwapChain().IsValid()) {
+		// Weak, a replaced pipeline is neither kept alive nor rebuilt by resizes and unregisters in ~DataWrapper
+		m_Data->m_ResizeSwapchain = rt.GetSwapChain();
+		m_Data->m_ResizeCallback = m_Data->m_ResizeSwapchain.AddResizeCallback([weakData = weak_ptr<DataWrapper>(m_Data)] {
+			IGraphicsPipeline pipeline;
+			pipeline.m_Data = weakData.lock();
+			if (pipeline.m_Data)
+				pipeline.Invalidate();
+		});
+	}
 }
 
 void egx::IGraphicsPipeline::Invalidate()
 {
 	m_Data->Reinvalidate();
 	auto Specification = m_Data->m_Specification;
-	// Create descriptor set layout
-	m_Data->m_SetLayouts = Shader::CreateDescriptorSetLayouts({ m_Data->m_Vertex,m_Data->m_Fragment });
-	auto scalarSetLayouts = Shader::GetDescriptorSetLayoutsAsScalar(m_Data->m_SetLayouts);
+	// Descriptor set and pipeline layouts are shared with every pipeline using the same bindings
 	auto pushblock = Shader::GetPushconstants({ m_Data->m_Vertex, m_Data->m_Fragment });
-	// Create pipeline layout
-	vk::PipelineLayoutCreateInfo layoutCreateInfo;
-	layoutCreateInfo.setSetLayouts(scalarSetLayouts)
-		.setPushConstantRanges(pushblock);
-	m_Data->m_Layout = m_Data->m_Ctx->Device.createPipelineLayout(layoutCreateInfo);
+	m_Data->m_SharedLayout = m_Data->m_Ctx->Layouts->GetPipelineLayout(
+		Shader::CreateDescriptorSetLayouts({ m_Data->m_Vertex, m_Data->m_Fragment }), pushblock);
+	m_Data->m_SetLayouts = m_Data->m_SharedLayout->GetSetLayouts();
+	m_Data->m_Layout = m_Data->m_SharedLayout->Layout;
 
 	GraphicsPipelineCreateInfo createInfo;
 
@@ -208,7 +218,7 @@ void egx::IGraphicsPipeline::Invalidate()
 		.setLayout(m_Data->m_Layout)
 		.setRenderPass(m_Data->m_RenderTarget.RenderPass())
 		.setSubpass(0);
-	auto result = m_Data->m_Ctx->Device.createGraphicsPipeline(nullptr, createInfo);
+	auto result = m_Data->m_Ctx->Device.createGraphicsPipeline(m_Data->m_Ctx->PipelineCache->GetHandle(), createInfo);
 	if (result.result != vk::Result::eSuccess)
 	{
 		throw runtime_error(cpp::Format("Could not create pipeline, vk::Result = {}", vk::to_string(result.result)));
@@ -223,16 +233,17 @@ void egx::IGraphicsPipeline::CallbackProtocol(void* pUserData)
 
 void egx::IGraphicsPipeline::DataWrapper::Reinvalidate()
 {
-	for (auto& [id, setLayout] : m_SetLayouts)
-		m_Ctx->Device.destroyDescriptorSetLayout(setLayout);
-	m_Ctx->Device.destroyPipelineLayout(m_Layout);
-	m_Ctx->Device.destroyPipeline(m_Pipeline);
+	if (m_Pipeline || m_SharedLayout)
+		DeferDestroyPipeline(m_Ctx, m_Pipeline, m_SharedLayout);
 	m_Pipeline = nullptr, m_Layout = nullptr;
+	m_SharedLayout = nullptr;
 	m_SetLayouts.clear();
 }
 
 egx::IGraphicsPipeline::DataWrapper::~DataWrapper()
 {
+	if (m_ResizeCallback)
+		m_ResizeSwapchain.RemoveResizeCallback(m_ResizeCallback);
 	if (m_Ctx && m_Pipeline)
 	{
 		Reinvalidate();
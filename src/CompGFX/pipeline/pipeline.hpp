@@ -66,6 +66,7 @@ namespace egx
 		{
 			DeviceCtx m_Ctx;
 			ShaderReflection m_Reflection;
+			SharedPipelineLayout m_SharedLayout;
 			std::map<uint32_t, vk::DescriptorSetLayout> m_SetLayouts;
 			vk::PipelineLayout m_Layout = nullptr;
 			vk::Pipeline m_Pipeline = nullptr;
@@ -225,6 +226,7 @@ namespace egx
 		{
 			DeviceCtx m_Ctx;
 			ShaderReflection m_Reflection;
+			SharedPipelineLayout m_SharedLayout;
 			std::map<uint32_t, vk::DescriptorSetLayout> m_SetLayouts;
 			vk::PipelineLayout m_Layout = nullptr;
 			vk::Pipeline m_Pipeline = nullptr;
@@ -234,6 +236,10 @@ namespace egx
 			PipelineSpecification m_Specification;
 			Shader m_Vertex;
 			Shader m_Fragment;
+			// The render target may be replaced, the callback is removed from the swapchain it was added to
+			ISwapchainController m_ResizeSwapchain;
+			// 0 when not rendering to the swapchain
+			uint64_t m_ResizeCallback = 0;
 
 			void Reinvalidate();
 
@@ -0,0 +1,401 @@
+#include "ShaderArchive.hpp"
+#include <filesystem>
+#include <fstream>
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace egx;
+using namespace std;
+
+namespace
+{
+	constexpr char Magic[8] = { 'E', 'G', 'X', 'S', 'P', 'V', 'A', 'R' };
+
+	struct ArchiveHeader
+	{
+		char Magic[8];
+		uint32_t Version;
+		uint32_t Reserved;
+	};
+
+	struct EntryHeader
+	{
+		ShaderArchive::Key Key;
+		uint32_t BytecodeSize;
+		uint32_t ReflectionSize;
+	};
+
+	constexpr size_t Align4(size_t size) { return (size + 3) & ~size_t(3); }
+
+	class BinaryWriter
+	{
+	public:
+		template <typename T>
+		void Write(const T& value)
+		{
+			auto bytes = (const uint8_t*)&value;
+			Data.insert(Data.end(), bytes, bytes + sizeof(T));
+		}
+
+		void WriteString(const string& text)
+		{
+			Write(uint32_t(text.size()));
+			Data.insert(Data.end(), text.begin(), text.end());
+		}
+
+		vector<uint8_t> Data;
+	};
+
+	class BinaryReader
+	{
+	public:
+		BinaryReader(const uint8_t* data, size_t size) : m_Data(data), m_Size(size) {}
+
+		template <typename T>
+		T Read()
+		{
+			T value;
+			memcpy(&value, _Take(sizeof(T)), sizeof(T));
+			return value;
+		}
+
+		string ReadString()
+		{
+			uint32_t size = Read<uint32_t>();
+			auto text = (const char*)_Take(size);
+			return string(text, size);
+		}
+
+	private:
+		const uint8_t* _Take(size_t size)
+		{
+			if (m_Size - m_Offset < size)
+				throw runtime_error("Unexpected end of serialized shader reflection.");
+			auto data = m_Data + m_Offset;
+			m_Offset += size;
+			return data;
+		}
+
+	private:
+		const uint8_t* m_Data;
+		size_t m_Size;
+		size_t m_Offset = 0;
+	};
+
+	void WriteIO(BinaryWriter& writer, const map<uint32_t, map<uint32_t, ShaderReflection::IO>>& bindings)
+	{
+		writer.Write(uint32_t(bindings.size()));
+		for (auto& [binding, locations] : bindings)
+		{
+			writer.Write(binding);
+			writer.Write(uint32_t(locations.size()));
+			for (auto& [location, io] : locations)
+			{
+				writer.Write(location);
+				writer.Write(io.Location);
+				writer.Write(io.Binding);
+				writer.Write(io.VectorSize);
+				writer.Write(io.Size);
+				writer.Write(uint32_t(io.Format));
+				writer.WriteString(io.Name);
+			}
+		}
+	}
+
+	map<uint32_t, map<uint32_t, ShaderReflection::IO>> ReadIO(BinaryReader& reader)
+	{
+		map<uint32_t, map<uint32_t, ShaderReflection::IO>> bindings;
+		uint32_t bindingCount = reader.Read<uint32_t>();
+		for (uint32_t i = 0; i < bindingCount; i++)
+		{
+			auto& locations = bindings[reader.Read<uint32_t>()];
+			uint32_t locationCount = reader.Read<uint32_t>();
+			for (uint32_t j = 0; j < locationCount; j++)
+			{
+				auto& io = locations[reader.Read<uint32_t>()];
+				io.Location = reader.Read<uint32_t>();
+				io.Binding = reader.Read<uint32_t>();
+				io.VectorSize = reader.Read<uint32_t>();
+				io.Size = reader.Read<uint32_t>();
+				io.Format = VkFormat(reader.Read<uint32_t>());
+				io.Name = reader.ReadString();
+			}
+		}
+		return bindings;
+	}
+
+	void WriteBinding(BinaryWriter& writer, const ShaderReflection::BindingInfo& binding)
+	{
+		writer.Write(binding.BindingId);
+		writer.Write(binding.Size);
+		writer.Write(binding.DescriptorCount);
+		writer.Write(uint32_t(binding.Type));
+		writer.Write(binding.Dimension);
+		writer.Write(uint8_t(binding.IsBuffer));
+		writer.Write(uint8_t(binding.IsDynamic));
+		writer.Write(uint8_t(binding.IsReadOnly));
+		writer.WriteString(binding.Name);
+	}
+
+	ShaderReflection::BindingInfo ReadBinding(BinaryReader& reader)
+	{
+		ShaderReflection::BindingInfo binding;
+		binding.BindingId = reader.Read<uint32_t>();
+		binding.Size = reader.Read<uint32_t>();
+		binding.DescriptorCount = reader.Read<uint32_t>();
+		binding.Type = VkDescriptorType(reader.Read<uint32_t>());
+		binding.Dimension = reader.Read<uint32_t>();
+		binding.IsBuffer = reader.Read<uint8_t>() != 0;
+		binding.IsDynamic = reader.Read<uint8_t>() != 0;
+		binding.IsReadOnly = reader.Read<uint8_t>() != 0;
+		binding.Name = reader.ReadString();
+		return binding;
+	}
+}
+
+egx::ShaderArchive::ShaderArchive(const string& filePath) : m_FilePath(filePath)
+{
+	if (filesystem::exists(filePath) && _Map())
+	{
+		size_t validSize = _Index();
+		if (validSize == 0)
+		{
+			LOG(WARNING, "Shader archive {} has an unknown format, it is replaced.", filePath);
+			_Unmap();
+			filesystem::remove(filePath);
+		}
+		else if (validSize < m_ViewSize)
+		{
+			LOG(WARNING, "Shader archive {} ends with an incomplete entry, {} bytes are removed.", filePath, m_ViewSize - validSize);
+			_Unmap();
+			filesystem::resize_file(filePath, validSize);
+			_Map();
+			_Index();
+		}
+	}
+	if (!filesystem::exists(filePath))
+	{
+		ArchiveHeader header{};
+		memcpy(header.Magic, Magic, sizeof(Magic));
+		header.Version = FormatVersion;
+		ofstream file(filePath, ios::binary | ios::trunc);
+		if (!file || !file.write((const char*)&header, sizeof(header)))
+		{
+			LOG(WARNING, "Could not create the shader archive {}, compiled shaders are only cached in memory.", filePath);
+		}
+	}
+}
+
+egx::ShaderArchive::~ShaderArchive()
+{
+	_Unmap();
+}
+
+optional<ShaderArchive::Entry> egx::ShaderArchive::Find(const Key& key) const
+{
+	scoped_lock lock(m_Lock);
+	if (auto added = m_Added.find(key); added != m_Added.end())
+		return added->second;
+	auto mapped = m_Mapped.find(key);
+	if (mapped == m_Mapped.end())
+		return {};
+	const MappedEntry& data = mapped->second;
+	try {
+		Entry entry;
+		entry.Reflection = DeserializeReflection(data.Reflection, data.ReflectionSize);
+		entry.Bytecode.resize(data.BytecodeSize / sizeof(uint32_t));
+		memcpy(entry.Bytecode.data(), data.Bytecode, data.BytecodeSize);
+		return entry;
+	}
+	catch (runtime_error& e) {
+		LOG(WARNING, "Ignoring corrupt entry {} in shader archive {}. {}", Sha256::ToHex(key), m_FilePath, e.what());
+		// Lets Add() append the recompiled entry, _Index() keeps the last entry of a key when the archive is reopened
+		m_Mapped.erase(mapped);
+		return {};
+	}
+}
+
+void egx::ShaderArchive::Add(const Key& key, const vector<uint32_t>& bytecode, const ShaderReflection& reflection)
+{
+	auto serialized = SerializeReflection(reflection);
+	EntryHeader header;
+	header.Key = key;
+	header.BytecodeSize = uint32_t(bytecode.size() * sizeof(uint32_t));
+	header.ReflectionSize = uint32_t(serialized.size());
+	serialized.resize(Align4(serialized.size()));
+
+	scoped_lock lock(m_Lock);
+	if (m_Added.contains(key) || m_Mapped.contains(key))
+		return;
+	m_Added[key] = { bytecode, reflection };
+
+	ofstream file(m_FilePath, ios::binary | ios::app);
+	if (!file ||
+		!file.write((const char*)&header, sizeof(header)) ||
+		!file.write((const char*)bytecode.data(), header.BytecodeSize) ||
+		!file.write((const char*)serialized.data(), serialized.size()))
+	{
+		LOG(WARNING, "Could not append {} to the shader archive {}.", Sha256::ToHex(key), m_FilePath);
+	}
+}
+
+size_t egx::ShaderArchive::EntryCount() const
+{
+	scoped_lock lock(m_Lock);
+	return m_Mapped.size() + m_Added.size();
+}
+
+vector<uint8_t> egx::ShaderArchive::SerializeReflection(const ShaderReflection& reflection)
+{
+	BinaryWriter writer;
+	writer.Write(uint8_t(reflection.Pushconstant.HasValue));
+	writer.WriteString(reflection.Pushconstant.Name);
+	writer.Write(reflection.Pushconstant.Offset);
+	writer.Write(reflection.Pushconstant.Size);
+	WriteIO(writer, reflection.IOBindingToManyLocationIn);
+	WriteIO(writer, reflection.IOBindingToManyLocationOut);
+	writer.Write(uint32_t(reflection.SetToManyBindings.size()));
+	for (auto& [setId, bindings] : reflection.SetToManyBindings)
+	{
+		writer.Write(setId);
+		writer.Write(uint32_t(bindings.size()));
+		for (auto& [bindingId, binding] : bindings)
+		{
+			writer.Write(bindingId);
+			WriteBinding(writer, binding);
+		}
+	}
+	writer.Write(uint32_t(reflection.ResourceNameToBinding.size()));
+	for (auto& [name, binding] : reflection.ResourceNameToBinding)
+	{
+		writer.WriteString(name);
+		WriteBinding(writer, binding);
+	}
+	writer.Write(uint32_t(reflection.ShaderStage));
+	return writer.Data;
+}
+
+ShaderReflection egx::ShaderArchive::DeserializeReflection(const uint8_t* data, size_t size)
+{
+	BinaryReader reader(data, size);
+	ShaderReflection reflection;
+	reflection.Pushconstant.HasValue = reader.Read<uint8_t>() != 0;
+	reflection.Pushconstant.Name = reader.ReadString();
+	reflection.Pushconstant.Offset = reader.Read<uint32_t>();
+	reflection.Pushconstant.Size = reader.Read<uint32_t>();
+	reflection.IOBindingToManyLocationIn = ReadIO(reader);
+	reflection.IOBindingToManyLocationOut = ReadIO(reader);
+	uint32_t setCount = reader.Read<uint32_t>();
+	for (uint32_t i = 0; i < setCount; i++)
+	{
+		auto& bindings = reflection.SetToManyBindings[reader.Read<uint32_t>()];
+		uint32_t bindingCount = reader.Read<uint32_t>();
+		for (uint32_t j = 0; j < bindingCount; j++)
+		{
+			uint32_t bindingId = reader.Read<uint32_t>();
+			bindings[bindingId] = ReadBinding(reader);
+		}
+	}
+	uint32_t nameCount = reader.Read<uint32_t>();
+	for (uint32_t i = 0; i < nameCount; i++)
+	{
+		string name = reader.ReadString();
+		reflection.ResourceNameToBinding[name] = ReadBinding(reader);
+	}
+	reflection.ShaderStage = VkShaderStageFlags(reader.Read<uint32_t>());
+	return reflection;
+}
+
+bool egx::ShaderArchive::_Map()
+{
+#ifdef _WIN32
+	HANDLE file = CreateFileA(m_FilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize{};
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	// The view keeps the mapping and the file open
+	CloseHandle(file);
+	if (!mapping)
+		return false;
+	auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (!view)
+		return false;
+	m_View = (const uint8_t*)view;
+	m_ViewSize = size_t(fileSize.QuadPart);
+#else
+	int file = open(m_FilePath.c_str(), O_RDONLY);
+	if (file < 0)
+		return false;
+	struct stat info {};
+	if (fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+	auto view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+		return false;
+	m_View = (const uint8_t*)view;
+	m_ViewSize = size_t(info.st_size);
+#endif
+	return true;
+}
+
+void egx::ShaderArchive::_Unmap()
+{
+	m_Mapped.clear();
+	if (!m_View)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(m_View);
+#else
+	munmap((void*)m_View, m_ViewSize);
+#endif
+	m_View = nullptr;
+	m_ViewSize = 0;
+}
+
+size_t egx::ShaderArchive::_Index()
+{
+	ArchiveHeader header;
+	if (m_ViewSize < sizeof(header))
+		return 0;
+	memcpy(&header, m_View, sizeof(header));
+	if (memcmp(header.Magic, Magic, sizeof(Magic)) != 0 || header.Version != FormatVersion)
+		return 0;
+
+	size_t offset = sizeof(header);
+	while (m_ViewSize - offset >= sizeof(EntryHeader))
+	{
+		EntryHeader entry;
+		memcpy(&entry, m_View + offset, sizeof(entry));
+		size_t entrySize = sizeof(entry) + size_t(entry.BytecodeSize) + Align4(entry.ReflectionSize);
+		if (entry.BytecodeSize % sizeof(uint32_t) != 0 || m_ViewSize - offset < entrySize)
+			break;
+		auto bytecode = m_View + offset + sizeof(entry);
+		m_Mapped[entry.Key] = { bytecode, entry.BytecodeSize, bytecode + entry.BytecodeSize, entry.ReflectionSize };
+		offset += entrySize;
+	}
+	return offset;
+}
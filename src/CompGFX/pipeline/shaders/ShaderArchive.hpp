@@ -0,0 +1,85 @@
+#pragma once
+#include "shader.hpp"
+#include <ext/Sha256.hpp>
+#include <mutex>
+#include <unordered_map>
+#include <cstring>
+
+namespace egx
+{
+
+    /// <summary>
+    /// Append-only file of compiled shaders, each entry stores the SPIR-V and the serialized ShaderReflection
+    /// under a 32 byte key, Shader::CreateCacheKey() for the shader cache and Shader::CreatePackKey() for packs
+    /// built by egx-shaderc. The file is memory mapped when opened, entries added afterwards are appended to the
+    /// file and kept in memory until the archive is reopened.
+    /// A file with an unknown header is replaced, a truncated last entry (crash while appending) is cut off.
+    /// Find() and Add() are thread safe.
+    /// </summary>
+    class ShaderArchive
+    {
+    public:
+        using Key = Sha256::Digest;
+
+        struct Entry
+        {
+            std::vector<uint32_t> Bytecode;
+            ShaderReflection Reflection;
+        };
+
+        static constexpr uint32_t FormatVersion = 1;
+
+        ShaderArchive(const std::string& filePath);
+        ShaderArchive(ShaderArchive&) = delete;
+        ~ShaderArchive();
+
+        std::optional<Entry> Find(const Key& key) const;
+        /// <summary>
+        /// Appends the entry to the file, an existing key is left untouched.
+        /// </summary>
+        void Add(const Key& key, const std::vector<uint32_t>& bytecode, const ShaderReflection& reflection);
+
+        size_t EntryCount() const;
+        const std::string& GetFilePath() const { return m_FilePath; }
+
+        static std::vector<uint8_t> SerializeReflection(const ShaderReflection& reflection);
+        /// <summary>
+        /// Throws runtime_error when the data is malformed.
+        /// </summary>
+        static ShaderReflection DeserializeReflection(const uint8_t* data, size_t size);
+
+    private:
+        struct KeyHash
+        {
+            size_t operator()(const Key& key) const
+            {
+                size_t hash;
+                memcpy(&hash, key.data(), sizeof(hash));
+                return hash;
+            }
+        };
+
+        struct MappedEntry
+        {
+            const uint8_t* Bytecode;
+            uint32_t BytecodeSize;
+            const uint8_t* Reflection;
+            uint32_t ReflectionSize;
+        };
+
+        bool _Map();
+        void _Unmap();
+        // Returns the size of the valid part of the mapped file
+        size_t _Index();
+
+    private:
+        std::string m_FilePath;
+        const uint8_t* m_View = nullptr;
+        size_t m_ViewSize = 0;
+        // Find() drops corrupt entries
+        mutable std::unordered_map<Key, MappedEntry, KeyHash> m_Mapped;
+        std::unordered_map<Key, Entry, KeyHash> m_Added;
+        mutable std::mutex m_Lock;
+    };
+
+}
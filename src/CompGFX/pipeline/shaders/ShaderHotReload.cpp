@@ -0,0 +1,225 @@
+#include "ShaderHotReload.hpp"
+#include "shader.hpp"
+#include <ext/ZoneProfiler.hpp>
+#include <filesystem>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using namespace egx;
+using namespace std;
+
+egx::ShaderHotReload::ShaderHotReload(const DeviceCtx& pCtx) : m_Ctx(pCtx)
+{
+#ifdef __linux__
+	m_Inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_Inotify < 0)
+	{
+		throw runtime_error(cpp::Format("Could not initialize inotify for shader hot reload, errno={}", errno));
+	}
+#endif
+	m_Thread = thread([this] { _ThreadLoop(); });
+}
+
+egx::ShaderHotReload::~ShaderHotReload()
+{
+	m_Exit = true;
+	m_Thread.join();
+#ifdef __linux__
+	close(m_Inotify);
+#endif
+}
+
+void egx::ShaderHotReload::Unwatch(uint64_t id)
+{
+	scoped_lock lock(m_Lock);
+	auto registration = m_Registrations.find(id);
+	if (registration == m_Registrations.end())
+		return;
+	for (auto& dependency : registration->second.Dependencies)
+	{
+		auto& dependents = m_Dependents[dependency];
+		dependents.erase(id);
+		if (dependents.empty())
+			m_Dependents.erase(dependency);
+	}
+	m_Registrations.erase(registration);
+}
+
+size_t egx::ShaderHotReload::WatchedFileCount() const
+{
+	scoped_lock lock(m_Lock);
+	return m_Dependents.size();
+}
+
+uint64_t egx::ShaderHotReload::_Register(const vector<string>& shaderFiles, function<void()> rebuild)
+{
+	scoped_lock lock(m_Lock);
+	uint64_t id = m_NextId++;
+	auto& registration = m_Registrations[id];
+	registration.ShaderFiles = shaderFiles;
+	registration.Rebuild = std::move(rebuild);
+	_UpdateDependencies(id, registration);
+	return id;
+}
+
+void egx::ShaderHotReload::_UpdateDependencies(uint64_t id, Registration& registration)
+{
+	set<string> dependencies;
+	for (auto& file : registration.ShaderFiles)
+	{
+		dependencies.insert(_Normalize(file));
+		try {
+			for (auto& dependency : Shader::CollectDependencies(file))
+				dependencies.insert(_Normalize(dependency));
+		}
+		catch (exception& e) {
+			// e.g. an #include that does not exist yet, the previous includes stay watched
+			LOG(WARNING, "Could not collect the includes of {}, keeping the previous ones. {}", file, e.what());
+			dependencies.insert(registration.Dependencies.begin(), registration.Dependencies.end());
+		}
+	}
+
+	for (auto& dependency : registration.Dependencies)
+	{
+		if (dependencies.contains(dependency))
+			continue;
+		auto& dependents = m_Dependents[dependency];
+		dependents.erase(id);
+		if (dependents.empty())
+			m_Dependents.erase(dependency);
+	}
+	for (auto& dependency : dependencies)
+	{
+		m_Dependents[dependency].insert(id);
+		_WatchDirectory(filesystem::path(dependency).parent_path().string());
+	}
+	registration.Dependencies = std::move(dependencies);
+}
+
+void egx::ShaderHotReload::_OnFilesChanged(const set<string>& files)
+{
+	if (files.empty())
+		return;
+	EGX_ZONE("ShaderHotReload::OnFilesChanged");
+	vector<function<void()>> rebuilds;
+	{
+		scoped_lock lock(m_Lock);
+		set<uint64_t> ids;
+		for (auto& file : files)
+		{
+			auto dependents = m_Dependents.find(file);
+			if (dependents == m_Dependents.end())
+				continue;
+			LOG(INFO, "{} changed, rebuilding {} pipeline(s).", file, dependents->second.size());
+			ids.insert(dependents->second.begin(), dependents->second.end());
+		}
+		for (uint64_t id : ids)
+		{
+			auto& registration = m_Registrations.at(id);
+			// The change may have added or removed includes
+			_UpdateDependencies(id, registration);
+			rebuilds.push_back(registration.Rebuild);
+		}
+	}
+	for (auto& rebuild : rebuilds)
+		rebuild();
+}
+
+#ifdef __linux__
+
+void egx::ShaderHotReload::_WatchDirectory(const string& directory)
+{
+	if (m_DirectoryToWatch.contains(directory))
+		return;
+	// Editors often save by renaming a temporary file, the directory is watched rather than the file
+	int watch = inotify_add_watch(m_Inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (watch < 0)
+	{
+		LOG(WARNING, "Could not watch {} for shader changes, errno={}", directory, errno);
+		return;
+	}
+	m_DirectoryToWatch[directory] = watch;
+	m_WatchToDirectory[watch] = directory;
+}
+
+void egx::ShaderHotReload::_ThreadLoop()
+{
+	ZoneProfiler::Get().SetThreadName("Shader hot reload");
+	auto drain = [this](set<string>& changed) {
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(m_Inotify, buffer, sizeof(buffer))) > 0)
+		{
+			for (char* event = buffer; event < buffer + length; event += sizeof(inotify_event) + ((inotify_event*)event)->len)
+			{
+				auto info = (inotify_event*)event;
+				if (info->len == 0)
+					continue;
+				scoped_lock lock(m_Lock);
+				auto directory = m_WatchToDirectory.find(info->wd);
+				if (directory != m_WatchToDirectory.end())
+					changed.insert(_Normalize((filesystem::path(directory->second) / info->name).string()));
+			}
+		}
+	};
+
+	while (!m_Exit)
+	{
+		pollfd descriptor{ m_Inotify, POLLIN, 0 };
+		if (poll(&descriptor, 1, PollIntervalMs) <= 0)
+			continue;
+		set<string> changed;
+		drain(changed);
+		// A save can produce several events, they are coalesced into one rebuild
+		this_thread::sleep_for(chrono::milliseconds(20));
+		drain(changed);
+		_OnFilesChanged(changed);
+	}
+}
+
+#else
+
+void egx::ShaderHotReload::_WatchDirectory(const string& directory)
+{
+	// Files are polled by _ThreadLoop()
+}
+
+void egx::ShaderHotReload::_ThreadLoop()
+{
+	ZoneProfiler::Get().SetThreadName("Shader hot reload");
+	while (!m_Exit)
+	{
+		this_thread::sleep_for(chrono::milliseconds(PollIntervalMs));
+		set<string> changed;
+		{
+			scoped_lock lock(m_Lock);
+			for (auto& [file, dependents] : m_Dependents)
+			{
+				error_code error;
+				auto lastWriteTime = int64_t(filesystem::last_write_time(file, error).time_since_epoch().count());
+				if (error)
+					continue;
+				auto [entry, inserted] = m_LastWriteTime.try_emplace(file, lastWriteTime);
+				if (!inserted && entry->second != lastWriteTime)
+				{
+					entry->second = lastWriteTime;
+					changed.insert(file);
+				}
+			}
+		}
+		_OnFilesChanged(changed);
+	}
+}
+
+#endif
+
+string egx::ShaderHotReload::_Normalize(const string& file)
+{
+	error_code error;
+	auto path = filesystem::weakly_canonical(file, error);
+	return error ? filesystem::absolute(file).string() : path.string();
+}
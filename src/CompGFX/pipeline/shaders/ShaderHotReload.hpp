@@ -0,0 +1,86 @@
+#pragma once
+#include <core/egx.hpp>
+#include <pipeline/PipelineCompiler.hpp>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+namespace egx
+{
+
+    /// <summary>
+    /// Rebuilds pipelines when their shader files or any file they #include change. A background thread watches the
+    /// directories of every dependency (inotify on Linux, last write time polling elsewhere) and keeps a reverse include
+    /// graph from each file to the pipelines using it, so a change only rebuilds the dependent pipelines.
+    /// Rebuilds run on the device's PipelineCompiler and are swapped in at the next frame boundary, the previous
+    /// pipeline stays in use when a rebuild fails. Shaders that did not change are served by the shader cache.
+    /// </summary>
+    class ShaderHotReload
+    {
+    public:
+        static constexpr uint32_t PollIntervalMs = 250;
+
+        ShaderHotReload(const DeviceCtx& pCtx);
+        ShaderHotReload(ShaderHotReload&) = delete;
+        ~ShaderHotReload();
+
+        /// <summary>
+        /// Calls build on the PipelineCompiler and commits the result into pipeline whenever one of shaderFiles or
+        /// their includes change. build must create its shaders from the same files. Returns an id for Unwatch(),
+        /// the registration keeps the pipeline handle alive.
+        /// </summary>
+        template <typename T>
+        uint64_t Watch(const PendingPipeline<T>& pipeline, const std::vector<std::string>& shaderFiles, std::function<T()> build)
+        {
+            return _Register(shaderFiles, [compiler = m_Ctx->Compiler, handle = pipeline, build = std::move(build)]() mutable {
+                compiler->Recompile(handle, build);
+            });
+        }
+
+        void Unwatch(uint64_t id);
+
+        /// <summary>
+        /// Number of files in the include graph.
+        /// </summary>
+        size_t WatchedFileCount() const;
+
+    private:
+        struct Registration
+        {
+            std::vector<std::string> ShaderFiles;
+            std::set<std::string> Dependencies;
+            std::function<void()> Rebuild;
+        };
+
+        uint64_t _Register(const std::vector<std::string>& shaderFiles, std::function<void()> rebuild);
+        // Must be called with m_Lock held
+        void _UpdateDependencies(uint64_t id, Registration& registration);
+        void _OnFilesChanged(const std::set<std::string>& files);
+        void _WatchDirectory(const std::string& directory);
+        void _ThreadLoop();
+
+        static std::string _Normalize(const std::string& file);
+
+    private:
+        DeviceCtx m_Ctx;
+        std::map<uint64_t, Registration> m_Registrations;
+        // Reverse include graph, file -> registrations depending on it
+        std::unordered_map<std::string, std::set<uint64_t>> m_Dependents;
+        uint64_t m_NextId = 1;
+        mutable std::mutex m_Lock;
+        std::atomic<bool> m_Exit = false;
+        std::thread m_Thread;
+#ifdef __linux__
+        int m_Inotify = -1;
+        std::unordered_map<int, std::string> m_WatchToDirectory;
+        std::unordered_map<std::string, int> m_DirectoryToWatch;
+#else
+        std::unordered_map<std::string, int64_t> m_LastWriteTime;
+#endif
+    };
+
+}
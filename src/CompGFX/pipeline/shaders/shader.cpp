@@ -1,6 +1,15 @@
 #include "shader.hpp"
 #include <spirv_cross/spirv_cross.hpp>
+#ifndef EGX_NO_SHADERC
+#include <shaderc/shaderc.hpp>
+// Shipped with glslang since the 1.3.2xx SDKs
+#if __has_include(<glslang/build_info.h>)
+#include <glslang/build_info.h>
+#endif
+#endif
 #include <Utility/CppUtility.hpp>
+#include "ShaderArchive.hpp"
+#include <ext/ZoneProfiler.hpp>
 #include <filesystem>
 
 using namespace egx;
@@ -19,53 +28,17 @@ Shader::Shader(const egx::DeviceCtx& pCtx, const std::string& file,
 	}
 	std::filesystem::path fileInfo = file;
 
-	Type type = overrideType;
+	Type type = overrideType == Type::None ? TypeFromFileName(file) : overrideType;
 	if (type == Type::None)
 	{
-		auto extension = cpp::LowerCase(fileInfo.extension().string());
-		if (extension == ".vert")
-		{
-			type = Type::Vertex;
-		}
-		else if (extension == ".frag")
-		{
-			type = Type::Fragment;
-		}
-		else if (extension == ".comp")
-		{
-			type = Type::Compute;
-		}
-		else
-		{
-			LOGEXCEPT("Cannot determine shader type from extension {}. Supported formats: .vert, .frag, .comp", extension);
-		}
+		LOGEXCEPT("Cannot determine shader type from extension {}. Supported formats: .vert, .frag, .comp", fileInfo.extension().string());
 	}
 	m_Type = type;
 
-	m_Data = std::make_shared<Shader::DataWrapper>();
-	m_Data->m_Ctx = pCtx;
-	auto cacheBytecode = _LoadFromCache(file);
-	if (cacheBytecode) {
-		m_Duration = 0;
-
-		m_Data->m_Module = pCtx->Device.createShaderModule(vk::ShaderModuleCreateInfo({}, cacheBytecode.value()));
-		m_Reflection = GenerateReflection(cacheBytecode.value(), attributes);
-	}
-	else {
-		std::vector<std::pair<std::string, uint64_t>> lastModified;
-		std::optional<std::vector<std::string>> pragmaOnce;
-		std::string code = PreprocessIncludeFiles(file, fileInfo.parent_path().string(), glsl.value(), lastModified, pragmaOnce);
-		auto start = std::chrono::high_resolution_clock::now();
-		auto byteCode = CompileGlslToBytecode(code, type, defines, compileDebug, file);
-		auto end = std::chrono::high_resolution_clock::now();
-		m_Duration = (end - start).count() * 1e-9;
-		m_SourceCode = code;
-
-		m_Data->m_Module = pCtx->Device.createShaderModule(vk::ShaderModuleCreateInfo({}, byteCode));
-		m_Reflection = GenerateReflection(byteCode, attributes);
-		_CacheCompiledShader(file, byteCode, lastModified);
-	}
-
+	std::vector<std::pair<std::string, uint64_t>> lastModified;
+	std::optional<std::vector<std::string>> pragmaOnce;
+	std::string code = PreprocessIncludeFiles(file, fileInfo.parent_path().string(), glsl.value(), lastModified, pragmaOnce);
+	_LoadOrCompile(pCtx, code, attributes, defines, compileDebug, file);
 
 #ifdef _DEBUG
 	LOG(INFO, "Compiled {} in {:%.4lf} ms.", file, (m_Duration * 1e3));
@@ -76,20 +49,56 @@ Shader::Shader(const egx::DeviceCtx& pCtx, const std::string& sourceCode,
 	Shader::Type type, BindingAttributes attributes,
 	PreprocessDefines defines, bool compileDebeg) : m_Type(type)
 {
+	_LoadOrCompile(pCtx, sourceCode, attributes, defines, compileDebeg, "Shader(CompileFromSource)");
+#ifdef _DEBUG
+	LOG(INFO, "Compiled source code in {:%.4lf} ms.", (m_Duration * 1e3));
+#endif
+}
+
+Shader::Shader(const egx::DeviceCtx& pCtx, const ShaderArchive& pack, const std::string& name,
+	const PreprocessDefines& defines)
+{
+	auto entry = pack.Find(CreatePackKey(name, defines));
+	if (!entry)
+	{
+		throw runtime_error(cpp::Format("Shader {} with {} defines is not in the shader pack {}", name, defines.Defines.size(), pack.GetFilePath()));
+	}
+	m_Type = Type(entry->Reflection.ShaderStage);
+	m_Data = std::make_shared<Shader::DataWrapper>();
+	m_Data->m_Ctx = pCtx;
+	m_Data->m_Module = pCtx->Device.createShaderModule(vk::ShaderModuleCreateInfo({}, entry->Bytecode));
+	m_Reflection = std::move(entry->Reflection);
+}
+
+void egx::Shader::_LoadOrCompile(const DeviceCtx& pCtx, const std::string& sourceCode, BindingAttributes attributes,
+	const PreprocessDefines& defines, bool compileDebug, const std::string& fileName)
+{
+	m_SourceCode = sourceCode;
+	m_Data = std::make_shared<Shader::DataWrapper>();
+	m_Data->m_Ctx = pCtx;
+
+	auto cache = GetGlobalCache();
+	std::array<uint8_t, 32> key{};
+	if (cache) {
+		key = CreateCacheKey(sourceCode, m_Type, attributes, defines, compileDebug, fileName);
+		if (auto entry = cache->Find(key)) {
+			// Warm start, neither shaderc nor spirv_cross run
+			m_Duration = 0;
+			m_Data->m_Module = pCtx->Device.createShaderModule(vk::ShaderModuleCreateInfo({}, entry->Bytecode));
+			m_Reflection = std::move(entry->Reflection);
+			return;
+		}
+	}
+
 	auto start = std::chrono::high_resolution_clock::now();
-	auto byteCode = CompileGlslToBytecode(sourceCode, type, defines, compileDebeg, "Shader(CompileFromSource)");
+	auto byteCode = CompileGlslToBytecode(sourceCode, m_Type, defines, compileDebug, fileName);
 	auto end = std::chrono::high_resolution_clock::now();
 	m_Duration = (end - start).count() * 1e-9;
-	m_SourceCode = sourceCode;
 
-	m_Data = std::make_shared<Shader::DataWrapper>();
-	m_Data->m_Ctx = pCtx;
 	m_Data->m_Module = pCtx->Device.createShaderModule(vk::ShaderModuleCreateInfo({}, byteCode));
-
 	m_Reflection = GenerateReflection(byteCode, attributes);
-#ifdef _DEBUG
-	LOG(INFO, "Compiled source code in {:%.4lf} ms.", (m_Duration * 1e3));
-#endif
+	if (cache)
+		cache->Add(key, byteCode, m_Reflection);
 }
 
 std::string Shader::PreprocessIncludeFiles(std::string_view CurrentFilePath,
@@ -149,6 +158,30 @@ ShaderReflection Shader::GenerateReflection(const std::vector<uint32_t>& Bytecod
 	spirv_cross::Compiler compiler(Bytecode);
 	const auto& resources = compiler.get_shader_resources();
 
+	switch (compiler.get_execution_model())
+	{
+	case spv::ExecutionModelVertex:
+		output.ShaderStage = VK_SHADER_STAGE_VERTEX_BIT;
+		break;
+	case spv::ExecutionModelTessellationControl:
+		output.ShaderStage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		break;
+	case spv::ExecutionModelTessellationEvaluation:
+		output.ShaderStage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		break;
+	case spv::ExecutionModelGeometry:
+		output.ShaderStage = VK_SHADER_STAGE_GEOMETRY_BIT;
+		break;
+	case spv::ExecutionModelFragment:
+		output.ShaderStage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		break;
+	case spv::ExecutionModelGLCompute:
+		output.ShaderStage = VK_SHADER_STAGE_COMPUTE_BIT;
+		break;
+	default:
+		break;
+	}
+
 	auto readStageIO = [&](
 		const spirv_cross::SmallVector<spirv_cross::Resource>& stageIO,
 		std::map<uint32_t, std::map<uint32_t, ShaderReflection::IO>>& out)
@@ -243,26 +276,27 @@ ShaderReflection Shader::GenerateReflection(const std::vector<uint32_t>& Bytecod
 
 	auto readBufferResources = [&](
 		const spirv_cross::SmallVector<spirv_cross::Resource>& buffers,
-		VkDescriptorType typeNonDynamic, VkDescriptorType typeDynamic)
+		VkDescriptorType typeNonDynamic, VkDescriptorType typeDynamic, BindingAttributes dynamicAttribute)
 	{
 		for (auto& item : buffers)
 		{
 			auto& type = compiler.get_type(item.type_id);
 			ShaderReflection::BindingInfo info{};
-			info.IsDynamic = ((uint32_t)Attributes & (uint32_t)BindingAttributes::DynamicUniform);
+			info.IsDynamic = ((uint32_t)Attributes & (uint32_t)dynamicAttribute);
 			info.Type = info.IsDynamic ? typeDynamic : typeNonDynamic;
 			info.Name = compiler.get_name(item.id);
 			info.BindingId = compiler.get_decoration(item.id, spv::DecorationBinding);
 			info.Size = (uint32_t)compiler.get_declared_struct_size(type);
 			info.DescriptorCount = std::max(type.array[0], 1u);
 			info.IsBuffer = true;
+			info.IsReadOnly = typeNonDynamic != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || compiler.get_buffer_block_flags(item.id).get(spv::DecorationNonWritable);
 			auto setId = compiler.get_decoration(item.id, spv::DecorationDescriptorSet);
 			output.SetToManyBindings[setId][info.BindingId] = info;
 		}
 	};
 
-	readBufferResources(resources.uniform_buffers, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
-	readBufferResources(resources.storage_buffers, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+	readBufferResources(resources.uniform_buffers, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, BindingAttributes::DynamicUniform);
+	readBufferResources(resources.storage_buffers, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, BindingAttributes::DynamicStorage);
 
 	auto readImageResources = [&](const spirv_cross::SmallVector<spirv_cross::Resource>& images, VkDescriptorType Type)
 	{
@@ -278,6 +312,7 @@ ShaderReflection Shader::GenerateReflection(const std::vector<uint32_t>& Bytecod
 			info.Dimension = type.image.dim;
 			info.DescriptorCount = std::max(type.array[0], 1u);
 			info.IsBuffer = false;
+			info.IsReadOnly = Type != VK_DESCRIPTOR_TYPE_STORAGE_IMAGE || compiler.has_decoration(item.id, spv::DecorationNonWritable);
 			auto setId = compiler.get_decoration(item.id, spv::DecorationDescriptorSet);
 			output.SetToManyBindings[setId][info.BindingId] = info;
 		}
@@ -296,6 +331,10 @@ std::vector<uint32_t> Shader::CompileGlslToBytecode(const std::string& sourceCod
 	const PreprocessDefines& defines, bool compileDebug,
 	const std::string& fileName)
 {
+	EGX_ZONE("Shader::CompileGlslToBytecode");
+#ifdef EGX_NO_SHADERC
+	throw runtime_error(cpp::Format("Cannot compile {}, the engine was built with EGX_NO_SHADERC. Load the shader from a pack built by egx-shaderc.", fileName));
+#else
 	shaderc_shader_kind shaderKind{};
 	switch (type)
 	{
@@ -328,20 +367,11 @@ std::vector<uint32_t> Shader::CompileGlslToBytecode(const std::string& sourceCod
 		options.SetOptimizationLevel(shaderc_optimization_level_performance);
 	}
 
-	std::string defineList;
 	for (auto& [preprocessor, value] : defines.Defines)
 	{
-		defineList += cpp::Format("#define {0} {1}\n", preprocessor, value);
+		options.AddMacroDefinition(preprocessor, value);
 	}
-	// defines must be after #version
-	// auto versionIndex = cpp::IndexOf(sourceCode, "#version");
-	// std::string_view code_without_version = sourceCode.substr(versionIndex);
-	// code_without_version = code_without_version.substr(cpp::IndexOf(code_without_version, "\n"));
-	// std::string_view version = sourceCode.substr(versionIndex, code_without_version.data() - sourceCode.data());
-	// std::stringstream code_stream;
-	// code_stream << version << '\n'
-	//            << defineList << code_without_version;
-	auto code = sourceCode; // code_stream.str();
+	auto& code = sourceCode;
 
 	auto start = std::chrono::high_resolution_clock::now();
 	auto compilationResult = compiler.CompileGlslToSpv(code, shaderKind, fileName.data(), "main", options);
@@ -364,6 +394,7 @@ std::vector<uint32_t> Shader::CompileGlslToBytecode(const std::string& sourceCod
 	}
 	auto bytecode = std::vector<uint32_t>(compilationResult.begin(), compilationResult.end());
 	return bytecode;
+#endif
 }
 
 Shader::DataWrapper::~DataWrapper()
@@ -411,7 +442,7 @@ std::string ShaderReflection::DumpAsText() const
 	{
 		for (auto& [bindingId, item] : binding)
 		{
-			output += Format("(set={0}, binding={1}) {{Size={2} ArrayCount={3}}} {4}\n", setId, bindingId, item.Size, item.DescriptorCount, item.Name);
+			output += Format("(set={0}, binding={1}) {{Size={2} ArrayCount={3}}} {4}{5}\n", setId, bindingId, item.Size, item.DescriptorCount, item.IsReadOnly ? "readonly " : "", item.Name);
 		}
 	}
 
@@ -433,11 +464,11 @@ vector<vk::PushConstantRange> Shader::GetPushconstants(const std::initializer_li
 	return ranges;
 }
 
-std::map<uint32_t, vk::DescriptorSetLayout> egx::Shader::CreateDescriptorSetLayouts(const std::initializer_list<Shader>& shaders)
+std::map<uint32_t, SharedDescriptorSetLayout> egx::Shader::CreateDescriptorSetLayouts(const std::initializer_list<Shader>& shaders)
 {
 	if (shaders.size() == 0)
 		return {};
-	map<uint32_t, vk::DescriptorSetLayout> setLayouts;
+	map<uint32_t, SharedDescriptorSetLayout> setLayouts;
 	map<uint32_t, map<uint32_t, vk::DescriptorSetLayoutBinding>> setMap;
 	const auto& ctx = shaders.begin()->m_Data->m_Ctx;
 	for (auto& shader : shaders)
@@ -477,9 +508,7 @@ std::map<uint32_t, vk::DescriptorSetLayout> egx::Shader::CreateDescriptorSetLayo
 		{
 			setLayoutBindings.push_back(bindingInfo);
 		}
-		vk::DescriptorSetLayoutCreateInfo createInfo;
-		createInfo.setBindings(setLayoutBindings);
-		setLayouts[setId] = ctx->Device.createDescriptorSetLayout(createInfo);
+		setLayouts[setId] = ctx->Layouts->GetDescriptorSetLayout(setLayoutBindings);
 	}
 	return setLayouts;
 }
@@ -497,11 +526,13 @@ ShaderReflection egx::ShaderReflection::Combine(const std::initializer_list<Shad
 					if (resultSet.contains(bindingId)) {
 						// Verify both reflections have the same binding.
 						// If not throw exception
-						const auto& resultBinding = resultSet.at(bindingId);
+						auto& resultBinding = resultSet.at(bindingId);
 						if (resultBinding.DescriptorCount != binding.DescriptorCount ||
 							resultBinding.Type != binding.Type) {
 							throw runtime_error(cpp::Format("Cannot combine reflections because mismatch at set={}, binding={}", setId, bindingId));
 						}
+						// Written when any stage writes it
+						resultBinding.IsReadOnly = resultBinding.IsReadOnly && binding.IsReadOnly;
 					}
 					else {
 						resultSet[bindingId] = binding;
@@ -518,86 +549,135 @@ ShaderReflection egx::ShaderReflection::Combine(const std::initializer_list<Shad
 
 void egx::Shader::SetGlobalCacheDirectory(const std::string& directory)
 {
+	if (directory.length() == 0) {
+		scoped_lock lock(m_CacheLock);
+		m_Cache = nullptr;
+		return;
+	}
 	if (!filesystem::exists(directory)) {
 		if (!filesystem::create_directories(directory)) {
 			LOG(ERR, "Could not create directorys {} for global shader cache.", directory);
 			return;
 		}
 	}
-	Shader::m_CachingDirectory = directory;
+	auto cache = make_shared<ShaderArchive>((filesystem::path(directory) / "shaders.spirv-archive.bin").string());
+	scoped_lock lock(m_CacheLock);
+	m_Cache = cache;
 }
 
-std::optional<std::vector<uint32_t>> egx::Shader::_LoadFromCache(const std::string& filePath)
+std::shared_ptr<ShaderArchive> egx::Shader::GetGlobalCache()
 {
-	if (m_CachingDirectory.length() == 0)
-		return {};
+	scoped_lock lock(m_CacheLock);
+	return m_Cache;
+}
 
-	filesystem::path cd = Shader::m_CachingDirectory;
-	string file = filesystem::absolute(filePath).string();
-	size_t fileHash = hash<string>{}(file);
-	auto binFile = cd / Format("{}.spirv-cache.bin", fileHash);
-	auto metadataFile = cd / Format("{}.spirv-cache.log", fileHash);
-	if (!filesystem::exists(binFile))
-		return {};
+std::array<uint8_t, 32> egx::Shader::CreateCacheKey(const std::string& sourceCode, Type type, BindingAttributes attributes,
+	const PreprocessDefines& defines, bool compileDebug, const std::string& fileName)
+{
+	// Bump when CompileGlslToBytecode() or GenerateReflection() change their output, and when updating shaderc
+	// without glslang/build_info.h (its SPIR-V version rarely changes between releases)
+	constexpr uint32_t CompilerRevision = 1;
+	unsigned int spirvVersion = 0, spirvRevision = 0;
+#ifndef EGX_NO_SHADERC
+	shaderc_get_spv_version(&spirvVersion, &spirvRevision);
+#endif
 
-	// If metadata file doesn't exist then remove bin file
-	if (!filesystem::exists(metadataFile)) {
-		filesystem::remove(binFile);
-		return {};
+	Sha256 sha;
+	sha.UpdateValue(CompilerRevision);
+	sha.UpdateValue(uint32_t(spirvVersion));
+	sha.UpdateValue(uint32_t(spirvRevision));
+#ifdef GLSLANG_VERSION_MAJOR
+	sha.UpdateValue(uint32_t(GLSLANG_VERSION_MAJOR));
+	sha.UpdateValue(uint32_t(GLSLANG_VERSION_MINOR));
+	sha.UpdateValue(uint32_t(GLSLANG_VERSION_PATCH));
+#endif
+	sha.UpdateString("vulkan1.2;spirv1.5;werror");
+	sha.UpdateValue(uint32_t(type));
+	sha.UpdateValue(uint32_t(attributes));
+	sha.UpdateValue(uint8_t(compileDebug));
+	if (compileDebug)
+		sha.UpdateString(fileName);
+	sha.UpdateValue(uint64_t(defines.Defines.size()));
+	for (auto& [preprocessor, value] : defines.Defines) {
+		sha.UpdateString(preprocessor);
+		sha.UpdateString(value);
 	}
+	sha.UpdateString(sourceCode);
+	return sha.Finalize();
+}
 
-	uint64_t shader_last_write_time = 0;
-	FILE* metadataHandle = fopen(metadataFile.string().c_str(), "r");
-	if (!metadataHandle) {
-		return {};
-	}
-	if (!fscanf(metadataHandle, "last_write_time: %llu\n", &shader_last_write_time)) {
-		return {};
-	}
-	// Has the file been modified?
-	if (filesystem::last_write_time(file).time_since_epoch().count() != shader_last_write_time) {
-		return {};
+void egx::Shader::SetGlobalPack(const std::shared_ptr<ShaderArchive>& pack)
+{
+	scoped_lock lock(m_CacheLock);
+	m_Pack = pack;
+}
+
+std::shared_ptr<ShaderArchive> egx::Shader::GetGlobalPack()
+{
+	scoped_lock lock(m_CacheLock);
+	return m_Pack;
+}
+
+void egx::Shader::CompileToPack(ShaderArchive& pack, const std::string& name, const std::string& file,
+	const PreprocessDefines& defines, Type overrideType, BindingAttributes attributes, bool compileDebug)
+{
+	Type type = overrideType == Type::None ? TypeFromFileName(file) : overrideType;
+	if (type == Type::None)
+	{
+		throw runtime_error(cpp::Format("Cannot determine the shader type of {}", file));
 	}
-	bool modified = false;
-	// Has any of the include file's been modified?
-	while (!feof(metadataHandle)) {
-		char include_file[256];
-		uint64_t last_write_time;
-		if (fscanf_s(metadataHandle, "include: %256s %llu\n", include_file, 256, &last_write_time) != 2) {
-			modified = true;
-			break;
-		}
-		if (filesystem::last_write_time(include_file).time_since_epoch().count() != last_write_time) {
-			modified = true;
-			break;
-		}
+	auto glsl = cpp::ReadAllText(file);
+	if (!glsl.has_value())
+	{
+		throw runtime_error(cpp::Format("Could not open {}", file));
 	}
-	fclose(metadataHandle);
-	if (modified)
-		return {};
+	std::vector<std::pair<std::string, uint64_t>> lastModified;
+	std::optional<std::vector<std::string>> pragmaOnce;
+	std::string code = PreprocessIncludeFiles(file, filesystem::path(file).parent_path().string(), glsl.value(), lastModified, pragmaOnce);
+	auto byteCode = CompileGlslToBytecode(code, type, defines, compileDebug, file);
+	pack.Add(CreatePackKey(name, defines), byteCode, GenerateReflection(byteCode, attributes));
+}
 
-	auto bin = ReadAllBytes(binFile.string());
-	// All SPIR-V bin file's are uint32_t words
-	if (bin->size() % 4 != 0) {
-		return {};
+std::array<uint8_t, 32> egx::Shader::CreatePackKey(const std::string& name, const PreprocessDefines& defines)
+{
+	Sha256 sha;
+	sha.UpdateString(name);
+	sha.UpdateValue(uint64_t(defines.Defines.size()));
+	for (auto& [preprocessor, value] : defines.Defines) {
+		sha.UpdateString(preprocessor);
+		sha.UpdateString(value);
 	}
-	return vector<uint32_t>(reinterpret_cast<uint32_t*>(bin->data()), reinterpret_cast<uint32_t*>(bin->data() + bin->size()));
+	return sha.Finalize();
 }
 
-void egx::Shader::_CacheCompiledShader(const std::string& filePath, const std::vector<uint32_t>& bytecode, const std::vector<std::pair<std::string, size_t>>& includeLastWriteTime)
+std::vector<std::string> egx::Shader::CollectDependencies(const std::string& file)
 {
-	if (Shader::m_CachingDirectory.length() == 0)
-		return;
-	string absolute_file_path = filesystem::absolute(filePath).string();
-	size_t hash = std::hash<string>{}(absolute_file_path);
-	auto file_name = filesystem::path(m_CachingDirectory) / Format("{}.spirv-cache.bin", hash);
-	WriteAllBytes(file_name.string(), bytecode.data(), bytecode.size() * sizeof(uint32_t));
-	string log = "last_write_time: " + to_string(filesystem::last_write_time(filePath).time_since_epoch().count()) + "\n";
-	for (auto& [includeFile, lastWriteTime] : includeLastWriteTime) {
-		log += Format("include: {} {}\n", includeFile, lastWriteTime);
+	auto glsl = cpp::ReadAllText(file);
+	if (!glsl.has_value())
+	{
+		throw runtime_error(cpp::Format("Could not open {}", file));
 	}
-	file_name = filesystem::path(m_CachingDirectory) / Format("{}.spirv-cache.log", hash);
-	WriteAllText(file_name.string(), log);
+	std::vector<std::pair<std::string, uint64_t>> includes;
+	std::optional<std::vector<std::string>> pragmaOnce;
+	PreprocessIncludeFiles(file, filesystem::path(file).parent_path().string(), glsl.value(), includes, pragmaOnce);
+	std::vector<std::string> dependencies = { filesystem::absolute(file).string() };
+	for (auto& [include, lastWriteTime] : includes)
+		dependencies.push_back(include);
+	return dependencies;
+}
+
+Shader::Type egx::Shader::TypeFromFileName(const std::string& file)
+{
+	auto extension = cpp::LowerCase(filesystem::path(file).extension().string());
+	if (extension == ".vert")
+		return Type::Vertex;
+	if (extension == ".frag")
+		return Type::Fragment;
+	if (extension == ".comp")
+		return Type::Compute;
+	return Type::None;
 }
 
-string Shader::m_CachingDirectory = "";
\ No newline at end of file
+std::shared_ptr<ShaderArchive> Shader::m_Cache;
+std::shared_ptr<ShaderArchive> Shader::m_Pack;
+std::mutex Shader::m_CacheLock;
@@ -1,14 +1,18 @@
 #pragma once
 #include <core/egx.hpp>
-#include <shaderc/shaderc.hpp>
+#include <pipeline/LayoutCache.hpp>
 #include <vector>
 #include <string_view>
 #include <optional>
 #include <map>
+#include <array>
+#include <mutex>
 
 namespace egx
 {
 
+    class ShaderArchive;
+
     enum class BindingAttributes : uint32_t
     {
         Default = 0b001,
@@ -35,6 +39,8 @@ namespace egx
             uint32_t Dimension;
             bool IsBuffer;
             bool IsDynamic;
+            // False for storage buffers/images the shader may write (not declared readonly)
+            bool IsReadOnly;
             std::string Name;
         };
 
@@ -104,6 +110,14 @@ namespace egx
                Shader::Type type, BindingAttributes attributes = BindingAttributes::Default,
                PreprocessDefines defines = {}, bool compileDebug = false);
 
+        /// <summary>
+        /// Loads a shader precompiled by egx-shaderc, name is the file path relative to the directory given to the
+        /// tool ('/' separated) and defines must match one of the permutations declared for it.
+        /// Runs neither shaderc nor spirv_cross, throws runtime_error when the pack has no such entry.
+        /// </summary>
+        Shader(const DeviceCtx &pCtx, const ShaderArchive &pack, const std::string &name,
+               const PreprocessDefines &defines = {});
+
         //void GetSourceCode(std::string &out) const;
         vk::ShaderModule GetModule() const { return m_Data->m_Module; }
 
@@ -149,7 +163,10 @@ namespace egx
         double CompilationDuration() const { return m_Duration; }
 
         static std::vector<vk::PushConstantRange> GetPushconstants(const std::initializer_list<Shader> &shaders);
-        static std::map<uint32_t, vk::DescriptorSetLayout> CreateDescriptorSetLayouts(const std::initializer_list<Shader> &shaders);
+        /// <summary>
+        /// Set layouts for the combined bindings of the shaders, shared through DeviceContext::Layouts.
+        /// </summary>
+        static std::map<uint32_t, SharedDescriptorSetLayout> CreateDescriptorSetLayouts(const std::initializer_list<Shader> &shaders);
         static std::vector<vk::DescriptorSetLayout> GetDescriptorSetLayoutsAsScalar(const std::map<uint32_t, vk::DescriptorSetLayout>& setLayouts)
         {
             std::vector<vk::DescriptorSetLayout> scalar;
@@ -158,7 +175,46 @@ namespace egx
             return scalar;
         }
 
+        /// <summary>
+        /// Opens {directory}/shaders.spirv-archive.bin, compiled shaders and their reflection are stored there and
+        /// loaded without running shaderc or spirv_cross, see CreateCacheKey().
+        /// </summary>
         static void SetGlobalCacheDirectory(const std::string& directory);
+        static std::shared_ptr<ShaderArchive> GetGlobalCache();
+
+        /// <summary>
+        /// Pack used by engine code for its internal shaders (e.g. d2::Scene), nullptr compiles them from source.
+        /// </summary>
+        static void SetGlobalPack(const std::shared_ptr<ShaderArchive>& pack);
+        static std::shared_ptr<ShaderArchive> GetGlobalPack();
+
+        /// <summary>
+        /// Compiles a file without a device and stores it in the pack under CreatePackKey(name, defines),
+        /// used by egx-shaderc.
+        /// </summary>
+        static void CompileToPack(ShaderArchive &pack, const std::string &name, const std::string &file,
+                                  const PreprocessDefines &defines = {}, Type overrideType = Type::None,
+                                  BindingAttributes attributes = BindingAttributes::Default, bool compileDebug = false);
+        static std::array<uint8_t, 32> CreatePackKey(const std::string &name, const PreprocessDefines &defines);
+
+        /// <summary>
+        /// Absolute paths of the file and every file it includes, throws when one cannot be read.
+        /// </summary>
+        static std::vector<std::string> CollectDependencies(const std::string &file);
+
+        /// <summary>
+        /// Stage from the extension (.vert, .frag, .comp), Type::None when unknown.
+        /// </summary>
+        static Type TypeFromFileName(const std::string &file);
+
+        /// <summary>
+        /// SHA-256 of everything that changes the SPIR-V or the reflection: the preprocessed source, defines, stage,
+        /// debug flag, binding attributes, compiler options, shaderc's SPIR-V version and the glslang version when
+        /// its build_info.h is available (otherwise CompilerRevision must be bumped after updating shaderc).
+        /// The file name only matters for debug builds which embed it.
+        /// </summary>
+        static std::array<uint8_t, 32> CreateCacheKey(const std::string& sourceCode, Type type, BindingAttributes attributes,
+                                                      const PreprocessDefines& defines, bool compileDebug, const std::string& fileName);
 
     private:
         static std::string PreprocessIncludeFiles(std::string_view CurrentFilePath,
@@ -172,8 +228,8 @@ namespace egx
                                                            Type type, const PreprocessDefines &defines,
                                                            bool compileDebug, const std::string &fileName);
 
-        std::optional<std::vector<uint32_t>> _LoadFromCache(const std::string& filePath);
-        void _CacheCompiledShader(const std::string& filePath, const std::vector<uint32_t>& bytecode, const std::vector<std::pair<std::string, size_t>>& includeLastWriteTime);
+        void _LoadOrCompile(const DeviceCtx& pCtx, const std::string& sourceCode, BindingAttributes attributes,
+                            const PreprocessDefines& defines, bool compileDebug, const std::string& fileName);
 
         struct DataWrapper
         {
@@ -197,7 +253,9 @@ namespace egx
         uint32_t m_SpecializationOffset = 0;
         std::vector<vk::SpecializationMapEntry> m_SpecializationConstants;
         std::vector<uint8_t> m_SpecializationData;
-        static std::string m_CachingDirectory;
+        static std::shared_ptr<ShaderArchive> m_Cache;
+        static std::shared_ptr<ShaderArchive> m_Pack;
+        static std::mutex m_CacheLock;
     };
 
     class IShaderCache
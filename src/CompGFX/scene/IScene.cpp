@@ -1,4 +1,7 @@
 #include "IScene.hpp"
+#include <core/QueueSubmitter.hpp>
+#include <core/GpuProfiler.hpp>
+#include <ext/ZoneProfiler.hpp>
 using namespace std;
 using namespace vk;
 
@@ -13,33 +16,160 @@ egx::IScene::IScene(const DeviceCtx& ctx) : m_Ctx(ctx), m_CurrentFrame(&ctx->Cur
 	}
 }
 
+egx::IScene::~IScene()
+{
+	m_Ctx->Submitter->WaitForFences(m_FrameFence);
+	_DestroyWorkerPools();
+	for (size_t i = 0; i < m_FrameFence.size(); i++) {
+		m_Ctx->Device.destroyCommandPool(m_CommandPools[i]);
+		m_Ctx->Device.destroyFence(m_FrameFence[i]);
+	}
+}
+
 void egx::IScene::Process()
 {
+	EGX_ZONE("IScene::Process");
+	// Derived scenes may fill m_Stages directly
+	if (m_StageNames.size() != m_Stages.size())
+		_UpdateStageNames();
 	int frame = *m_CurrentFrame;
 	Fence fence = m_FrameFence[frame];
-	m_Ctx->Device.waitForFences(fence, true, numeric_limits<uint64_t>::max());
+	m_Ctx->Submitter->WaitForFences({ fence });
 	m_Ctx->Device.resetFences(fence);
 	m_Ctx->Device.resetCommandPool(m_CommandPools[frame]);
 
  	CommandBuffer cmd = m_CommandBuffers[frame];
 	cmd.begin(vk::CommandBufferBeginInfo());
 
+	if (m_ThreadPool) {
+		_RecordParallel(cmd, frame);
+	}
+	else {
+		if (m_RT) {
+			m_RT->Begin(cmd);
+			m_RT->BeginDearImGuiFrame();
+		}
+
+		for (size_t i = 0; i < m_Stages.size(); i++)
+			_ProcessStage(cmd, i);
+
+		if (m_RT) {
+			m_RT->EndDearImGuiFrame(cmd);
+			m_RT->End(cmd);
+		}
+	}
+	cmd.end();
+
+	m_Ctx->FlushUploads();
+	m_Ctx->Submitter->Enqueue(QueueType::Graphics, { cmd }, {}, {}, fence);
+}
+
+void egx::IScene::SetParallelRecording(bool enable, uint32_t threadCount)
+{
+	// Secondaries of earlier frames may still be executing
+	m_Ctx->Submitter->WaitForFences(m_FrameFence);
+	_DestroyWorkerPools();
+	m_ThreadPool.reset();
+	if (!enable)
+		return;
+
+	m_ThreadPool = make_unique<ThreadPool>(threadCount);
+	auto poolInfo = vk::CommandPoolCreateInfo()
+		.setFlags(vk::CommandPoolCreateFlagBits::eTransient)
+		.setQueueFamilyIndex(m_Ctx->GraphicsQueueFamilyIndex);
+	m_WorkerPools.resize(m_Ctx->FramesInFlight);
+	for (auto& pools : m_WorkerPools) {
+		pools.resize(m_ThreadPool->ThreadCount() + 1);
+		for (auto& pool : pools)
+			pool.Pool = m_Ctx->Device.createCommandPool(poolInfo);
+	}
+}
+
+void egx::IScene::_RecordParallel(vk::CommandBuffer cmd, uint32_t frame)
+{
+	auto& pools = m_WorkerPools[frame];
+	for (auto& pool : pools) {
+		m_Ctx->Device.resetCommandPool(pool.Pool);
+		pool.Used = 0;
+	}
+
+	vk::CommandBufferInheritanceInfo inheritance;
+	vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit, &inheritance);
 	if (m_RT) {
-		m_RT->Begin(cmd);
+		inheritance = m_RT->GetInheritanceInfo();
+		beginInfo.flags |= vk::CommandBufferUsageFlagBits::eRenderPassContinue;
+		m_RT->Begin(cmd, vk::SubpassContents::eSecondaryCommandBuffers);
 		m_RT->BeginDearImGuiFrame();
 	}
 
-	for (auto& stage : m_Stages) {
-		stage->Process(cmd);
+	auto acquire = [&](uint32_t thread) {
+		WorkerPool& pool = pools[thread];
+		if (pool.Used == pool.Secondaries.size()) {
+			vk::CommandBufferAllocateInfo allocInfo(pool.Pool, vk::CommandBufferLevel::eSecondary, 1);
+			pool.Secondaries.push_back(m_Ctx->Device.allocateCommandBuffers(allocInfo)[0]);
+		}
+		vk::CommandBuffer secondary = pool.Secondaries[pool.Used++];
+		secondary.begin(beginInfo);
+		return secondary;
+	};
+
+	// One slot per stage plus ImGui, executed in this order
+	vector<vk::CommandBuffer> secondaries(m_Stages.size() + 1);
+	m_ThreadPool->ParallelFor(uint32_t(m_Stages.size()), [&](uint32_t index, uint32_t thread) {
+		if (!m_Stages[index]->IsThreadSafe())
+			return;
+		vk::CommandBuffer secondary = acquire(thread);
+		_ProcessStage(secondary, index);
+		secondary.end();
+		secondaries[index] = secondary;
+	});
+
+	uint32_t callerThread = m_ThreadPool->ThreadCount();
+	for (size_t i = 0; i < m_Stages.size(); i++) {
+		if (m_Stages[i]->IsThreadSafe())
+			continue;
+		vk::CommandBuffer secondary = acquire(callerThread);
+		_ProcessStage(secondary, i);
+		secondary.end();
+		secondaries[i] = secondary;
 	}
 
 	if (m_RT) {
-		m_RT->EndDearImGuiFrame(cmd);
+		vk::CommandBuffer secondary = acquire(callerThread);
+		m_RT->EndDearImGuiFrame(secondary);
+		secondary.end();
+		secondaries.back() = secondary;
+	}
+	erase(secondaries, vk::CommandBuffer());
+
+	if (secondaries.size() > 0)
+		cmd.executeCommands(secondaries);
+	if (m_RT) {
 		m_RT->End(cmd);
 	}
-	cmd.end();
+}
 
-	SubmitInfo submit;
-	submit.setCommandBuffers(cmd);
-	m_Ctx->Queue.submit(submit, fence);
+void egx::IScene::_ProcessStage(vk::CommandBuffer cmd, size_t index)
+{
+	EGX_ZONE(m_StageNames[index].Zone);
+	GpuProfiler::Scope zone(m_Ctx->Profiler.get(), cmd, m_StageNames[index].Name);
+	m_Stages[index]->Process(cmd);
+}
+
+void egx::IScene::_UpdateStageNames()
+{
+	m_StageNames.resize(std::min(m_StageNames.size(), m_Stages.size()));
+	for (size_t i = m_StageNames.size(); i < m_Stages.size(); i++) {
+		string name = m_Stages[i]->GetName();
+		m_StageNames.push_back({ name, ZoneProfiler::Get().Intern(name) });
+	}
+}
+
+void egx::IScene::_DestroyWorkerPools()
+{
+	for (auto& pools : m_WorkerPools) {
+		for (auto& pool : pools)
+			m_Ctx->Device.destroyCommandPool(pool.Pool);
+	}
+	m_WorkerPools.clear();
 }
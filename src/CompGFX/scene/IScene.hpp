@@ -3,7 +3,10 @@
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <string>
+#include <typeinfo>
 #include <pipeline/RenderTarget.hpp>
+#include <ext/ThreadPool.hpp>
 
 namespace egx {
 
@@ -72,8 +75,24 @@ namespace egx {
 		IRenderStage(const DeviceCtx& ctx, const IDataRegistry& registry) : m_Ctx(ctx), m_Registry(registry) {}
 
 		virtual void Initialize(bool first_load) = 0;
+		/// <summary>
+		/// With parallel recording cmd is a secondary command buffer (continuing the render target's
+		/// render pass) and Process() may run on a worker thread concurrently with other stages.
+		/// Dynamic state (viewport, scissor, ...) is not inherited and must be set by the stage.
+		/// </summary>
 		virtual void Process(vk::CommandBuffer cmd) = 0;
 
+		/// <summary>
+		/// Stages that touch thread affine state (e.g. ImGui) return false
+		/// and are recorded on the thread calling IScene::Process().
+		/// </summary>
+		virtual bool IsThreadSafe() const { return true; }
+
+		/// <summary>
+		/// Name of the stage in the GPU profiler.
+		/// </summary>
+		virtual std::string GetName() const { return typeid(*this).name(); }
+
 	protected:
 		DeviceCtx m_Ctx;
 		IDataRegistry m_Registry;
@@ -93,6 +112,8 @@ namespace egx {
 	class IScene {
 	public:
 		IScene(const DeviceCtx& ctx);
+		IScene(IScene&) = delete;
+		virtual ~IScene();
 
 		virtual void Initialize(bool first_load) {
 			for (auto& stage : m_Stages)
@@ -106,10 +127,24 @@ namespace egx {
 
 		virtual void Process();
 
+		/// <summary>
+		/// Records every stage into its own secondary command buffer from a pool of threadCount
+		/// workers (0 picks one per core), each thread allocates from its own per-frame command pool.
+		/// The primary command buffer executes the secondaries in stage order.
+		/// </summary>
+		void SetParallelRecording(bool enable, uint32_t threadCount = 0);
+
 	protected:
+		void _RecordParallel(vk::CommandBuffer cmd, uint32_t frame);
+		// Records one stage inside its CPU and GPU zones, shared by every recording path
+		void _ProcessStage(vk::CommandBuffer cmd, size_t index);
+		void _DestroyWorkerPools();
+		// Interns the zone names of stages added since the last call, not per frame
+		void _UpdateStageNames();
 
 		void AddRenderStage(const std::shared_ptr<IRenderStage>& stage) {
 			m_Stages.push_back(stage);
+			_UpdateStageNames();
 		}
 
 	protected:
@@ -121,7 +156,23 @@ namespace egx {
 		std::vector<vk::CommandBuffer> m_CommandBuffers;
 		std::vector<vk::Fence> m_FrameFence;
 		std::vector<std::shared_ptr<IRenderStage>> m_Stages;
+		struct StageName {
+			std::string Name;
+			// Interned by the ZoneProfiler
+			const char* Zone;
+		};
+		// Parallel to m_Stages
+		std::vector<StageName> m_StageNames;
 		std::optional<IRenderTarget> m_RT;
+
+		struct WorkerPool {
+			vk::CommandPool Pool;
+			std::vector<vk::CommandBuffer> Secondaries;
+			uint32_t Used = 0;
+		};
+		std::unique_ptr<ThreadPool> m_ThreadPool;
+		// [frame][thread], the last thread is the one calling Process()
+		std::vector<std::vector<WorkerPool>> m_WorkerPools;
 	};
 
 
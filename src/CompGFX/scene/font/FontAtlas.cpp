@@ -1,6 +1,7 @@
 #include "FontAtlas.hpp"
 #include <algorithm>
 #include <execution>
+#include <ext/ZoneProfiler.hpp>
 #include <stb/stb_image_write.h>
 using namespace std;
 using namespace egx;
@@ -18,6 +19,7 @@ FontAtlas& egx::FontAtlas::LoadTTFont(const std::string& file)
 
 void egx::FontAtlas::BuildAtlas(float fontSize, bool sdf, bool multithreaded)
 {
+	EGX_ZONE("FontAtlas::BuildAtlas");
 	vector<tuple<wchar_t, int, int, vector<uint8_t>>> unordered_bitmaps;
 	vector<tuple<wchar_t, int, int, vector<uint8_t>>> bitmaps;
 	int total_pixel_area = 0;
@@ -0,0 +1,88 @@
+#include <core/egx.hpp>
+#include <core/QueueSubmitter.hpp>
+#include <core/GpuProfiler.hpp>
+#include <memory/egxbuffer.hpp>
+#include <algorithm>
+
+using namespace egx;
+using namespace std;
+
+static constexpr uint32_t FrameCount = 16;
+static constexpr size_t FillSize = 16ull * 1024ull * 1024ull;
+
+// Headless (runs on lavapipe), records nested zones around buffer fills and checks they are read back
+void gpu_profiler_main() {
+	auto icd = VulkanICDState::Create("GPU Profiler Test", false, false, VK_API_VERSION_1_2, nullptr, nullptr);
+	auto device = icd->CreateDevice(icd->QueryGPGPUDevices()[0]);
+	auto& profiler = device->Profiler;
+	profiler->SetEnabled(true);
+
+	auto buffer = Buffer(device, FillSize, MemoryPreset::DeviceOnly, HostMemoryAccess::None, vk::BufferUsageFlagBits::eTransferDst, false);
+
+	vector<vk::CommandPool> cmdPools(device->FramesInFlight);
+	generate(cmdPools.begin(), cmdPools.end(), [&] { return device->Device.createCommandPool(vk::CommandPoolCreateInfo({}, device->GraphicsQueueFamilyIndex)); });
+	vector<vk::CommandBuffer> cmds;
+	for (auto& pool : cmdPools)
+		cmds.push_back(device->Device.allocateCommandBuffers(vk::CommandBufferAllocateInfo(pool, vk::CommandBufferLevel::ePrimary, 1))[0]);
+	vector<vk::Fence> fences(device->FramesInFlight);
+	generate(fences.begin(), fences.end(), [&] { return device->Device.createFence(vk::FenceCreateInfo().setFlags(vk::FenceCreateFlagBits::eSignaled)); });
+
+	for (uint32_t i = 0; i < FrameCount; i++) {
+		auto frame = device->CurrentFrame;
+		// The profiler reads the slot's queries back once its previous frame retired
+		device->Submitter->WaitForFences({ fences[frame] });
+		device->Device.resetFences(fences[frame]);
+		device->Device.resetCommandPool(cmdPools[frame]);
+
+		auto cmd = cmds[frame];
+		cmd.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+		{
+			GpuProfiler::Scope outer(profiler.get(), cmd, "Frame");
+			{
+				GpuProfiler::Scope fill(profiler.get(), cmd, "Fill");
+				cmd.fillBuffer(buffer.GetHandle(), 0, FillSize, i);
+			}
+			vk::MemoryBarrier barrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eTransferWrite);
+			cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eTransfer, {}, barrier, {}, {});
+			{
+				GpuProfiler::Scope refill(profiler.get(), cmd, "Refill");
+				cmd.fillBuffer(buffer.GetHandle(), 0, FillSize, ~i);
+			}
+		}
+		cmd.end();
+
+		device->Submitter->Enqueue(QueueType::Graphics, { cmd }, {}, {}, fences[frame]);
+		device->NextFrame();
+	}
+
+	device->Submitter->WaitForFences(fences);
+	auto history = profiler->GetHistory();
+	if (history.empty())
+	{
+		throw runtime_error("The GPU profiler did not read back any frame.");
+	}
+	for (auto& frame : history)
+	{
+		if (frame.Zones.size() != 3)
+		{
+			throw runtime_error(cpp::Format("Frame {} has {} GPU zones, expected 3.", frame.FrameNumber, frame.Zones.size()));
+		}
+		for (auto& zone : frame.Zones)
+		{
+			if (zone.EndNs < zone.BeginNs || zone.Depth != (zone.Name == "Frame" ? 0u : 1u))
+			{
+				throw runtime_error(cpp::Format("Invalid GPU zone {} in frame {}.", zone.Name, frame.FrameNumber));
+			}
+		}
+	}
+
+	auto last = profiler->GetLastFrame();
+	for (auto& zone : last.Zones)
+		LOG(INFO, "Frame {}: {} {} ms (depth {})", last.FrameNumber, zone.Name, zone.DurationMs(), zone.Depth);
+	LOG(INFO, "{} of {} frames were read back.", history.size(), FrameCount);
+
+	for (auto& pool : cmdPools)
+		device->Device.destroyCommandPool(pool);
+	for (auto& fence : fences)
+		device->Device.destroyFence(fence);
+}
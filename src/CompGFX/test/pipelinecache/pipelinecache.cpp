@@ -0,0 +1,118 @@
+#include <core/egx.hpp>
+#include <pipeline/pipeline.hpp>
+#include <pipeline/RenderTarget.hpp>
+#include <pipeline/PersistentPipelineCache.hpp>
+#include <ext/StopWatch.hpp>
+#include <filesystem>
+
+using namespace egx;
+using namespace std;
+
+static const char* VertexShader = R"(
+#version 450 core
+layout (location = 0) in vec3 in_pos;
+layout (location = 1) in vec3 in_col;
+layout (location = 0) out vec3 out_col;
+void main() {
+out_col = in_col;
+gl_Position = vec4(in_pos, 1.0);
+}
+)";
+
+static const char* FragmentShader = R"(
+#version 450 core
+layout (location = 0) in vec3 in_col;
+layout (location = 0) out vec4 out_frag;
+void main() {
+out_frag = vec4(in_col, 1.0);
+}
+)";
+
+static const char* ComputeShader = R"(
+#version 450 core
+layout (local_size_x = 64) in;
+layout (set = 0, binding = 0) buffer Data { float values[]; };
+void main() {
+uint i = gl_GlobalInvocationID.x;
+float value = values[i];
+for (uint k = 0; k < VARIANT + 1; k++)
+	value = sin(value) * float(k + 1) + cos(value * VARIANT);
+values[i] = value;
+}
+)";
+
+static constexpr uint32_t ComputeVariants = 16;
+
+struct BenchmarkRun {
+	bool Warm;
+	uint32_t Pipelines;
+	double Milliseconds;
+};
+
+// Only pipeline creation is timed, the shaders are compiled to SPIR-V beforehand
+static BenchmarkRun RunPipelineCreation(const VulkanICD& icd) {
+	auto device = icd->CreateDevice(icd->QueryGPGPUDevices()[0]);
+
+	auto renderTarget = IRenderTarget(device, 256, 256);
+	renderTarget.CreateColorAttachment(0, vk::Format::eR8G8B8A8Unorm, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal,
+		vk::ImageLayout::eShaderReadOnlyOptimal, vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore);
+	renderTarget.Invalidate();
+
+	Shader vertex(device, VertexShader, Shader::Type::Vertex);
+	Shader fragment(device, FragmentShader, Shader::Type::Fragment);
+	vector<Shader> computeShaders;
+	for (uint32_t i = 0; i < ComputeVariants; i++) {
+		string source = ComputeShader;
+		source.insert(source.find("layout (local_size_x"), "#define VARIANT " + to_string(i) + "\n");
+		computeShaders.push_back(Shader(device, source, Shader::Type::Compute));
+	}
+
+	vector<PipelineSpecification> specifications;
+	for (auto fillMode : { vk::PolygonMode::eFill, vk::PolygonMode::eLine })
+		for (auto cullMode : { vk::CullModeFlagBits::eNone, vk::CullModeFlagBits::eBack, vk::CullModeFlagBits::eFront })
+			for (auto topology : { vk::PrimitiveTopology::eTriangleList, vk::PrimitiveTopology::eTriangleStrip })
+				specifications.push_back(PipelineSpecification().SetFillMode(fillMode).SetCullMode(cullMode).SetTopology(topology));
+
+	BenchmarkRun run{ device->PipelineCache->WasLoaded() };
+	vector<IGraphicsPipeline> graphicsPipelines;
+	vector<ComputePipeline> computePipelines;
+	StopWatch watch;
+	for (auto& specification : specifications) {
+		auto pipeline = IGraphicsPipeline(device, vertex, fragment, renderTarget, specification);
+		pipeline.Invalidate();
+		graphicsPipelines.push_back(pipeline);
+	}
+	for (auto& shader : computeShaders)
+		computePipelines.push_back(ComputePipeline(device, shader));
+	watch.Stop();
+
+	run.Pipelines = uint32_t(graphicsPipelines.size() + computePipelines.size());
+	run.Milliseconds = watch.TimeAsMilliseconds();
+	// The device saves the cache when it is destroyed
+	return run;
+}
+
+void pipeline_cache_benchmark_main() {
+	const string cacheDirectory = "./pipeline-cache-benchmark/";
+	filesystem::remove_all(cacheDirectory);
+	PersistentPipelineCache::SetGlobalCacheDirectory(cacheDirectory);
+
+	auto icd = VulkanICDState::Create("Pipeline Cache Benchmark", false, false, VK_API_VERSION_1_2, nullptr, nullptr);
+	BenchmarkRun cold = RunPipelineCreation(icd);
+	if (cold.Warm)
+	{
+		throw runtime_error("The cold start loaded a pipeline cache from an empty directory.");
+	}
+	BenchmarkRun warm = RunPipelineCreation(icd);
+	// WasLoaded() is only set when the header matched the device and the driver accepted the data
+	if (!warm.Warm)
+	{
+		throw runtime_error("The warm start did not load the pipeline cache saved by the cold start.");
+	}
+
+	LOG(INFO, "Cold start ({}): {} pipelines in {} ms", cold.Warm ? "cache loaded" : "empty cache", cold.Pipelines, cold.Milliseconds);
+	LOG(INFO, "Warm start ({}): {} pipelines in {} ms", warm.Warm ? "cache loaded" : "empty cache", warm.Pipelines, warm.Milliseconds);
+	LOG(INFO, "Warm start speedup: {}x", cold.Milliseconds / std::max(warm.Milliseconds, 1e-3));
+
+	filesystem::remove_all(cacheDirectory);
+}
@@ -0,0 +1,102 @@
+#include <core/egx.hpp>
+#include <window/PlatformWindow.hpp>
+#include <window/swapchain.hpp>
+#include <pipeline/pipeline.hpp>
+#include <pipeline/RenderTarget.hpp>
+#include <pipeline/PipelineCompiler.hpp>
+#include <pipeline/shaders/ShaderHotReload.hpp>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+using namespace egx;
+using namespace std;
+
+static const char* VertexShader = R"(
+#version 450 core
+layout (location = 0) in vec3 in_pos;
+void main() {
+gl_Position = vec4(in_pos, 1.0);
+}
+)";
+
+// Every reload writes a different color
+static string FragmentShader(float red) {
+	return "#version 450 core\n"
+		"layout (location = 0) out vec4 out_frag;\n"
+		"void main() {\n"
+		"out_frag = vec4(" + to_string(red) + ", 0.0, 0.0, 1.0);\n"
+		"}\n";
+}
+
+static constexpr uint32_t ReloadCount = 8;
+
+static void WriteFile(const filesystem::path& path, const string& text) {
+	ofstream file(path, ios::trunc);
+	file << text;
+}
+
+// Reloads a swapchain pipeline several times, each rebuild replaces the previous pipeline and must not leave
+// its swapchain resize callback behind
+void shader_hot_reload_main() {
+	const filesystem::path directory = "./shader-hot-reload-test/";
+	filesystem::remove_all(directory);
+	filesystem::create_directories(directory);
+	const string vertexFile = (directory / "test.vert").string();
+	const string fragmentFile = (directory / "test.frag").string();
+	WriteFile(vertexFile, VertexShader);
+	WriteFile(fragmentFile, FragmentShader(0.0f));
+
+	auto icd = VulkanICDState::Create("Shader Hot Reload Test", false, false, VK_API_VERSION_1_2, nullptr, nullptr);
+	auto device = icd->CreateDevice(icd->QueryGPGPUDevices()[0]);
+	auto window = PlatformWindow("Shader Hot Reload Test", 320, 240);
+	auto swapchain = ISwapchainController(device, &window);
+	swapchain.Invalidate();
+	auto renderTarget = IRenderTarget(device, swapchain, vk::ImageLayout::eUndefined, vk::ImageLayout::eColorAttachmentOptimal, vk::ImageLayout::ePresentSrcKHR,
+		vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore, {});
+	renderTarget.Invalidate();
+
+	function<IGraphicsPipeline()> build = [device, renderTarget, vertexFile, fragmentFile] {
+		auto pipeline = IGraphicsPipeline(device, Shader(device, vertexFile), Shader(device, fragmentFile), renderTarget);
+		pipeline.Invalidate();
+		return pipeline;
+	};
+	auto pipeline = device->Compiler->Compile(build);
+	device->Compiler->WaitIdle();
+	device->Compiler->Commit();
+	if (!pipeline.IsValid())
+	{
+		throw runtime_error(cpp::Format("The initial build failed. {}", pipeline.GetError()));
+	}
+	const size_t callbackCount = swapchain.ResizeCallbackCount();
+
+	{
+		ShaderHotReload hotReload(device);
+		hotReload.Watch(pipeline, { vertexFile, fragmentFile }, build);
+		for (uint32_t i = 1; i <= ReloadCount; i++) {
+			vk::Pipeline previous = pipeline->Pipeline();
+			WriteFile(fragmentFile, FragmentShader(i / float(ReloadCount)));
+
+			auto start = chrono::steady_clock::now();
+			while (pipeline->Pipeline() == previous) {
+				if (chrono::steady_clock::now() - start > chrono::seconds(10))
+				{
+					throw runtime_error(cpp::Format("Reload {} did not rebuild the pipeline. {}", i, pipeline.GetError()));
+				}
+				this_thread::sleep_for(chrono::milliseconds(50));
+				device->Compiler->WaitIdle();
+				device->Compiler->Commit();
+			}
+			if (swapchain.ResizeCallbackCount() != callbackCount)
+			{
+				throw runtime_error(cpp::Format("Reload {} left {} swapchain resize callbacks, expected {}.", i, swapchain.ResizeCallbackCount(), callbackCount));
+			}
+		}
+		// Only the current pipeline is rebuilt
+		swapchain.Resize(300, 200, true);
+		LOG(INFO, "{} reloads, {} swapchain resize callbacks.", ReloadCount, swapchain.ResizeCallbackCount());
+	}
+
+	device->Device.waitIdle();
+	filesystem::remove_all(directory);
+}
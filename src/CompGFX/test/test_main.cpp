@@ -1,7 +1,17 @@
-
+#include <cstring>
 
 void triangle_main();
+void pipeline_cache_benchmark_main();
+void gpu_profiler_main();
+void shader_hot_reload_main();
 
-int main() {
-	triangle_main();
-}
\ No newline at end of file
+int main(int argc, char** argv) {
+	if (argc > 1 && strcmp(argv[1], "pipeline-cache-benchmark") == 0)
+		pipeline_cache_benchmark_main();
+	else if (argc > 1 && strcmp(argv[1], "gpu-profiler") == 0)
+		gpu_profiler_main();
+	else if (argc > 1 && strcmp(argv[1], "shader-hot-reload") == 0)
+		shader_hot_reload_main();
+	else
+		triangle_main();
+}
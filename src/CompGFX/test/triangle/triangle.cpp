@@ -1,6 +1,7 @@
 #include <core/egx.hpp>
 #include <window/PlatformWindow.hpp>
 #include <window/swapchain.hpp>
+#include <core/QueueSubmitter.hpp>
 #include <pipeline/pipeline.hpp>
 #include <pipeline/RenderTarget.hpp>
 #include <glm/glm.hpp>
@@ -81,7 +82,7 @@ void triangle_main() {
 		auto acquireSemaphore = swapchain.Acquire();
 
 		auto frame = device->CurrentFrame;
-		device->Device.waitForFences(fences[frame], true, 1e9);
+		device->Submitter->WaitForFences({ fences[frame] }, 1e9);
 		device->Device.resetFences(fences[frame]);
 		device->Device.resetCommandPool(cmdPools[frame]);
 
@@ -93,13 +94,12 @@ void triangle_main() {
 		renderTarget.End(cmds[frame]);
 		cmds[frame].end();
 
-		vk::PipelineStageFlags waitDstStage = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+		device->FlushUploads();
 
-		device->Queue.submit(vk::SubmitInfo()
-			.setCommandBuffers(cmds[frame])
-			.setWaitSemaphores(acquireSemaphore)
-			.setWaitDstStageMask(waitDstStage)
-			.setSignalSemaphores(renderedSemaphore[frame]));
+		device->Submitter->Enqueue(QueueType::Graphics, { cmds[frame] },
+			{ vk::SemaphoreSubmitInfo(acquireSemaphore, 0, vk::PipelineStageFlagBits2::eColorAttachmentOutput) },
+			{ vk::SemaphoreSubmitInfo(renderedSemaphore[frame], 0, vk::PipelineStageFlagBits2::eAllCommands) },
+			fences[frame]);
 
 		swapchain.Present({ renderedSemaphore[frame] });
 		this_thread::sleep_for(chrono::milliseconds(1));
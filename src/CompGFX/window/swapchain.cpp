@@ -1,4 +1,7 @@
 #include "swapchain.hpp"
+#include <ext/ZoneProfiler.hpp>
+#include <core/DeletionQueue.hpp>
+#include <core/QueueSubmitter.hpp>
 
 using namespace std;
 using namespace egx;
@@ -30,15 +33,22 @@ ISwapchainController::ISwapchainController(const DeviceCtx &pCtx, PlatformWindow
 
 void ISwapchainController::Invalidate(bool blockQueue)
 {
-	if (blockQueue)
+	if (blockQueue) {
+		m_Data->m_Ctx->Submitter->Flush();
 		m_Data->m_Ctx->Device.waitIdle();
+	}
 
 	auto physicalDevice = m_Data->m_Ctx->PhysicalDeviceQuery.PhysicalDevice;
 	auto props = physicalDevice.getProperties();
 
-	for (vk::Semaphore imageReady : m_Data->m_ImageReady)
+	// Frames in flight may still wait on the semaphores and present the old images
+	vk::SwapchainKHR oldSwapchain = m_Data->m_Swapchain;
+	if (m_Data->m_ImageReady.size() > 0)
 	{
-		m_Data->m_Ctx->Device.destroySemaphore(imageReady);
+		m_Data->m_Ctx->Deletion->Push([device = m_Data->m_Ctx->Device, semaphores = m_Data->m_ImageReady] {
+			for (vk::Semaphore imageReady : semaphores)
+				device.destroySemaphore(imageReady);
+		});
 	}
 	m_Data->m_ImageReady.clear();
 
@@ -60,7 +70,7 @@ void ISwapchainController::Invalidate(bool blockQueue)
 	createInfo.imageArrayLayers = 1;
 	createInfo.preTransform = vk::SurfaceTransformFlagBitsKHR::eIdentity;
 	createInfo.setClipped(false);
-	createInfo.setOldSwapchain(m_Data->m_Swapchain);
+	createInfo.setOldSwapchain(oldSwapchain);
 
 	createInfo.setPresentMode(vk::PresentModeKHR::eImmediate);
 
@@ -90,6 +100,10 @@ void ISwapchainController::Invalidate(bool blockQueue)
 		auto error = cpp::Format("Could not create swapchain, VkResult {}", vk::to_string(errorCode));
 		throw std::runtime_error(error.c_str());
 	}
+	if (oldSwapchain)
+	{
+		m_Data->m_Ctx->Deletion->Push([device = m_Data->m_Ctx->Device, oldSwapchain] { device.destroySwapchainKHR(oldSwapchain); });
+	}
 
 	for(uint32_t i = 0; i < m_Data->m_Ctx->FramesInFlight; i++) {
 		m_Data->m_ImageReady.push_back(m_Data->m_Ctx->Device.createSemaphore(vk::SemaphoreCreateInfo()));
@@ -103,12 +117,46 @@ void egx::ISwapchainController::Resize(int width, int height, bool blockQueue)
 		return;
 	m_Data->m_Width = width, m_Data->m_Height = height;
 	Invalidate(blockQueue);
-	for (auto& [callback, pUserData] : m_Data->m_ResizeCallbacks)
-		callback->CallbackProtocol(pUserData);
+	vector<function<void()>> callbacks;
+	{
+		scoped_lock lock(m_Data->m_ResizeLock);
+		for (auto& [id, callback] : m_Data->m_ResizeCallbacks)
+			callbacks.push_back(callback);
+	}
+	// Called without the lock, a callback may release the last reference to a pipeline which unregisters itself
+	for (auto& callback : callbacks)
+		callback();
+}
+
+uint64_t egx::ISwapchainController::AddResizeCallback(IUniqueWithCallback* callbackObject, void* pUserData)
+{
+	shared_ptr<IUniqueWithCallback> handle(static_cast<IUniqueWithCallback*>(callbackObject->MakeHandle().release()));
+	return AddResizeCallback([handle, pUserData] { handle->CallbackProtocol(pUserData); });
+}
+
+uint64_t egx::ISwapchainController::AddResizeCallback(function<void()> callback)
+{
+	scoped_lock lock(m_Data->m_ResizeLock);
+	uint64_t id = m_Data->m_NextResizeCallback++;
+	m_Data->m_ResizeCallbacks[id] = std::move(callback);
+	return id;
+}
+
+void egx::ISwapchainController::RemoveResizeCallback(uint64_t id)
+{
+	scoped_lock lock(m_Data->m_ResizeLock);
+	m_Data->m_ResizeCallbacks.erase(id);
+}
+
+size_t egx::ISwapchainController::ResizeCallbackCount() const
+{
+	scoped_lock lock(m_Data->m_ResizeLock);
+	return m_Data->m_ResizeCallbacks.size();
 }
 
 vk::Semaphore ISwapchainController::Acquire()
 {
+	EGX_ZONE("ISwapchainController::Acquire");
 	const vk::Semaphore imageReadySemaphore = m_Data->m_ImageReady[m_Data->m_Ctx->CurrentFrame];
 	// We wait until the swapchain can give us the next image
 	const auto errorCode = m_Data->m_Ctx->Device.acquireNextImageKHR(m_Data->m_Swapchain, numeric_limits<uint64_t>::max(), imageReadySemaphore, {}, &m_Data->m_CurrentBackBufferIndex);
@@ -125,6 +173,7 @@ vk::Semaphore ISwapchainController::Acquire()
 
 uint32_t ISwapchainController::AcquireFullLock()
 {
+	EGX_ZONE("ISwapchainController::AcquireFullLock");
 	if (VkFence(m_Data->m_AcquireFullLock) == nullptr)
 	{
 		m_Data->m_AcquireFullLock = m_Data->m_Ctx->Device.createFence({});
@@ -145,11 +194,18 @@ uint32_t ISwapchainController::AcquireFullLock()
 
 void ISwapchainController::Present(const std::vector<vk::Semaphore> &presentReadySemaphore)
 {
+	EGX_ZONE("ISwapchainController::Present");
+	// The semaphores must have a pending signal before the present waits on them
+	m_Data->m_Ctx->SubmitFrame();
 	vk::PresentInfoKHR presentInfo;
 	presentInfo.setWaitSemaphores(presentReadySemaphore)
 				.setSwapchains(m_Data->m_Swapchain)
 				.setImageIndices(m_Data->m_CurrentBackBufferIndex);
-	auto result = m_Data->m_Ctx->Queue.presentKHR(presentInfo);
+	vk::Result result;
+	{
+		auto queueLock = m_Data->m_Ctx->Submitter->LockQueues();
+		result = m_Data->m_Ctx->Queue.presentKHR(presentInfo);
+	}
 	if (result != vk::Result::eSuccess &&
 			m_Data->m_Window->GetWidth() &&
 			m_Data->m_Window->GetHeight()) {
@@ -184,7 +240,7 @@ bool egx::ISwapchainController::_HandleAcquireError(vk::Result errorCode)
 			m_Data->m_Window->GetWidth() > 0 &&
 			m_Data->m_Window->GetHeight() > 0)
 		{
-			Resize(m_Data->m_Window->GetWidth(), m_Data->m_Window->GetHeight(), true);
+			Resize(m_Data->m_Window->GetWidth(), m_Data->m_Window->GetHeight());
 			return true;
 		}
 	}
@@ -200,11 +256,13 @@ ISwapchainController::DataWrapper::~DataWrapper()
 {
 	if (m_Ctx && m_Swapchain)
 	{
-		m_Ctx->Queue.waitIdle();
-		for(vk::Semaphore imageReady : m_ImageReady)
-			m_Ctx->Device.destroySemaphore(imageReady);
-		m_Ctx->Device.destroySwapchainKHR(m_Swapchain);
-		m_Ctx->ICDState->Instance().destroySurfaceKHR(m_Surface);
+		// The surface goes after the swapchain, the ICD state is kept alive until then
+		m_Ctx->Deletion->Push([device = m_Ctx->Device, icd = m_Ctx->ICDState, semaphores = m_ImageReady, swapchain = m_Swapchain, surface = m_Surface] {
+			for (vk::Semaphore imageReady : semaphores)
+				device.destroySemaphore(imageReady);
+			device.destroySwapchainKHR(swapchain);
+			icd->Instance().destroySurfaceKHR(surface);
+		});
 		auto currentContext = ImGui::GetCurrentContext();
 		LOG(ERR, "(TODO) Implement ImGui CleanUp");
 	}
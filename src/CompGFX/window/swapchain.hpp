@@ -5,6 +5,9 @@
 #include <imgui/backends/imgui_impl_glfw.h>
 #include <imgui/backends/imgui_impl_vulkan.h>
 #include <vulkan/vulkan.hpp>
+#include <functional>
+#include <mutex>
+#include <map>
 
 namespace egx
 {
@@ -17,7 +20,7 @@ namespace egx
 		ISwapchainController& SetVSync(bool state)
 		{
 			m_Data->m_VSync = state;
-			Invalidate(true);
+			Invalidate();
 			return *this;
 		}
 
@@ -53,13 +56,20 @@ namespace egx
 			return m_Data->m_Ctx->Device.getSwapchainImagesKHR(m_Data->m_Swapchain);
 		}
 
-		void Invalidate(bool blockQueue = true);
-		void Resize(int width, int height, bool blockQueue = true);
-		void AddResizeCallback(IUniqueWithCallback* callbackObject, void* pUserData) {
-			m_Data->m_ResizeCallbacks.push_back({ 
-				std::unique_ptr<IUniqueWithCallback>(static_cast<IUniqueWithCallback*>(callbackObject->MakeHandle().release())),
-			pUserData });
-		}
+		/// <summary>
+		/// Recreates the swapchain, the old swapchain and its semaphores are destroyed through the DeletionQueue
+		/// once the frames in flight retired. blockQueue additionally waits for the device to be idle.
+		/// </summary>
+		void Invalidate(bool blockQueue = false);
+		void Resize(int width, int height, bool blockQueue = false);
+		/// <summary>
+		/// Callbacks run after Resize() recreated the swapchain, in registration order. Thread safe, returns an id
+		/// for RemoveResizeCallback(). The object version keeps a handle (and so the object) alive.
+		/// </summary>
+		uint64_t AddResizeCallback(IUniqueWithCallback* callbackObject, void* pUserData);
+		uint64_t AddResizeCallback(std::function<void()> callback);
+		void RemoveResizeCallback(uint64_t id);
+		size_t ResizeCallbackCount() const;
 
 		int Width() const { return m_Data->m_Width; }
 		int Height() const { return m_Data->m_Height; }
@@ -118,7 +128,10 @@ namespace egx
 			vk::SurfaceKHR m_Surface;
 			vk::SwapchainKHR m_Swapchain;
 			ImGuiContext* m_Context = nullptr;
-			std::vector<std::pair<std::unique_ptr<IUniqueWithCallback>, void*>> m_ResizeCallbacks;
+			// [id, callback], pipelines may be built (and register) on PipelineCompiler workers
+			std::map<uint64_t, std::function<void()>> m_ResizeCallbacks;
+			uint64_t m_NextResizeCallback = 1;
+			mutable std::mutex m_ResizeLock;
 
 			VkSemaphore m_CurrentAcquireSemaphore = nullptr;
 
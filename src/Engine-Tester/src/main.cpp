@@ -11,6 +11,7 @@ int main(int argc, char** argv) {
 	LOG(INFO, "Hello Engine-Tester.");
 
 	Shader::SetGlobalCacheDirectory("./shaders/spir-v/");
+	PersistentPipelineCache::SetGlobalCacheDirectory("./shaders/pipeline-cache/");
 
 	CoreEngine engine;
 	engine.Startup(3);
@@ -33,8 +34,22 @@ int main(int argc, char** argv) {
 		.SetFragmentShader("./shaders/fs.glsl")
 		.Invalidate(engine, RT, true, spec);
 
-	ICommandBuffer cmd = engine.CreateCmdBuffer();
+	// Saving vs.glsl, fs.glsl or a file they include rebuilds the pipeline at the next frame
+	ShaderHotReload hotReload(engine.Device);
+	auto watchPipeline = [&]() {
+		return hotReload.Watch<IGraphicsPipeline>(pipeline.Pipeline, { "./shaders/vs.glsl", "./shaders/fs.glsl" }, [device = engine.Device, RT, spec]() {
+			Shader vertexShader(device, "./shaders/vs.glsl", BindingAttributes::Default, {}, true, Shader::Type::Vertex);
+			Shader fragmentShader(device, "./shaders/fs.glsl", BindingAttributes::Default, {}, true, Shader::Type::Fragment);
+			auto graphicsPipeline = IGraphicsPipeline(device, vertexShader, fragmentShader, RT, spec);
+			graphicsPipeline.Invalidate();
+			return graphicsPipeline;
+		});
+	};
+	uint64_t pipelineWatch = watchPipeline();
 
+	ICommandBuffer cmd = engine.CreateCmdBuffer();
+	// The FrameScheduler needs timeline semaphores, without them frames are paced with a fence per frame slot
+	FrameScheduler* scheduler = engine.Device->Scheduler.get();
 	auto semaphore = engine.CreateSemaphore();
 	auto fence = engine.CreateFence();
 
@@ -52,8 +67,13 @@ int main(int argc, char** argv) {
 	while (!engine.Window->ShouldClose()) {
 		PlatformWindow::Poll();
 
-		fence.Wait("cmdDone");
-		fence.Reset("cmdDone");
+		if (scheduler) {
+			scheduler->BeginFrame();
+		}
+		else {
+			engine.Device->Submitter->WaitForFences({ fence.GetFence(true, "cmdDone") });
+			fence.Reset("cmdDone");
+		}
 
 		auto acquireImageLock = engine.SwapChain.Acquire();
 
@@ -70,6 +90,25 @@ int main(int argc, char** argv) {
 		ImGui::InputFloat("Hz", &freq, 0.1, 0.5);
 		ImGui::InputFloat("Hz2", &freq2, 0.1, 0.5);
 		ImGui::InputFloat("Hz3", &freq3, 0.1, 0.5);
+		engine.Device->Telemetry->DrawImGuiOverlay();
+		engine.Device->Profiler->DrawImGuiOverlay();
+		bool profiling = engine.Device->Profiler->IsEnabled();
+		if (ImGui::Checkbox("GPU profiling", &profiling)) {
+			engine.Device->Profiler->SetEnabled(profiling);
+		}
+		if (ImGui::Button("Save GPU trace")) {
+			engine.Device->Profiler->SaveChromeTrace("gpu_trace.json");
+		}
+		bool cpuProfiling = ZoneProfiler::Get().IsEnabled();
+		if (ImGui::Checkbox("CPU profiling", &cpuProfiling)) {
+			ZoneProfiler::Get().SetEnabled(cpuProfiling);
+		}
+		if (ImGui::Button("Save CPU trace")) {
+			ZoneProfiler::Get().SaveChromeTrace("cpu_trace.json");
+		}
+		if (ImGui::Button("Defragment GPU memory")) {
+			engine.Device->Defrag->Begin();
+		}
 		glm::mat4 transform = glm::translate<float>(glm::mat4(1), offset) 
 			* glm::rotate<float>(glm::mat4(1.0), glfwGetTime() * 2.0 * 3.14 * freq, glm::vec3(0.0, 0.0, 1.0))
 			* glm::rotate<float>(glm::mat4(1.0), glfwGetTime() * 2.0 * 3.14 * freq2, glm::vec3(0.0, 1.0, 0.0))
@@ -77,21 +116,22 @@ int main(int argc, char** argv) {
 			* glm::scale(glm::mat4(1.0), glm::vec3(scale));
 
 		if (ImGui::Button("Toggle Wireframe mode")) {
-			engine.WaitIdle();
 			spec.FillMode = vk::PolygonMode(!int(spec.FillMode));
 			pipeline.SetVertexShader("./shaders/vs.glsl")
 				.SetFragmentShader("./shaders/fs.glsl")
-				.Invalidate(engine, RT, true, spec);
+				.InvalidateAsync(engine, RT, true, spec);
+			hotReload.Unwatch(pipelineWatch);
+			pipelineWatch = watchPipeline();
 		}
 
 		glm::mat4 ortho = glm::ortho<float>(-1, 1, -1, 1, -10, -10);
 
-		pipeline.Pipeline.Bind(c0);
+		pipeline.Pipeline->Bind(c0);
 		c0.bindVertexBuffers(0, { teapot.GetVertexBuffer().GetHandle() }, { 0 });
 		c0.bindIndexBuffer(teapot.GetIndexBuffer().GetHandle(), 0, vk::IndexType::eUint16);
 
-		c0.pushConstants(pipeline.Pipeline.Layout(), vk::ShaderStageFlagBits::eVertex, sizeof(transform)*0, sizeof(transform), &transform);
-		c0.pushConstants(pipeline.Pipeline.Layout(), vk::ShaderStageFlagBits::eVertex, sizeof(transform)*1, sizeof(transform), &ortho);
+		c0.pushConstants(pipeline.Pipeline->Layout(), vk::ShaderStageFlagBits::eVertex, sizeof(transform)*0, sizeof(transform), &transform);
+		c0.pushConstants(pipeline.Pipeline->Layout(), vk::ShaderStageFlagBits::eVertex, sizeof(transform)*1, sizeof(transform), &ortho);
 
 		c0.drawIndexed(teapot.GetIndicesCount(), 1, 0, 0, 0);
 
@@ -100,20 +140,21 @@ int main(int argc, char** argv) {
 
 		c0.end();
 
-		auto presentReady = semaphore.GetSemaphore("present-ready");
-		auto waitStage = vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput);
+		auto presentReady = scheduler ? scheduler->GetPresentSemaphore() : semaphore.GetSemaphore("present-ready");
 
-		vk::SubmitInfo submitInfo{};
-		submitInfo.setCommandBuffers(c0)
-			.setWaitSemaphores(acquireImageLock)
-			.setWaitDstStageMask(waitStage)
-			.setCommandBuffers(c0)
-			.setSignalSemaphores(presentReady);
-
-		engine.Device->Queue.submit(submitInfo, fence.GetFence(true, "cmdDone"));
+		engine.Device->FlushUploads();
+		if (scheduler) {
+			scheduler->Submit(QueueType::Graphics, { c0 }, { SubmitWait(acquireImageLock, 0, vk::PipelineStageFlagBits::eColorAttachmentOutput) }, { presentReady });
+		}
+		else {
+			engine.Device->Submitter->Enqueue(QueueType::Graphics, { c0 },
+				{ vk::SemaphoreSubmitInfo(acquireImageLock, 0, vk::PipelineStageFlagBits2::eColorAttachmentOutput) },
+				{ vk::SemaphoreSubmitInfo(presentReady, 0, vk::PipelineStageFlagBits2::eAllCommands) },
+				fence.GetFence(true, "cmdDone"));
+		}
 
+		// Present() moves on to the next frame
 		engine.SwapChain.Present({ presentReady });
-		engine.NextFrame();
 	}
 
 	engine.WaitIdle();
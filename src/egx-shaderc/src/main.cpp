@@ -0,0 +1,153 @@
+#include <core/egx.hpp>
+#include <pipeline/shaders/shader.hpp>
+#include <pipeline/shaders/ShaderArchive.hpp>
+#include <ext/ThreadPool.hpp>
+#include <ext/StopWatch.hpp>
+#include <Utility/CppUtility.hpp>
+#include <json.hpp>
+#include <filesystem>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+using namespace egx;
+
+// Optional manifest in the shader directory, declares stages for files without a stage extension,
+// define permutations and binding attributes:
+// { "shaders": { "vs.glsl": { "stage": "vertex", "permutations": [ {}, { "WIREFRAME": "1" } ], "dynamic-uniform": true } } }
+static const char* ManifestName = "egx-shaderc.json";
+
+struct CompileJob {
+	string Name;
+	string File;
+	Shader::Type Type;
+	Shader::PreprocessDefines Defines;
+	BindingAttributes Attributes;
+};
+
+static Shader::Type ParseStage(const string& stage)
+{
+	if (stage == "vertex")
+		return Shader::Type::Vertex;
+	if (stage == "fragment")
+		return Shader::Type::Fragment;
+	if (stage == "compute")
+		return Shader::Type::Compute;
+	throw runtime_error(cpp::Format("Unknown stage \"{}\" in {}, supported stages are vertex, fragment and compute.", stage, ManifestName));
+}
+
+static string DescribeDefines(const Shader::PreprocessDefines& defines)
+{
+	string text;
+	for (auto& [preprocessor, value] : defines.Defines)
+		text += value.empty() ? cpp::Format(" {}", preprocessor) : cpp::Format(" {}={}", preprocessor, value);
+	return text;
+}
+
+static vector<CompileJob> CollectJobs(const filesystem::path& directory)
+{
+	nlohmann::json manifest = nlohmann::json::object();
+	auto manifestText = cpp::ReadAllText((directory / ManifestName).string());
+	if (manifestText)
+		manifest = nlohmann::json::parse(*manifestText);
+	auto shaders = manifest.value("shaders", nlohmann::json::object());
+
+	vector<CompileJob> jobs;
+	for (auto& item : filesystem::recursive_directory_iterator(directory))
+	{
+		if (!item.is_regular_file() || item.path().filename() == ManifestName)
+			continue;
+		string name = filesystem::relative(item.path(), directory).generic_string();
+		auto declaration = shaders.value(name, nlohmann::json::object());
+
+		Shader::Type type = declaration.contains("stage") ? ParseStage(declaration["stage"].get<string>()) : Shader::TypeFromFileName(name);
+		// Include files and other assets
+		if (type == Shader::Type::None)
+			continue;
+
+		uint32_t attributes = uint32_t(BindingAttributes::Default);
+		if (declaration.value("dynamic-uniform", false))
+			attributes |= uint32_t(BindingAttributes::DynamicUniform);
+		if (declaration.value("dynamic-storage", false))
+			attributes |= uint32_t(BindingAttributes::DynamicStorage);
+
+		auto permutations = declaration.value("permutations", nlohmann::json::array({ nlohmann::json::object() }));
+		for (auto& permutation : permutations)
+		{
+			CompileJob job{ name, item.path().string(), type, {}, BindingAttributes(attributes) };
+			for (auto& [preprocessor, value] : permutation.items())
+				job.Defines.Add(preprocessor, value.is_string() ? value.get<string>() : value.dump());
+			jobs.push_back(std::move(job));
+		}
+	}
+	return jobs;
+}
+
+static void PrintUsage()
+{
+	cout << "Usage: egx-shaderc <shader directory> <output pack> [--debug] [--threads <count>]\n"
+		"Compiles every .vert, .frag and .comp file and the files declared in " << ManifestName << ",\n"
+		"once per declared define permutation, into a pack loaded by Shader(ctx, pack, name, defines).\n";
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		PrintUsage();
+		return 1;
+	}
+	filesystem::path directory = argv[1];
+	string output = argv[2];
+	bool compileDebug = false;
+	uint32_t threadCount = 0;
+	for (int i = 3; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--debug") == 0)
+			compileDebug = true;
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+			threadCount = uint32_t(atoi(argv[++i]));
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+	if (!filesystem::is_directory(directory))
+	{
+		LOG(ERR, "{} is not a directory.", directory.string());
+		return 1;
+	}
+
+	vector<CompileJob> jobs;
+	try {
+		jobs = CollectJobs(directory);
+	}
+	catch (exception& e) {
+		LOG(ERR, "Could not read {}. {}", (directory / ManifestName).string(), e.what());
+		return 1;
+	}
+
+	// The pack is rebuilt from scratch, stale entries would otherwise stay in the append-only file
+	filesystem::remove(output);
+	ShaderArchive pack(output);
+	ThreadPool pool(threadCount);
+	atomic<uint32_t> failed = 0;
+	StopWatch watch;
+	pool.ParallelFor(uint32_t(jobs.size()), [&](uint32_t index, uint32_t) {
+		auto& job = jobs[index];
+		try {
+			Shader::CompileToPack(pack, job.Name, job.File, job.Defines, job.Type, job.Attributes, compileDebug);
+			LOG(INFO, "{}{}", job.Name, DescribeDefines(job.Defines));
+		}
+		catch (exception& e) {
+			LOG(ERR, "{}{} failed. {}", job.Name, DescribeDefines(job.Defines), e.what());
+			failed++;
+		}
+	});
+	watch.Stop();
+
+	LOG(INFO, "Compiled {} of {} shaders into {} in {} ms using {} threads.", jobs.size() - failed, jobs.size(), output,
+		watch.TimeAsMilliseconds(), pool.ThreadCount() + 1);
+	return failed > 0 ? 1 : 0;
+}